@@ -1,12 +1,585 @@
+#include <errno.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <linux/netconf.h>
+
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_log.h>
 
 #include "libnetlink.h"
 #include "utils.h"
 
+#include "net/if_arp.h"
+#include "net/if_var.h"
+#include "net/if_llatbl.h"
+#include "net/if_vlan_var.h"
+#include "netinet/in_fib.h"
+#include "netinet/ip_var.h"
+#include "netinet6/in6_fib.h"
+#include "netinet6/ip6_var.h"
+#include "kip_monitor.h"
+
+#define RTE_LOGTYPE_APP RTE_LOGTYPE_USER1
+
+/*
+ * Neighbour states with a usable link-layer address, the kernel's
+ * NUD_VALID less NUD_NOARP, which covers multicast and the like.
+ */
+#define KIP_NUD_VALID	(NUD_PERMANENT | NUD_REACHABLE | NUD_STALE | \
+			 NUD_DELAY | NUD_PROBE)
+
+/*
+ * Receive buffer of the event socket: it starts at KIP_RCVBUF, so as to
+ * ride out route storms, and doubles each time it overflows anyway.
+ */
+#define KIP_RCVBUF	(8 << 20)
+#define KIP_RCVBUF_MAX	(256 << 20)
+
+/*
+ * A resync that fails is tried again KIP_RETRY seconds later, then twice
+ * as late each time it fails again, up to KIP_RETRY_MAX.
+ */
+#define KIP_RETRY	1
+#define KIP_RETRY_MAX	64
+
 struct rtnl_handle rth = { .fd = -1 };
+static struct rtnl_handle rth_dump = { .fd = -1 };
+static int kip_rcvbuf;
+
+/*
+ * The ifnet of a port whose KNI interface is name: "vEth<port>", or
+ * "vEth<port>_0" for the first of several KNI interfaces on a port.
+ */
+static struct ifnet *
+kip_port_ifnet(const char *name)
+{
+	struct ifnet *ifp;
+	unsigned port;
+	size_t len;
+
+	for (port = 0; port < RTE_MAX_ETHPORTS; port++) {
+		ifp = ifnet_byport[port];
+		if (ifp == NULL)
+			continue;
+		len = strlen(if_name(ifp));
+		if (strncmp(name, if_name(ifp), len) == 0 &&
+		    (name[len] == '\0' || strcmp(&name[len], "_0") == 0))
+			return ifp;
+	}
+	return NULL;
+}
+
+/*
+ * The VLAN ifnet for a kernel VLAN link on top of a known interface,
+ * created on RTM_NEWLINK.
+ */
+static struct ifnet *
+kip_vlan_ifnet(struct nlmsghdr *n, struct rtattr *tb[])
+{
+	struct rtattr *li[IFLA_INFO_MAX + 1];
+	struct rtattr *vi[IFLA_VLAN_MAX + 1];
+	struct ifnet *parent;
+	uint16_t vid;
+
+	if (tb[IFLA_LINKINFO] == NULL || tb[IFLA_LINK] == NULL)
+		return NULL;
+	parse_rtattr_nested(li, IFLA_INFO_MAX, tb[IFLA_LINKINFO]);
+	if (li[IFLA_INFO_KIND] == NULL ||
+	    strcmp(rta_getattr_str(li[IFLA_INFO_KIND]), "vlan") != 0 ||
+	    li[IFLA_INFO_DATA] == NULL)
+		return NULL;
+	parse_rtattr_nested(vi, IFLA_VLAN_MAX, li[IFLA_INFO_DATA]);
+	if (vi[IFLA_VLAN_ID] == NULL)
+		return NULL;
+
+	parent = ifnet_byindex(rta_getattr_u32(tb[IFLA_LINK]));
+	if (parent == NULL)
+		return NULL;
+	vid = rta_getattr_u16(vi[IFLA_VLAN_ID]);
+	if (n->nlmsg_type == RTM_DELLINK)
+		return if_vlandev(parent, vid);
+	return vlan_create(parent, vid);
+}
+
+static int
+kip_link(struct nlmsghdr *n)
+{
+	struct ifinfomsg *ifi = NLMSG_DATA(n);
+	struct rtattr *tb[IFLA_MAX + 1];
+	struct ifnet *ifp;
+	const char *name;
+	int len;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+	if (len < 0)
+		return 0;
+	parse_rtattr(tb, IFLA_MAX, IFLA_RTA(ifi), len);
+	if (tb[IFLA_IFNAME] == NULL)
+		return 0;
+	name = rta_getattr_str(tb[IFLA_IFNAME]);
+
+	ifp = ifnet_byindex(ifi->ifi_index);
+	if (ifp == NULL)
+		ifp = kip_port_ifnet(name);
+	if (ifp == NULL)
+		ifp = kip_vlan_ifnet(n, tb);
+	if (ifp == NULL)
+		return 0;
+
+	if (n->nlmsg_type == RTM_DELLINK) {
+		ifp->if_index = 0;
+		ifp->if_naddrs = ifp->if_naddrs6 = 0;
+		fib4_flush(ifp);
+		fib6_flush(ifp);
+		lla_flush(ifp);
+		if (ifp->if_parent != NULL)
+			vlan_destroy(ifp);
+		return 0;
+	}
+
+	ifp->if_index = ifi->ifi_index;
+	if (ifp->if_parent != NULL) {
+		snprintf(ifp->if_xname, sizeof(ifp->if_xname), "%s", name);
+		/* A VLAN passes traffic while its kernel link is up. */
+		if (ifi->ifi_flags & IFF_UP)
+			ifp->if_flags |= IFF_UP;
+		else
+			ifp->if_flags &= ~IFF_UP;
+	} else {
+		/*
+		 * Multicast groups the kernel joins are not mirrored; with
+		 * allmulticast on, the port's filter lets all of them in.
+		 */
+		if (ifi->ifi_flags & IFF_ALLMULTI)
+			ifp->if_flags |= IFF_ALLMULTI;
+		else
+			ifp->if_flags &= ~IFF_ALLMULTI;
+	}
+	if (tb[IFLA_MTU] != NULL)
+		ifp->if_mtu = rta_getattr_u32(tb[IFLA_MTU]);
+	return 0;
+}
+
+/*
+ * Enter an address of ours in the set the input paths deliver locally,
+ * or remove it.  Returns 0 if the set changed.
+ */
+static int
+kip_local(int family, const void *addr, int add)
+{
+	struct in_addr in;
+	int error;
+
+	if (family == AF_INET) {
+		memcpy(&in, addr, sizeof(in));
+		error = add ? in_addlocal(in, IN_ADDR_LOCAL) :
+			in_dellocal(in, IN_ADDR_LOCAL);
+	} else
+		error = add ? in6_addlocal(addr) : in6_dellocal(addr);
+	if (error != 0 && error != EEXIST && error != ENOENT)
+		RTE_LOG(WARNING, APP, "cannot %s local address (%d)\n",
+			add ? "add" : "delete", error);
+	return error;
+}
+
+static int
+kip_addr(struct nlmsghdr *n)
+{
+	struct ifaddrmsg *ifa = NLMSG_DATA(n);
+	struct rtattr *tb[IFA_MAX + 1];
+	struct rtattr *a;
+	struct ifnet *ifp;
+	int len, error, local;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ifa));
+	if (len < 0)
+		return 0;
+	if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+		return 0;
+	ifp = ifnet_byindex(ifa->ifa_index);
+	if (ifp == NULL)
+		return 0;
+	parse_rtattr(tb, IFA_MAX, IFA_RTA(ifa), len);
+	/* IFA_LOCAL is the address, IFA_ADDRESS the peer on p2p links */
+	a = tb[IFA_LOCAL] != NULL ? tb[IFA_LOCAL] : tb[IFA_ADDRESS];
+	if (a == NULL)
+		return 0;
+
+	if (n->nlmsg_type == RTM_DELADDR) {
+		kip_local(ifa->ifa_family, RTA_DATA(a), 0);
+		if_deladdr(ifp, ifa->ifa_family, RTA_DATA(a));
+		return 0;
+	}
+	/* Tentative IPv6 addresses are not ours yet, nor failed ones. */
+	local = kip_local(ifa->ifa_family, RTA_DATA(a),
+			  !(ifa->ifa_flags &
+			    (IFA_F_TENTATIVE | IFA_F_DADFAILED)));
+	error = if_addaddr(ifp, ifa->ifa_family, RTA_DATA(a),
+			   ifa->ifa_prefixlen);
+	/*
+	 * An IPv6 address is known from its tentative days; it is new to
+	 * the segment when it leaves that state and becomes local.
+	 */
+	if (error == EEXIST &&
+	    (ifa->ifa_family != AF_INET6 || local != 0))
+		return 0;
+	if (error != 0 && error != EEXIST) {
+		RTE_LOG(WARNING, APP, "%s: cannot add address (%d)\n",
+			if_name(ifp), error);
+		return 0;
+	}
+	/*
+	 * Tell the segment where a new address is, VIPs taken over from a
+	 * peer above all.  Tentative IPv6 addresses are not ours yet.
+	 */
+	if (!(ifa->ifa_flags & (IFA_F_TENTATIVE | IFA_F_DADFAILED)))
+		garp_announce(ifp, ifa->ifa_family, RTA_DATA(a), 1,
+			      GARP_COUNT, GARP_INTERVAL);
+	return 0;
+}
+
+/*
+ * Mirror the kernel's neighbour cache, which resolves on behalf of the
+ * KNI interfaces, into the dataplane neighbour tables.  Entries the
+ * kernel cannot use are left alone, so that an in-progress resolution
+ * does not knock out a still valid entry; failed and deleted ones go.
+ */
+static int
+kip_neigh(struct nlmsghdr *n)
+{
+	struct ndmsg *ndm = NLMSG_DATA(n);
+	struct rtattr *tb[NDA_MAX + 1];
+	struct ifnet *ifp;
+	uint16_t flags;
+	int len, error;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*ndm));
+	if (len < 0)
+		return 0;
+	if (ndm->ndm_family != AF_INET && ndm->ndm_family != AF_INET6)
+		return 0;
+	ifp = ifnet_byindex(ndm->ndm_ifindex);
+	if (ifp == NULL)
+		return 0;
+	parse_rtattr(tb, NDA_MAX, NDA_RTA(ndm), len);
+	if (tb[NDA_DST] == NULL)
+		return 0;
+
+	if (n->nlmsg_type == RTM_DELNEIGH || (ndm->ndm_state & NUD_FAILED)) {
+		lla_delete(ndm->ndm_family, RTA_DATA(tb[NDA_DST]));
+		return 0;
+	}
+	if (!(ndm->ndm_state & KIP_NUD_VALID) || tb[NDA_LLADDR] == NULL ||
+	    RTA_PAYLOAD(tb[NDA_LLADDR]) != ETHER_ADDR_LEN)
+		return 0;
+
+	flags = (ndm->ndm_state & NUD_PERMANENT) ? LLE_STATIC : 0;
+	error = lla_update(ndm->ndm_family, ifp, RTA_DATA(tb[NDA_DST]),
+			   RTA_DATA(tb[NDA_LLADDR]), flags);
+	if (error != 0)
+		RTE_LOG(WARNING, APP, "%s: cannot update neighbour (%d)\n",
+			if_name(ifp), error);
+	return 0;
+}
+
+/*
+ * Mirror the unicast routes of the kernel's main table into the dataplane
+ * FIBs, which pick among those to a prefix by metric as the kernel does.
+ * Of a multipath route, only the first next hop is used.  IPv6
+ * link-local prefixes, which every link has, are left out: such
+ * destinations are never forwarded.
+ */
+static int
+kip_route(struct nlmsghdr *n)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct rtattr *tb[RTA_MAX + 1];
+	struct rtattr *nh[RTA_MAX + 1];
+	struct rtattr *gwa;
+	struct rtnexthop *rtnh;
+	union {
+		struct in_addr	v4;
+		struct in6_addr	v6;
+	} dst, gw;
+	struct ifnet *ifp;
+	uint32_t table, metric;
+	size_t alen;
+	int len, oif, replace, error;
+
+	len = n->nlmsg_len - NLMSG_LENGTH(sizeof(*r));
+	if (len < 0)
+		return 0;
+	if (r->rtm_family == AF_INET)
+		alen = sizeof(struct in_addr);
+	else if (r->rtm_family == AF_INET6)
+		alen = sizeof(struct in6_addr);
+	else
+		return 0;
+	if (r->rtm_flags & RTM_F_CLONED)
+		return 0;
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r), len);
+	table = tb[RTA_TABLE] != NULL ? rta_getattr_u32(tb[RTA_TABLE]) :
+		r->rtm_table;
+	if (table != RT_TABLE_MAIN)
+		return 0;
+
+	memset(&dst, 0, sizeof(dst));
+	if (tb[RTA_DST] != NULL)
+		memcpy(&dst, RTA_DATA(tb[RTA_DST]), alen);
+	if (r->rtm_family == AF_INET6 && IN6_IS_ADDR_LINKLOCAL(&dst.v6))
+		return 0;
+	if (tb[RTA_MULTIPATH] != NULL) {
+		rtnh = RTA_DATA(tb[RTA_MULTIPATH]);
+		if (RTA_PAYLOAD(tb[RTA_MULTIPATH]) < sizeof(*rtnh) ||
+		    rtnh->rtnh_len < sizeof(*rtnh))
+			return 0;
+		oif = rtnh->rtnh_ifindex;
+		parse_rtattr(nh, RTA_MAX, RTNH_DATA(rtnh),
+			     rtnh->rtnh_len - sizeof(*rtnh));
+		gwa = nh[RTA_GATEWAY];
+	} else {
+		oif = tb[RTA_OIF] != NULL ? rta_getattr_u32(tb[RTA_OIF]) : 0;
+		gwa = tb[RTA_GATEWAY];
+	}
+	memset(&gw, 0, sizeof(gw));
+	if (gwa != NULL)
+		memcpy(&gw, RTA_DATA(gwa), alen);
+	ifp = ifnet_byindex(oif);
+	if (ifp == NULL)
+		return 0;
+	metric = tb[RTA_PRIORITY] != NULL ?
+		rta_getattr_u32(tb[RTA_PRIORITY]) : 0;
+	replace = (n->nlmsg_flags & NLM_F_REPLACE) != 0;
+
+	if (n->nlmsg_type == RTM_DELROUTE) {
+		if (r->rtm_family == AF_INET)
+			fib4_delete(dst.v4, r->rtm_dst_len, gw.v4, ifp,
+				    metric);
+		else
+			fib6_delete(&dst.v6, r->rtm_dst_len, &gw.v6, ifp,
+				    metric);
+		return 0;
+	}
+	if (r->rtm_type != RTN_UNICAST)
+		return 0;
+	if (r->rtm_family == AF_INET)
+		error = fib4_add(dst.v4, r->rtm_dst_len, gw.v4, ifp,
+				 metric, replace);
+	else
+		error = fib6_add(&dst.v6, r->rtm_dst_len, &gw.v6, ifp,
+				 metric, replace);
+	if (error != 0)
+		RTE_LOG(WARNING, APP, "%s: cannot add route (%d)\n",
+			if_name(ifp), error);
+	return 0;
+}
+
+/*
+ * Follow the kernel's net.ipv6.conf.all.forwarding, which the dataplane's
+ * IPv6 forwarding goes by.  Notifications only carry what changed.
+ */
+static int
+kip_netconf(struct nlmsghdr *n)
+{
+	struct netconfmsg *ncm = NLMSG_DATA(n);
+	struct rtattr *tb[NETCONFA_MAX + 1];
+	int len;
+
+	len = n->nlmsg_len - NLMSG_SPACE(sizeof(*ncm));
+	if (len < 0 || ncm->ncm_family != AF_INET6)
+		return 0;
+	parse_rtattr(tb, NETCONFA_MAX, (struct rtattr *)((char *)ncm +
+		     NLMSG_ALIGN(sizeof(*ncm))), len);
+	if (tb[NETCONFA_IFINDEX] == NULL ||
+	    (int)rta_getattr_u32(tb[NETCONFA_IFINDEX]) != NETCONFA_IFINDEX_ALL ||
+	    tb[NETCONFA_FORWARDING] == NULL)
+		return 0;
+	ip6_forwarding = rta_getattr_u32(tb[NETCONFA_FORWARDING]) != 0;
+	return 0;
+}
+
+static int
+kip_monitor_accept(const struct sockaddr_nl *who,
+		   struct rtnl_ctrl_data *ctrl,
+		   struct nlmsghdr *n, void *arg)
+{
+	switch (n->nlmsg_type) {
+	case RTM_NEWLINK:
+	case RTM_DELLINK:
+		return kip_link(n);
+	case RTM_NEWADDR:
+	case RTM_DELADDR:
+		return kip_addr(n);
+	case RTM_NEWNEIGH:
+	case RTM_DELNEIGH:
+		return kip_neigh(n);
+	case RTM_NEWROUTE:
+	case RTM_DELROUTE:
+		return kip_route(n);
+	case RTM_NEWNETCONF:
+		return kip_netconf(n);
+	}
+	return 0;
+}
+
+static int
+kip_monitor_dump(const struct sockaddr_nl *who, struct nlmsghdr *n,
+		 void *arg)
+{
+	return kip_monitor_accept(who, NULL, n, arg);
+}
+
+/*
+ * The kernel's state is dumped into the dataplane in this order, links
+ * before addresses, which refer to them.  Dumps go through their own
+ * socket, so that the events arriving meanwhile wait on rth and are
+ * applied afterwards, not skipped as the dump is read.
+ */
+static const struct {
+	int family;
+	int type;
+} kip_dumps[] = {
+	{ AF_UNSPEC, RTM_GETLINK },
+	{ AF_UNSPEC, RTM_GETADDR },
+	{ AF_UNSPEC, RTM_GETNEIGH },
+	{ AF_INET, RTM_GETROUTE },
+	{ AF_INET6, RTM_GETROUTE },
+	{ AF_INET6, RTM_GETNETCONF },
+};
+
+/*
+ * Resync under way: the dump of kip_dumps[] being read, -1 if none, and
+ * whether it was requested yet.
+ */
+static int kip_sync_dump = -1;
+static int kip_sync_requested;
+
+/*
+ * Retry of a failed resync: the delay before the next one, in seconds, 0
+ * until one fails, and the TSC it is due at, 0 if none is.
+ */
+static unsigned int kip_sync_backoff;
+static uint64_t kip_sync_retry;
+
+/*
+ * The initial dump, before the dataplane runs: it may block.
+ */
+static int
+kip_monitor_dumpall(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < RTE_DIM(kip_dumps); i++)
+		if (rtnl_wilddump_request(&rth_dump, kip_dumps[i].family,
+					  kip_dumps[i].type) < 0 ||
+		    rtnl_dump_filter(&rth_dump, kip_monitor_dump, NULL) < 0)
+			return -1;
+	return 0;
+}
+
+/*
+ * Drop the addresses of ifp the kernel no longer has, going by the local
+ * address sets once swept.
+ */
+static int
+kip_prune_addrs(struct ifnet *ifp, const void *arg)
+{
+	struct in_addr in;
+	struct in6_addr in6;
+	int i;
+
+	for (i = ifp->if_naddrs - 1; i >= 0; i--) {
+		in = ifp->if_inaddrs[i].ia_addr;
+		if (in_addrtype(in) == IN_ADDR_NONE)
+			if_deladdr(ifp, AF_INET, &in);
+	}
+	for (i = ifp->if_naddrs6 - 1; i >= 0; i--) {
+		in6 = ifp->if_in6addrs[i].ia6_addr;
+		if (!in6_localip(&in6))
+			if_deladdr(ifp, AF_INET6, &in6);
+	}
+	return 0;
+}
+
+/*
+ * Events were lost: dump everything again, and drop the routes and
+ * addresses the dump no longer has.  The neighbour tables, a cache the
+ * dataplane also fills, are refreshed but not swept; links the kernel
+ * removed meanwhile are not noticed.  The dumps are read a budget at a
+ * time by kip_monitor_poll(), see kip_monitor_resync_poll(), which sweeps
+ * after the last one.
+ */
+static void
+kip_monitor_resync(void)
+{
+
+	kip_sync_retry = 0;
+	fib4_mark();
+	fib6_mark();
+	in_local_mark();
+	in6_local_mark();
+	kip_sync_dump = 0;
+	kip_sync_requested = 0;
+}
+
+/*
+ * Read on with the resync, at most budget messages of its dumps, checked
+ * between datagrams; returns the number applied.  Events wait on rth
+ * meanwhile, lest one be undone by a dump taken before it.
+ */
+static int
+kip_monitor_resync_poll(unsigned int budget)
+{
+	int n, done;
+
+	if (!kip_sync_requested) {
+		if (rtnl_wilddump_request(&rth_dump,
+					  kip_dumps[kip_sync_dump].family,
+					  kip_dumps[kip_sync_dump].type) < 0)
+			goto fail;
+		kip_sync_requested = 1;
+	}
+	n = rtnl_dump_budget(&rth_dump, kip_monitor_dump, NULL, budget,
+			     &done);
+	if (n < 0)
+		goto fail;
+	if (!done)
+		return n;
+
+	kip_sync_requested = 0;
+	if (++kip_sync_dump < (int)RTE_DIM(kip_dumps))
+		return n;
+	kip_sync_dump = -1;
+	fib4_sweep();
+	fib6_sweep();
+	in_local_sweep();
+	in6_local_sweep();
+	if_walk(kip_prune_addrs, NULL);
+	kip_sync_backoff = 0;
+	RTE_LOG(INFO, APP, "netlink monitor: resynced\n");
+	return n;
+
+fail:
+	/*
+	 * What was marked stays until a resync sweeps it; events go on
+	 * meanwhile.  Replies to this dump left on rth_dump are told from
+	 * those of the next by their sequence number.
+	 */
+	kip_sync_dump = -1;
+	kip_sync_requested = 0;
+	kip_sync_backoff = kip_sync_backoff == 0 ? KIP_RETRY :
+		RTE_MIN(2 * kip_sync_backoff, (unsigned int)KIP_RETRY_MAX);
+	kip_sync_retry = rte_get_timer_cycles() +
+		kip_sync_backoff * rte_get_timer_hz();
+	RTE_LOG(ERR, APP, "netlink monitor: cannot resync, retrying in "
+		"%u s\n", kip_sync_backoff);
+	return -1;
+}
 
 int kip_monitor_init(void)
 {
+	struct fib6_usage fu;
 	int ret;
 	unsigned int groups = 0;
 
@@ -21,17 +594,65 @@ int kip_monitor_init(void)
 	groups |= nl_mgrp(RTNLGRP_IPV6_PREFIX);
 	groups |= nl_mgrp(RTNLGRP_NEIGH);
 	//groups |= nl_mgrp(RTNLGRP_IPV4_NETCONF);
-	//groups |= nl_mgrp(RTNLGRP_IPV6_NETCONF);
+	groups |= nl_mgrp(RTNLGRP_IPV6_NETCONF);
 	groups |= nl_mgrp(RTNLGRP_IPV4_RULE);
 	groups |= nl_mgrp(RTNLGRP_IPV6_RULE);
 	//groups |= nl_mgrp(RTNLGRP_NSID);
 
+	/*
+	 * No NETLINK_NO_ENOBUFS on rth: the mirror stays consistent only
+	 * as long as we learn of every lost event, to resync.
+	 */
 	if ((ret = rtnl_open(&rth, groups)) < 0) {
 		return ret;
 	}
+	kip_rcvbuf = KIP_RCVBUF;
+	if (rtnl_rcvbuf(&rth, kip_rcvbuf) < 0)
+		return -1;
+	if ((ret = rtnl_open(&rth_dump, 0)) < 0)
+		return ret;
+
+	if (kip_monitor_dumpall() < 0)
+		return -1;
+
+	fib6_usage(&fu);
+	RTE_LOG(INFO, APP, "IPv6 FIB: %u prefixes, %u tbl8 groups, "
+		"%zu bytes per prefix (%zu fixed, per socket)\n",
+		fu.fu_rules, fu.fu_tbl8, fu.fu_per_rule, fu.fu_fixed);
+
+	return 0;
 }
 
-int kip_monitor_poll(void)
+/*
+ * Apply pending netlink events, at most budget of them, without blocking;
+ * returns the number applied.  A resync under way goes first, and one
+ * due again after failing starts.  rth overflowing gets it a larger
+ * receive buffer, and a resync.
+ */
+int kip_monitor_poll(unsigned int budget)
 {
+	int n, size;
 
+	if (rth.fd < 0)
+		return 0;
+	if (kip_sync_retry != 0 && rte_get_timer_cycles() >= kip_sync_retry)
+		kip_monitor_resync();
+	if (kip_sync_dump >= 0)
+		return kip_monitor_resync_poll(budget);
+	n = rtnl_listen_budget(&rth, kip_monitor_accept, NULL, budget);
+	if (n == -ENOBUFS) {
+		RTE_LOG(WARNING, APP, "netlink monitor: events lost, "
+			"resyncing\n");
+		if (kip_rcvbuf < KIP_RCVBUF_MAX) {
+			kip_rcvbuf *= 2;
+			size = rtnl_rcvbuf(&rth, kip_rcvbuf);
+			RTE_LOG(INFO, APP, "netlink monitor: receive buffer "
+				"%d\n", size);
+		}
+		kip_monitor_resync();
+		return 0;
+	}
+	if (n < 0)
+		RTE_LOG(WARNING, APP, "netlink monitor: cannot receive\n");
+	return n;
 }
@@ -0,0 +1,12 @@
+#ifndef __KIP_MONITOR_H__
+#define __KIP_MONITOR_H__
+
+/*
+ * Kernel interface monitor: mirrors the kernel's view of the KNI
+ * interfaces (links, VLANs on top of them and their addresses) into the
+ * ifnet table, from an initial dump and then from netlink events.
+ */
+int kip_monitor_init(void);
+int kip_monitor_poll(unsigned int budget);
+
+#endif /* __KIP_MONITOR_H__ */
@@ -74,6 +74,18 @@
 #include <rte_malloc.h>
 #include <rte_kni.h>
 
+#include "net/ethernet.h"
+#include "net/epoch.h"
+#include "net/if_arp.h"
+#include "net/if_llatbl.h"
+#include "net/netisr.h"
+#include "netinet/in_fib.h"
+#include "netinet/ip_var.h"
+#include "netinet6/in6_fib.h"
+#include "netinet6/ip6_var.h"
+#include "netinet6/nd6.h"
+#include "kip_monitor.h"
+
 /* Macros for printing using RTE_LOG */
 #define RTE_LOGTYPE_APP RTE_LOGTYPE_USER1
 
@@ -83,9 +95,20 @@
 /* Size of the data buffer in each mbuf */
 #define MBUF_DATA_SZ (MAX_PACKET_SZ + RTE_PKTMBUF_HEADROOM)
 
+/* Max size of a jumbo frame, received scattered over several mbufs */
+#define MAX_JUMBO_PKT_SZ        9728
+
+/* Mbufs to pass jumbo frames to KNI in one piece, see kni_linearize() */
+#define NB_JUMBO_MBUF           1024
+#define JUMBO_MBUF_DATA_SZ (MAX_JUMBO_PKT_SZ + RTE_PKTMBUF_HEADROOM)
+
 /* Number of mbufs in mempool that is created */
 #define NB_MBUF                 (8192 * 16)
 
+/* RX queue per dataplane lcore, TX queue per lcore */
+#define PORT_NB_RXQ             (rte_lcore_count() - 1)
+#define PORT_NB_TXQ             rte_lcore_count()
+
 /* How many packets to attempt to read from NIC in one go */
 #define PKT_BURST_SZ            32
 
@@ -108,6 +131,16 @@
 #define KNI_SECOND_PER_DAY      86400
 
 #define KNI_MAX_KTHREAD 32
+
+/* Most deferred netisr packets handled per dataplane loop iteration */
+#define NETISR_POLL_BUDGET      (4 * PKT_BURST_SZ)
+
+/* Most ARP packets the control lcore learns from per loop iteration */
+#define ARP_POLL_BUDGET         PKT_BURST_SZ
+/* Likewise for neighbour discovery */
+#define ND6_POLL_BUDGET         PKT_BURST_SZ
+/* Most netlink events mirrored per loop iteration */
+#define KIP_POLL_BUDGET         64
 /*
  * Structure of port parameters
  */
@@ -119,6 +152,7 @@ struct kni_port_params {
 	uint32_t nb_kni; /* Number of KNI devices to be created */
 	unsigned lcore_k[KNI_MAX_KTHREAD]; /* lcore ID list for kthreads */
 	struct rte_kni *kni[KNI_MAX_KTHREAD]; /* KNI context pointers */
+	struct ifnet *ifp; /* The port's ifnet in the stack */
 } __rte_cache_aligned;
 
 static struct kni_port_params *kni_port_params_array[RTE_MAX_ETHPORTS];
@@ -150,6 +184,9 @@ static struct rte_eth_conf port_conf = {
 /* Mempool for mbufs */
 static struct rte_mempool * pktmbuf_pool = NULL;
 
+/* Mempool for jumbo frames on their way to KNI */
+static struct rte_mempool * jumbo_pool = NULL;
+
 /* Mask of enabled ports */
 static uint32_t ports_mask = 0;
 /* Ports set in promiscuous mode off by default. */
@@ -184,15 +221,103 @@ static struct rte_ring *ctrlplane_ring;
 
 struct ctrlplane_queue_elem {
 	unsigned lcore_id;
-	uint8_t port_id;
 	unsigned nb_pkts;
 	struct rte_mbuf *pkts_burst[PKT_BURST_SZ];
 };
 
 static struct rte_mempool *ctrlplane_queue_pool;
 
+/*
+ * Frames the stack passes to the kernel, staged per lcore and handed to
+ * the control lcore a burst at a time, see kni_stage().
+ */
+static struct ctrlplane_queue_elem *kni_staged[RTE_MAX_LCORE];
+
 #define CTRLPLANE_QUEUE_POOL_SIZE 8192
 
+/* Print out the protocol statistics, summed over the lcores, netstat -s style */
+static void
+print_proto_stats(void)
+{
+	struct arpstat arps;
+	struct ipstat ips;
+	struct ip6stat ip6s;
+	struct nd6stat nd6s;
+
+	ARPSTAT_FETCH(&arps);
+	IPSTAT_FETCH(&ips);
+	IP6STAT_FETCH(&ip6s);
+	ND6STAT_FETCH(&nd6s);
+
+	printf("\n**Protocol statistics**\n"
+	       "arp:\n"
+	       "\t%"PRIu64" ARP packets received\n"
+	       "\t%"PRIu64" ARP requests received\n"
+	       "\t%"PRIu64" ARP replies received\n"
+	       "\t%"PRIu64" ARP requests sent\n"
+	       "\t%"PRIu64" ARP replies sent\n"
+	       "\t%"PRIu64" packets dropped waiting for a reply\n"
+	       "\t%"PRIu64" entries timed out\n"
+	       "\t%"PRIu64" duplicate IPs seen\n",
+	       arps.received, arps.rxrequests, arps.rxreplies,
+	       arps.txrequests, arps.txreplies, arps.dropped, arps.timeouts,
+	       arps.dupips);
+	printf("ip:\n"
+	       "\t%"PRIu64" total packets received\n"
+	       "\t%"PRIu64" bad header checksums\n"
+	       "\t%"PRIu64" with size smaller than minimum\n"
+	       "\t%"PRIu64" with data size < data length\n"
+	       "\t%"PRIu64" with header length < data size\n"
+	       "\t%"PRIu64" with data length < header length\n"
+	       "\t%"PRIu64" with incorrect version number\n"
+	       "\t%"PRIu64" fragments received\n"
+	       "\t%"PRIu64" packets for this host\n"
+	       "\t%"PRIu64" packets for virtual services\n"
+	       "\t%"PRIu64" packets for unknown/unsupported protocol\n"
+	       "\t%"PRIu64" packets forwarded\n"
+	       "\t%"PRIu64" packets not forwardable\n"
+	       "\t%"PRIu64" packets with no route\n"
+	       "\t%"PRIu64" datagrams that can't be fragmented\n",
+	       ips.ips_total, ips.ips_badsum, ips.ips_tooshort,
+	       ips.ips_toosmall, ips.ips_badhlen, ips.ips_badlen,
+	       ips.ips_badvers, ips.ips_fragments, ips.ips_delivered,
+	       ips.ips_vip, ips.ips_noproto, ips.ips_forward,
+	       ips.ips_cantforward, ips.ips_noroute, ips.ips_cantfrag);
+	printf("ip6:\n"
+	       "\t%"PRIu64" total packets received\n"
+	       "\t%"PRIu64" with size smaller than minimum\n"
+	       "\t%"PRIu64" with data size < data length\n"
+	       "\t%"PRIu64" with incorrect version number\n"
+	       "\t%"PRIu64" with bad options\n"
+	       "\t%"PRIu64" with too many headers\n"
+	       "\t%"PRIu64" with scope errors\n"
+	       "\t%"PRIu64" fragments received\n"
+	       "\t%"PRIu64" packets for this host\n"
+	       "\t%"PRIu64" packets for unknown/unsupported protocol\n"
+	       "\t%"PRIu64" packets forwarded\n"
+	       "\t%"PRIu64" packets not forwardable\n"
+	       "\t%"PRIu64" packets with no route\n"
+	       "\t%"PRIu64" packets too big to forward\n",
+	       ip6s.ip6s_total, ip6s.ip6s_tooshort, ip6s.ip6s_toosmall,
+	       ip6s.ip6s_badvers, ip6s.ip6s_badoptions, ip6s.ip6s_toomanyhdr,
+	       ip6s.ip6s_badscope, ip6s.ip6s_fragments, ip6s.ip6s_delivered,
+	       ip6s.ip6s_noproto, ip6s.ip6s_forward, ip6s.ip6s_cantforward,
+	       ip6s.ip6s_noroute, ip6s.ip6s_cantfrag);
+	printf("nd6:\n"
+	       "\t%"PRIu64" neighbor solicitations received\n"
+	       "\t%"PRIu64" neighbor advertisements received\n"
+	       "\t%"PRIu64" neighbor solicitations sent\n"
+	       "\t%"PRIu64" neighbor advertisements sent\n"
+	       "\t%"PRIu64" bad checksums\n"
+	       "\t%"PRIu64" bad messages\n"
+	       "\t%"PRIu64" ICMPv6 messages passed to the host\n"
+	       "\t%"PRIu64" packets dropped waiting for resolution\n"
+	       "\t%"PRIu64" resolutions timed out\n",
+	       nd6s.nd6s_rxns, nd6s.nd6s_rxna, nd6s.nd6s_txns,
+	       nd6s.nd6s_txna, nd6s.nd6s_checksum, nd6s.nd6s_badmsg,
+	       nd6s.nd6s_noproto, nd6s.nd6s_dropped, nd6s.nd6s_timeouts);
+}
+
 /* Print out statistics on packets handled */
 static void
 print_stats(void)
@@ -217,6 +342,7 @@ print_stats(void)
 						kni_stats[i].tx_dropped);
 	}
 	printf("======  ==============  ============  ============  ============  ============\n");
+	print_proto_stats();
 }
 
 /* Custom handling of signals to handle stats and kni processing */
@@ -231,6 +357,10 @@ signal_handler(int signum)
 	/* When we receive a USR2 signal, reset stats */
 	if (signum == SIGUSR2) {
 		memset(&kni_stats, 0, sizeof(kni_stats));
+		PCPUSTAT_RESET(arpstat);
+		PCPUSTAT_RESET(ipstat);
+		PCPUSTAT_RESET(ip6stat);
+		PCPUSTAT_RESET(nd6stat);
 		printf("\n**Statistics have been reset**\n");
 		return;
 	}
@@ -258,13 +388,50 @@ kni_burst_free_mbufs(struct rte_mbuf **pkts, unsigned num)
 	}
 }
 
+/*
+ * KNI only passes the first segment of an mbuf to the kernel: copy a frame
+ * the NIC scattered into one jumbo mbuf.  The control lcore is the only
+ * one doing it, and only for the frames the stack leaves to the kernel.
+ */
+static struct rte_mbuf *
+kni_linearize(struct rte_mbuf *m)
+{
+	struct rte_mbuf *n, *seg;
+	char *data;
+
+	n = rte_pktmbuf_alloc(jumbo_pool);
+	if (n == NULL)
+		goto drop;
+	data = rte_pktmbuf_append(n, rte_pktmbuf_pkt_len(m));
+	if (data == NULL) {
+		rte_pktmbuf_free(n);
+		goto drop;
+	}
+	for (seg = m; seg != NULL; seg = seg->next) {
+		rte_memcpy(data, rte_pktmbuf_mtod(seg, char *), seg->data_len);
+		data += seg->data_len;
+	}
+	n->port = m->port;
+	n->ol_flags = m->ol_flags;
+	n->vlan_tci = m->vlan_tci;
+	n->vlan_tci_outer = m->vlan_tci_outer;
+	n->packet_type = m->packet_type;
+	n->udata64 = m->udata64;
+	rte_pktmbuf_free(m);
+	return n;
+
+drop:
+	rte_pktmbuf_free(m);
+	return NULL;
+}
+
 /**
  * Interface to burst rx and enqueue mbufs into rx_q
  */
 static void
 kni_ingress(struct kni_port_params *p, struct rte_mbuf **pkts_burst, unsigned nb_rx)
 {
-	uint8_t i, port_id;
+	uint8_t i, j, port_id;
 	unsigned num;
 	uint32_t nb_kni;
 
@@ -273,6 +440,20 @@ kni_ingress(struct kni_port_params *p, struct rte_mbuf **pkts_burst, unsigned nb
 
 	nb_kni = p->nb_kni;
 	port_id = p->port_id;
+
+	/* KNI only passes single segment mbufs to the kernel */
+	for (i = j = 0; i < nb_rx; i++) {
+		if (unlikely(pkts_burst[i]->nb_segs > 1)) {
+			pkts_burst[i] = kni_linearize(pkts_burst[i]);
+			if (pkts_burst[i] == NULL) {
+				kni_stats[port_id].rx_dropped++;
+				continue;
+			}
+		}
+		pkts_burst[j++] = pkts_burst[i];
+	}
+	nb_rx = j;
+
 	for (i = 0; i < nb_kni; i++) {
 		/* Burst tx to kni */
 		num = rte_kni_tx_burst(p->kni[i], pkts_burst, nb_rx);
@@ -286,6 +467,82 @@ kni_ingress(struct kni_port_params *p, struct rte_mbuf **pkts_burst, unsigned nb
 	}
 }
 
+/*
+ * Pass the frames staged on this lcore to the control lcore.
+ */
+static void
+kni_stage_flush(void)
+{
+	struct ctrlplane_queue_elem *elem;
+	unsigned lcore_id, i;
+
+	lcore_id = rte_lcore_id();
+	elem = kni_staged[lcore_id];
+	if (elem == NULL)
+		return;
+	kni_staged[lcore_id] = NULL;
+	if (rte_ring_enqueue(ctrlplane_ring, (void *)elem)) {
+		for (i = 0; i < elem->nb_pkts; i++)
+			kni_stats[elem->pkts_burst[i]->port].rx_dropped++;
+		kni_burst_free_mbufs(elem->pkts_burst, elem->nb_pkts);
+		rte_mempool_put(ctrlplane_queue_pool, elem);
+		RTE_LOG(ERR, APP, "rte_ring_enqueue(ctrlplane_ring) failed\n");
+	}
+}
+
+/*
+ * Stage a frame for the kernel; registered with the stack as where the
+ * frames it does not consume go, and called by EAL lcores only.
+ */
+static void
+kni_stage(struct rte_mbuf *m)
+{
+	struct ctrlplane_queue_elem *elem;
+	unsigned lcore_id;
+
+	lcore_id = rte_lcore_id();
+	elem = kni_staged[lcore_id];
+	if (elem == NULL) {
+		if (rte_mempool_get(ctrlplane_queue_pool, (void *)&elem) != 0) {
+			kni_stats[m->port].rx_dropped++;
+			rte_pktmbuf_free(m);
+			return;
+		}
+		elem->lcore_id = lcore_id;
+		elem->nb_pkts = 0;
+		kni_staged[lcore_id] = elem;
+	}
+	elem->pkts_burst[elem->nb_pkts++] = m;
+	if (elem->nb_pkts == PKT_BURST_SZ)
+		kni_stage_flush();
+}
+
+/*
+ * Pass a staged burst, which may mix ports, to the KNI interfaces.
+ */
+static void
+kni_ingress_elem(struct ctrlplane_queue_elem *elem)
+{
+	uint8_t port_id;
+	unsigned i, j;
+
+	for (i = 0; i < elem->nb_pkts; i = j) {
+		port_id = elem->pkts_burst[i]->port;
+		for (j = i + 1; j < elem->nb_pkts &&
+		    elem->pkts_burst[j]->port == port_id; j++)
+			;
+		if (kni_port_params_array[port_id])
+			kni_ingress(kni_port_params_array[port_id],
+				    &elem->pkts_burst[i], j - i);
+		else
+			kni_burst_free_mbufs(&elem->pkts_burst[i], j - i);
+	}
+}
+
+/*
+ * Burst rx from eth into the stack; what it does not consume reaches the
+ * kernel through kni_stage().
+ */
 static void
 dataplane_rx(struct kni_port_params *p, unsigned int lcore_id)
 {
@@ -302,8 +559,6 @@ dataplane_rx(struct kni_port_params *p, unsigned int lcore_id)
 	port_id = p->port_id;
 	queue_id = rte_lcore_index(lcore_id) - 1;
 	for (i = 0; i < nb_kni; i++) {
-		struct ctrlplane_queue_elem *elem;
-
 		/* Burst rx from eth */
 		nb_rx = rte_eth_rx_burst(port_id, queue_id, pkts_burst, PKT_BURST_SZ);
 		if (unlikely(nb_rx > PKT_BURST_SZ)) {
@@ -314,28 +569,7 @@ dataplane_rx(struct kni_port_params *p, unsigned int lcore_id)
 		if (0 == nb_rx)
 			return;
 
-		/* Enqueue to ctrlplane ring */
-		if (rte_mempool_get(ctrlplane_queue_pool, (void *)&elem) != 0) {
-			kni_stats[port_id].rx_dropped += nb_rx;
-			RTE_LOG(ERR, APP, "rte_mempool_get failed\n");	
-			rte_atomic32_inc(&kni_stop);		
-			return;
-		}
-
-		rte_memcpy(elem->pkts_burst, pkts_burst, sizeof(pkts_burst));
-		elem->lcore_id = lcore_id;
-		elem->port_id = port_id;
-		elem->nb_pkts = nb_rx;
-		
-		if (rte_ring_enqueue(ctrlplane_ring, (void *)elem)) {
-			kni_stats[port_id].rx_dropped += nb_rx;
-			RTE_LOG(ERR, APP, "rte_ring_enqueue(ctrlplane_ring) failed\n");
-		}
-		/*
-		RTE_LOG(DEBUG, APP, "ctrlplane ring enqueue elem "
-			"(core%u queue%u nb%u)\n", elem->lcore_id,
-			queue_id, elem->nb_pkts);
-		*/
+		ether_input(p->ifp, pkts_burst, nb_rx);
 	}
 }
 
@@ -388,6 +622,7 @@ dataplane_loop(__rte_unused void *arg)
 
 	nb_ports = (uint8_t)(nb_ports < RTE_MAX_ETHPORTS ?
 				nb_ports : RTE_MAX_ETHPORTS);
+	epoch_online();
 	while (1) {
 		f_stop = rte_atomic32_read(&kni_stop);
 		if (f_stop)
@@ -399,7 +634,16 @@ dataplane_loop(__rte_unused void *arg)
 			
 			dataplane_rx(kni_port_params_array[i], lcore_id);
 		}
+
+		/* Service deferred protocol work, bounded per iteration */
+		netisr_poll(NETISR_POLL_BUDGET);
+		ether_flush();
+		kni_stage_flush();
+
+		/* No references into shared tables are held past here */
+		epoch_quiescent();
 	}
+	epoch_offline();
 
 	return 0;
 }
@@ -419,13 +663,18 @@ ctrlplane_loop(void)
 			break;
 
 		if (rte_ring_dequeue(ctrlplane_ring, (void **)&elem) == 0) {
-			if (kni_port_params_array[elem->port_id]) {
-				kni_ingress(kni_port_params_array[elem->port_id],
-					    elem->pkts_burst, elem->nb_pkts);
-			}
+			kni_ingress_elem(elem);
 			rte_mempool_put(ctrlplane_queue_pool, elem);
 		}
 
+		arp_poll(ARP_POLL_BUDGET);
+		nd6_poll(ND6_POLL_BUDGET);
+		kip_monitor_poll(KIP_POLL_BUDGET);
+		garp_poll();
+		epoch_poll();
+		ether_flush();
+		kni_stage_flush();
+
 		for (i = 0; i < nb_ports; i++) {
 			if (!kni_port_params_array[i])
 				continue;
@@ -682,20 +931,42 @@ init_kni(void)
 	rte_kni_init(num_of_kni_ports);
 }
 
+/* Port configuration, with the offloads the port supports turned on */
+static void
+init_port_conf(uint8_t port, struct rte_eth_conf *conf)
+{
+	struct rte_eth_dev_info dev_info;
+
+	memcpy(conf, &port_conf, sizeof(*conf));
+
+	memset(&dev_info, 0, sizeof(dev_info));
+	rte_eth_dev_info_get(port, &dev_info);
+	/*
+	 * Strip 802.1Q tags into the mbuf where the port gets
+	 * IFCAP_VLAN_HWTAGGING, as net/if_vlan.c only trusts the flags then
+	 */
+	if ((dev_info.rx_offload_capa & DEV_RX_OFFLOAD_VLAN_STRIP) &&
+	    (dev_info.tx_offload_capa & DEV_TX_OFFLOAD_VLAN_INSERT))
+		conf->rxmode.hw_vlan_strip = 1;
+}
+
 /* Initialise a single port on an Ethernet device */
 static void
 init_port(uint8_t port)
 {
+	struct rte_eth_conf conf;
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_txconf txconf;
 	int ret;
 	unsigned i;
-	unsigned lcore_count = rte_lcore_count();
-	uint16_t nb_rx_q = lcore_count - 1; 
-	uint16_t nb_tx_q = lcore_count; 
+	uint16_t nb_rx_q = PORT_NB_RXQ;
+	uint16_t nb_tx_q = PORT_NB_TXQ;
 
 	/* Initialise device and RX/TX queues */
 	RTE_LOG(INFO, APP, "Initialising port %u ...\n", (unsigned)port);
 	fflush(stdout);
-	ret = rte_eth_dev_configure(port, nb_rx_q, nb_tx_q, &port_conf);
+	init_port_conf(port, &conf);
+	ret = rte_eth_dev_configure(port, nb_rx_q, nb_tx_q, &conf);
 	if (ret < 0)
 		rte_exit(EXIT_FAILURE, "Could not configure port%u (%d)\n",
 		            (unsigned)port, ret);
@@ -709,9 +980,19 @@ init_port(uint8_t port)
 	}
 
 	
+	/*
+	 * Jumbo frames are received scattered and sent as they are, and
+	 * 802.1Q tags inserted by the NIC: keep the PMD off its simple TX
+	 * path, which does neither.
+	 */
+	memset(&dev_info, 0, sizeof(dev_info));
+	rte_eth_dev_info_get(port, &dev_info);
+	txconf = dev_info.default_txconf;
+	txconf.txq_flags &= ~(ETH_TXQ_FLAGS_NOMULTSEGS |
+				ETH_TXQ_FLAGS_NOVLANOFFL);
 	for (i = 0; i < nb_tx_q; i++) {
 		ret = rte_eth_tx_queue_setup(port, i, NB_TXD,
-			rte_eth_dev_socket_id(port), NULL);
+			rte_eth_dev_socket_id(port), &txconf);
 		if (ret < 0)
 			rte_exit(EXIT_FAILURE, "Could not setup up TX queue for "
 					"port%u queue%d (%d)\n", (unsigned)port, i, ret);
@@ -724,6 +1005,12 @@ init_port(uint8_t port)
 
 	if (promiscuous_on)
 		rte_eth_promiscuous_enable(port);
+
+	/* Attach the port's ifnet to the stack */
+	kni_port_params_array[port]->ifp = ether_ifattach(port);
+	if (kni_port_params_array[port]->ifp == NULL)
+		rte_exit(EXIT_FAILURE, "Could not attach port%u\n",
+						(unsigned)port);
 }
 
 /* Check the link status of all ports in up to 9s, and print them finally */
@@ -793,12 +1080,20 @@ kni_change_mtu(uint8_t port_id, unsigned new_mtu)
 		return -EINVAL;
 	}
 
+	/* Frames larger than a jumbo mbuf could not reach the kernel */
+	if (new_mtu + KNI_ENET_HEADER_SIZE + KNI_ENET_FCS_SIZE >
+	    MAX_JUMBO_PKT_SZ) {
+		RTE_LOG(ERR, APP, "MTU %u of port %d too large\n", new_mtu,
+			port_id);
+		return -EINVAL;
+	}
+
 	RTE_LOG(INFO, APP, "Change MTU of port %d to %u\n", port_id, new_mtu);
 
 	/* Stop specific port */
 	rte_eth_dev_stop(port_id);
 
-	memcpy(&conf, &port_conf, sizeof(conf));
+	init_port_conf(port_id, &conf);
 	/* Set new MTU */
 	if (new_mtu > ETHER_MAX_LEN)
 		conf.rxmode.jumbo_frame = 1;
@@ -808,7 +1103,10 @@ kni_change_mtu(uint8_t port_id, unsigned new_mtu)
 	/* mtu + length of header + length of FCS = max pkt length */
 	conf.rxmode.max_rx_pkt_len = new_mtu + KNI_ENET_HEADER_SIZE +
 							KNI_ENET_FCS_SIZE;
-	ret = rte_eth_dev_configure(port_id, 1, 1, &conf);
+	/* Chain mbufs rather than use buffers as large as a jumbo frame */
+	if (conf.rxmode.max_rx_pkt_len > MAX_PACKET_SZ)
+		conf.rxmode.enable_scatter = 1;
+	ret = rte_eth_dev_configure(port_id, PORT_NB_RXQ, PORT_NB_TXQ, &conf);
 	if (ret < 0) {
 		RTE_LOG(ERR, APP, "Fail to reconfigure port %d\n", port_id);
 		return ret;
@@ -953,6 +1251,20 @@ main(int argc, char** argv)
 	if (ret < 0)
 		rte_exit(EXIT_FAILURE, "Could not parse input parameters\n");
 
+	/* Attach dataplane lcores to netisr before protocols register */
+	netisr_init();
+	ether_init();
+	if (lltable_init() != 0 || arp_init() != 0 || garp_init() != 0)
+		rte_exit(EXIT_FAILURE, "Could not initialize ARP\n");
+	ip_init();
+	if (fib4_init() != 0)
+		rte_exit(EXIT_FAILURE, "Could not initialize IPv4 FIB\n");
+	ip6_init();
+	if (fib6_init() != 0)
+		rte_exit(EXIT_FAILURE, "Could not initialize IPv6 FIB\n");
+	if (nd6_init() != 0)
+		rte_exit(EXIT_FAILURE, "Could not initialize ND\n");
+
 	/* Create the mbuf pool */
 	pktmbuf_pool = rte_pktmbuf_pool_create("mbuf_pool", NB_MBUF,
 		MEMPOOL_CACHE_SZ, 0, MBUF_DATA_SZ, rte_socket_id());
@@ -960,6 +1272,12 @@ main(int argc, char** argv)
 		rte_exit(EXIT_FAILURE, "Could not initialise mbuf pool\n");
 		return -1;
 	}
+	jumbo_pool = rte_pktmbuf_pool_create("jumbo_pool", NB_JUMBO_MBUF,
+		MEMPOOL_CACHE_SZ, 0, JUMBO_MBUF_DATA_SZ, rte_socket_id());
+	if (jumbo_pool == NULL) {
+		rte_exit(EXIT_FAILURE, "Could not initialise jumbo mbuf pool\n");
+		return -1;
+	}
 
 	ctrlplane_queue_pool = rte_mempool_create("ctrl_q_pool",
 		CTRLPLANE_QUEUE_POOL_SIZE, sizeof(struct ctrlplane_queue_elem),
@@ -976,6 +1294,7 @@ main(int argc, char** argv)
 		rte_exit(EXIT_FAILURE, "Could not initialise ctrlplane_ring\n");
 		return -1;
 	}
+	ether_host_register(kni_stage);
 
 	/* Get number of ports found in scan */
 	nb_sys_ports = rte_eth_dev_count();
@@ -1006,6 +1325,10 @@ main(int argc, char** argv)
 	}
 	check_all_ports_link_status(nb_sys_ports, ports_mask);
 
+	/* Fill in the ifnet table from the KNI interfaces */
+	if (kip_monitor_init() < 0)
+		rte_exit(EXIT_FAILURE, "Could not initialise kernel monitor\n");
+
 	/* Launch per-lcore function on every lcore */
 	rte_eal_mp_remote_launch(dataplane_loop, NULL, SKIP_MASTER);
 	ctrlplane_loop();
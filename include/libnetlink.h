@@ -156,6 +156,11 @@ static inline const char *rta_getattr_str(const struct rtattr *rta)
 int rtnl_listen_all_nsid(struct rtnl_handle *);
 int rtnl_listen(struct rtnl_handle *, rtnl_listen_filter_t handler,
 		void *jarg);
+int rtnl_listen_budget(struct rtnl_handle *, rtnl_listen_filter_t handler,
+		       void *jarg, int budget);
+int rtnl_dump_budget(struct rtnl_handle *rth, rtnl_filter_t filter,
+		     void *arg, int budget, int *done);
+int rtnl_rcvbuf(struct rtnl_handle *rth, int size);
 int rtnl_from_file(FILE *, rtnl_listen_filter_t handler,
 		   void *jarg);
 
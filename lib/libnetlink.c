@@ -591,6 +591,245 @@ int rtnl_listen(struct rtnl_handle *rtnl,
 	}
 }
 
+/*
+ * Non-blocking rtnl_listen(): handle what is pending, at most budget
+ * messages, and return how many were handled.  Datagrams are received up
+ * to RTNL_MMSG_VLEN at a time, and the budget is checked between
+ * batches, so the messages of the last one may take it a few over;
+ * notifications come one message per datagram anyway.  A batch is always
+ * seen through: a message the handler fails is skipped, and a datagram
+ * that cannot be parsed to its end is given up on, but the rest of the
+ * batch is handled.  A socket that overflowed, or a datagram given up on,
+ * lost messages: -ENOBUFS is returned for the caller to resynchronize.
+ * The receive buffers are static: one caller at a time.
+ */
+#define RTNL_MMSG_VLEN	16
+#define RTNL_MMSG_SIZE	32768
+
+int rtnl_listen_budget(struct rtnl_handle *rtnl,
+		       rtnl_listen_filter_t handler,
+		       void *jarg, int budget)
+{
+	static char buf[RTNL_MMSG_VLEN][RTNL_MMSG_SIZE];
+	static char cmsgbuf[RTNL_MMSG_VLEN][CMSG_SPACE(sizeof(int))];
+	struct sockaddr_nl nladdr[RTNL_MMSG_VLEN];
+	struct iovec iov[RTNL_MMSG_VLEN];
+	struct mmsghdr mmsg[RTNL_MMSG_VLEN];
+	int status, done = 0, lost = 0;
+	int i, vlen;
+	struct nlmsghdr *h;
+
+	while (done < budget && !lost) {
+		vlen = MIN(budget - done, RTNL_MMSG_VLEN);
+		memset(mmsg, 0, vlen * sizeof(mmsg[0]));
+		for (i = 0; i < vlen; i++) {
+			iov[i].iov_base = buf[i];
+			iov[i].iov_len = sizeof(buf[i]);
+			mmsg[i].msg_hdr.msg_name = &nladdr[i];
+			mmsg[i].msg_hdr.msg_namelen = sizeof(nladdr[i]);
+			mmsg[i].msg_hdr.msg_iov = &iov[i];
+			mmsg[i].msg_hdr.msg_iovlen = 1;
+			if (rtnl->flags & RTNL_HANDLE_F_LISTEN_ALL_NSID) {
+				mmsg[i].msg_hdr.msg_control = cmsgbuf[i];
+				mmsg[i].msg_hdr.msg_controllen =
+					sizeof(cmsgbuf[i]);
+			}
+		}
+		vlen = recvmmsg(rtnl->fd, mmsg, vlen, MSG_DONTWAIT, NULL);
+
+		if (vlen < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			if (errno == ENOBUFS)
+				return -ENOBUFS;
+			fprintf(stderr, "netlink receive error %s (%d)\n",
+				strerror(errno), errno);
+			return -1;
+		}
+
+		for (i = 0; i < vlen; i++) {
+			struct msghdr *msg = &mmsg[i].msg_hdr;
+			struct rtnl_ctrl_data ctrl;
+			struct cmsghdr *cmsg;
+
+			status = mmsg[i].msg_len;
+			if (status == 0) {
+				fprintf(stderr, "EOF on netlink\n");
+				lost = 1;
+				continue;
+			}
+			if (msg->msg_namelen != sizeof(nladdr[i])) {
+				fprintf(stderr, "Sender address length == %d\n",
+					msg->msg_namelen);
+				continue;
+			}
+
+			memset(&ctrl, 0, sizeof(ctrl));
+			ctrl.nsid = -1;
+			if (rtnl->flags & RTNL_HANDLE_F_LISTEN_ALL_NSID) {
+				for (cmsg = CMSG_FIRSTHDR(msg); cmsg;
+				     cmsg = CMSG_NXTHDR(msg, cmsg))
+					if (cmsg->cmsg_level == SOL_NETLINK &&
+					    cmsg->cmsg_type == NETLINK_LISTEN_ALL_NSID &&
+					    cmsg->cmsg_len == CMSG_LEN(sizeof(int))) {
+						int *data = (int *)CMSG_DATA(cmsg);
+
+						ctrl.nsid = *data;
+					}
+			}
+
+			for (h = (struct nlmsghdr *)buf[i];
+			     status >= sizeof(*h); ) {
+				int err;
+				int len = h->nlmsg_len;
+				int l = len - sizeof(*h);
+
+				if (l < 0 || len > status) {
+					if (msg->msg_flags & MSG_TRUNC)
+						fprintf(stderr, "Truncated message\n");
+					else
+						fprintf(stderr, "!!!malformed message: len=%d\n", len);
+					lost = 1;
+					break;
+				}
+
+				err = handler(&nladdr[i], &ctrl, h, jarg);
+				if (err < 0)
+					fprintf(stderr, "Message type %d not handled (%d)\n",
+						h->nlmsg_type, err);
+				done++;
+
+				status -= NLMSG_ALIGN(len);
+				h = (struct nlmsghdr *)((char *)h + NLMSG_ALIGN(len));
+			}
+			if (lost)
+				continue;
+			if (msg->msg_flags & MSG_TRUNC) {
+				/* The rest of the datagram is lost. */
+				fprintf(stderr, "Message truncated\n");
+				lost = 1;
+			} else if (status) {
+				fprintf(stderr, "!!!Remnant of size %d\n", status);
+				lost = 1;
+			}
+		}
+	}
+	return lost ? -ENOBUFS : done;
+}
+
+/*
+ * Non-blocking rtnl_dump_filter() for one dump requested on rth: handle
+ * the messages of the dump that are there, at most budget of them, checked
+ * between datagrams, and return how many were handled; *done is set once
+ * the end of the dump was seen.  As in rtnl_listen_budget(), a message the
+ * filter fails is skipped.  -1 if the dump failed or lost messages, and so
+ * has to be done again.
+ */
+int rtnl_dump_budget(struct rtnl_handle *rth, rtnl_filter_t filter,
+		     void *arg, int budget, int *done)
+{
+	struct sockaddr_nl nladdr;
+	struct iovec iov;
+	struct msghdr msg = {
+		.msg_name = &nladdr,
+		.msg_namelen = sizeof(nladdr),
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+	};
+	char buf[32768];
+	struct nlmsghdr *h;
+	int status, msglen, err, handled = 0;
+
+	*done = 0;
+	iov.iov_base = buf;
+	while (handled < budget) {
+		iov.iov_len = sizeof(buf);
+		status = recvmsg(rth->fd, &msg, MSG_DONTWAIT);
+
+		if (status < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "netlink receive error %s (%d)\n",
+				strerror(errno), errno);
+			return -1;
+		}
+		if (status == 0) {
+			fprintf(stderr, "EOF on netlink\n");
+			return -1;
+		}
+		if (msg.msg_flags & MSG_TRUNC) {
+			fprintf(stderr, "Message truncated\n");
+			return -1;
+		}
+
+		h = (struct nlmsghdr *)buf;
+		msglen = status;
+		for (; NLMSG_OK(h, msglen); h = NLMSG_NEXT(h, msglen)) {
+			if (nladdr.nl_pid != 0 ||
+			    h->nlmsg_pid != rth->local.nl_pid ||
+			    h->nlmsg_seq != rth->dump)
+				continue;
+
+			if (h->nlmsg_flags & NLM_F_DUMP_INTR)
+				fprintf(stderr,
+					"Dump was interrupted and may be inconsistent.\n");
+
+			if (h->nlmsg_type == NLMSG_DONE) {
+				*done = 1;
+				return handled;
+			}
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				struct nlmsgerr *e = (struct nlmsgerr *)NLMSG_DATA(h);
+
+				if (h->nlmsg_len < NLMSG_LENGTH(sizeof(*e)))
+					fprintf(stderr, "ERROR truncated\n");
+				else {
+					errno = -e->error;
+					perror("RTNETLINK answers");
+				}
+				return -1;
+			}
+
+			err = filter(&nladdr, h, arg);
+			if (err < 0)
+				fprintf(stderr, "Message type %d not handled (%d)\n",
+					h->nlmsg_type, err);
+			handled++;
+		}
+		if (msglen) {
+			fprintf(stderr, "!!!Remnant of size %d\n", msglen);
+			return -1;
+		}
+	}
+	return handled;
+}
+
+/*
+ * Set the receive buffer of rth to size bytes, past rmem_max if we may;
+ * returns the size the kernel settled on, or -1.
+ */
+int rtnl_rcvbuf(struct rtnl_handle *rth, int size)
+{
+	socklen_t len = sizeof(size);
+
+	if (setsockopt(rth->fd, SOL_SOCKET, SO_RCVBUFFORCE,
+		       &size, sizeof(size)) < 0 &&
+	    setsockopt(rth->fd, SOL_SOCKET, SO_RCVBUF,
+		       &size, sizeof(size)) < 0) {
+		perror("SO_RCVBUF");
+		return -1;
+	}
+	if (getsockopt(rth->fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0) {
+		perror("SO_RCVBUF");
+		return -1;
+	}
+	return size;
+}
+
 int rtnl_from_file(FILE *rtnl, rtnl_listen_filter_t handler,
 		   void *jarg)
 {
@@ -0,0 +1,82 @@
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+
+#include "epoch.h"
+
+struct epoch_pcpu	epoch_pcpu[RTE_MAX_LCORE];
+volatile uint64_t	epoch_current = 1;
+
+/* Unlinked objects, oldest first. */
+static TAILQ_HEAD(, epoch_context) epoch_pending =
+    TAILQ_HEAD_INITIALIZER(epoch_pending);
+
+/*
+ * The oldest epoch an online lcore may still hold references from.
+ */
+static uint64_t
+epoch_min_seen(void)
+{
+	uint64_t min, seen;
+	unsigned lcore;
+
+	min = epoch_current;
+	RTE_LCORE_FOREACH(lcore) {
+		seen = __atomic_load_n(&epoch_pcpu[lcore].ep_seen,
+		    __ATOMIC_ACQUIRE);
+		if (seen != 0 && seen < min)
+			min = seen;
+	}
+	return (min);
+}
+
+/*
+ * Defer cb until no reader can reach the object ctx is embedded in; the
+ * object must already be unlinked.
+ */
+void
+epoch_call(struct epoch_context *ctx, epoch_callback_t *cb)
+{
+
+	ctx->ec_callback = cb;
+	ctx->ec_epoch = __atomic_add_fetch(&epoch_current, 1,
+	    __ATOMIC_SEQ_CST);
+	TAILQ_INSERT_TAIL(&epoch_pending, ctx, ec_link);
+}
+
+/*
+ * Run the callbacks whose grace period is over; returns how many ran.
+ */
+u_int
+epoch_poll(void)
+{
+	struct epoch_context *ctx;
+	uint64_t min;
+	u_int n;
+
+	if (TAILQ_EMPTY(&epoch_pending))
+		return (0);
+	min = epoch_min_seen();
+	n = 0;
+	while ((ctx = TAILQ_FIRST(&epoch_pending)) != NULL &&
+	    ctx->ec_epoch <= min) {
+		TAILQ_REMOVE(&epoch_pending, ctx, ec_link);
+		ctx->ec_callback(ctx);
+		n++;
+	}
+	return (n);
+}
+
+/*
+ * Wait for a full grace period, then reclaim everything pending.
+ */
+void
+epoch_wait(void)
+{
+	uint64_t target;
+
+	target = __atomic_add_fetch(&epoch_current, 1, __ATOMIC_SEQ_CST);
+	while (epoch_min_seen() < target)
+		rte_pause();
+	epoch_poll();
+}
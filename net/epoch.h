@@ -0,0 +1,77 @@
+#ifndef _NET_EPOCH_H_
+#define	_NET_EPOCH_H_
+
+#include <sys/types.h>
+#include <sys/queue.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <rte_common.h>
+#include <rte_lcore.h>
+
+/*
+ * Quiescent-state based reclamation for read-mostly dataplane tables.
+ *
+ * Dataplane lcores read shared tables without locks or barriers, and
+ * announce a quiescent state, a point where they hold no reference into
+ * any of them, once per loop iteration with epoch_quiescent().  The
+ * control lcore is the only writer: it unlinks an object and passes it to
+ * epoch_call(), and epoch_poll() reclaims it once every online lcore has
+ * been through a quiescent state since.  An lcore that stops reading goes
+ * offline so as not to hold reclamation back.
+ */
+struct epoch_context;
+typedef void	epoch_callback_t(struct epoch_context *);
+
+struct epoch_context {
+	TAILQ_ENTRY(epoch_context) ec_link;
+	uint64_t	ec_epoch;		/* reclaimable once seen */
+	epoch_callback_t *ec_callback;
+};
+
+struct epoch_pcpu {
+	volatile uint64_t ep_seen;		/* 0 while offline */
+} __rte_cache_aligned;
+
+extern struct epoch_pcpu	epoch_pcpu[RTE_MAX_LCORE];
+extern volatile uint64_t	epoch_current;
+
+#define	epoch_containerof(ctx, type, field)				\
+	((type *)((char *)(ctx) - offsetof(type, field)))
+
+/*
+ * Reader side, on the lcore itself.
+ */
+static inline void
+epoch_quiescent(void)
+{
+
+	__atomic_store_n(&epoch_pcpu[rte_lcore_id()].ep_seen, epoch_current,
+	    __ATOMIC_RELEASE);
+}
+
+static inline void
+epoch_online(void)
+{
+
+	/* No table read may pass the store. */
+	__atomic_store_n(&epoch_pcpu[rte_lcore_id()].ep_seen, epoch_current,
+	    __ATOMIC_SEQ_CST);
+}
+
+static inline void
+epoch_offline(void)
+{
+
+	__atomic_store_n(&epoch_pcpu[rte_lcore_id()].ep_seen, 0,
+	    __ATOMIC_RELEASE);
+}
+
+/*
+ * Writer side, on the control lcore only.
+ */
+void	epoch_call(struct epoch_context *ctx, epoch_callback_t *cb);
+u_int	epoch_poll(void);
+void	epoch_wait(void);
+
+#endif /* _NET_EPOCH_H_ */
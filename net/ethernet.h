@@ -0,0 +1,65 @@
+/*
+ * Fundamental constants relating to ethernet.
+ *
+ * $FreeBSD$
+ *
+ */
+
+#ifndef _NET_ETHERNET_H_
+#define _NET_ETHERNET_H_
+
+#include <sys/types.h>
+
+#include <rte_common.h>
+#include <rte_ether.h>
+
+/*
+ * 802.1q Virtual LAN header.
+ */
+#define	EVL_VLID_MASK		0x0FFF
+#define	EVL_PRI_MASK		0xE000
+#define	EVL_VLANOFTAG(tag)	((tag) & EVL_VLID_MASK)
+#define	EVL_PRIOFTAG(tag)	(((tag) >> 13) & 7)
+#define	EVL_MAKETAG(vlid, pri, cfi)					\
+	((((((pri) & 7) << 1) | ((cfi) & 1)) << 12) | ((vlid) & EVL_VLID_MASK))
+
+struct ifnet;
+struct rte_mbuf;
+
+/*
+ * Ethernet header of a next hop, precomputed so that ether_output() lays it
+ * down with one 16-byte store: the header is the last 14 bytes, and the
+ * store also writes the 2 bytes of headroom in front of it.  A template is
+ * immutable once set: when the neighbour entry behind it changes, the
+ * entry invalidates it and sets up a new one.
+ */
+struct ether_l2tmpl {
+	uint8_t		et_hdr[16];
+	volatile int	et_valid;
+} __rte_aligned(16);
+
+void	ether_l2tmpl_set(struct ether_l2tmpl *, const struct ifnet *,
+	    const struct ether_addr *, uint16_t);
+void	ether_l2tmpl_invalidate(struct ether_l2tmpl *);
+int	ether_output(struct ifnet *, struct rte_mbuf *,
+	    const struct ether_l2tmpl *);
+void	ether_flush(void);
+
+void	ether_init(void);
+u_int	ether_rxfilter(uint8_t, struct rte_mbuf **, u_int);
+void	ether_input(struct ifnet *, struct rte_mbuf **, u_int);
+void	ether_demux(struct ifnet *, struct rte_mbuf *);
+void	ether_demux_burst(struct ifnet *, struct rte_mbuf **, u_int);
+void	ether_probe_ptypes(uint8_t);
+struct ifnet	*ether_ifattach(uint8_t);
+
+/*
+ * Frames the stack does not consume go to the host, the kernel behind the
+ * port's KNI interface, through the routine the application registers.
+ */
+typedef void	ether_host_input_t(struct rte_mbuf *);
+
+void	ether_host_register(ether_host_input_t *);
+void	ether_host_input(struct rte_mbuf *);
+
+#endif /* !_NET_ETHERNET_H_ */
@@ -0,0 +1,460 @@
+/*-
+ * Copyright (c) 1982, 1986, 1989, 1993
+ *	The Regents of the University of California.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	@(#)if.c	8.5 (Berkeley) 1/9/95
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <rte_ethdev.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+
+#include "if.h"
+#include "if_var.h"
+#include "if_vlan_var.h"
+
+#define RTE_LOGTYPE_NET RTE_LOGTYPE_USER1
+
+/*
+ * Interfaces of the DPDK ports, indexed by port ID.
+ */
+struct ifnet	*ifnet_byport[RTE_MAX_ETHPORTS];
+
+#define	IF_TXBURST	32
+
+/*
+ * TX buffers, per port and lcore.
+ */
+static struct rte_eth_dev_tx_buffer *if_txbuf[RTE_MAX_ETHPORTS][RTE_MAX_LCORE];
+
+/*
+ * Groups every port joins: IPv4 all-hosts and IPv6 all-nodes.
+ */
+static const struct ether_addr if_allhosts = {
+	.addr_bytes = { 0x01, 0x00, 0x5e, 0x00, 0x00, 0x01 }
+};
+static const struct ether_addr if_allnodes = {
+	.addr_bytes = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 }
+};
+
+struct ifnet *
+if_alloc(int socket)
+{
+	struct ifnet *ifp;
+
+	RTE_BUILD_BUG_ON(offsetof(struct ifnet, if_capabilities) >
+	    RTE_CACHE_LINE_SIZE);
+
+	ifp = rte_zmalloc_socket("ifnet", sizeof(*ifp), RTE_CACHE_LINE_SIZE,
+	    socket);
+	if (ifp == NULL)
+		return (NULL);
+	/* One more slot for threads that are not EAL lcores. */
+	ifp->if_pcpu = rte_zmalloc_socket("if_pcpu",
+	    (RTE_MAX_LCORE + 1) * sizeof(struct if_pcpu), RTE_CACHE_LINE_SIZE,
+	    socket);
+	if (ifp->if_pcpu == NULL) {
+		rte_free(ifp);
+		return (NULL);
+	}
+	return (ifp);
+}
+
+void
+if_free(struct ifnet *ifp)
+{
+
+	rte_free(ifp->if_pcpu);
+	rte_free(ifp);
+}
+
+uint64_t
+if_get_counter(const struct ifnet *ifp, ift_counter cnt)
+{
+	uint64_t val;
+	u_int i;
+
+	val = 0;
+	for (i = 0; i <= RTE_MAX_LCORE; i++)
+		val += ifp->if_pcpu[i].ifc_counters[cnt];
+	return (val);
+}
+
+/*
+ * Map the offloads of a port to interface capabilities.
+ */
+static int
+if_devcaps(const struct rte_eth_dev_info *dev_info)
+{
+	int caps;
+
+	caps = IFCAP_VLAN_MTU;
+	if ((dev_info->rx_offload_capa & DEV_RX_OFFLOAD_VLAN_STRIP) &&
+	    (dev_info->tx_offload_capa & DEV_TX_OFFLOAD_VLAN_INSERT))
+		caps |= IFCAP_VLAN_HWTAGGING;
+	if ((dev_info->rx_offload_capa & (DEV_RX_OFFLOAD_IPV4_CKSUM |
+	    DEV_RX_OFFLOAD_UDP_CKSUM | DEV_RX_OFFLOAD_TCP_CKSUM)) ==
+	    (DEV_RX_OFFLOAD_IPV4_CKSUM | DEV_RX_OFFLOAD_UDP_CKSUM |
+	    DEV_RX_OFFLOAD_TCP_CKSUM))
+		caps |= IFCAP_RXCSUM | IFCAP_RXCSUM_IPV6;
+	if ((dev_info->tx_offload_capa & (DEV_TX_OFFLOAD_IPV4_CKSUM |
+	    DEV_TX_OFFLOAD_UDP_CKSUM | DEV_TX_OFFLOAD_TCP_CKSUM)) ==
+	    (DEV_TX_OFFLOAD_IPV4_CKSUM | DEV_TX_OFFLOAD_UDP_CKSUM |
+	    DEV_TX_OFFLOAD_TCP_CKSUM))
+		caps |= IFCAP_TXCSUM | IFCAP_TXCSUM_IPV6;
+	if (dev_info->tx_offload_capa & DEV_TX_OFFLOAD_TCP_TSO)
+		caps |= IFCAP_TSO4 | IFCAP_TSO6;
+	if (dev_info->rx_offload_capa & DEV_RX_OFFLOAD_TCP_LRO)
+		caps |= IFCAP_LRO;
+	if (dev_info->max_rx_pktlen > ETHER_MAX_LEN)
+		caps |= IFCAP_JUMBO_MTU;
+	return (caps);
+}
+
+static void
+if_txdrop(struct rte_mbuf **m, uint16_t n, void *arg)
+{
+	uint16_t i;
+
+	if_inc_counter(arg, IFCOUNTER_OQDROPS, n);
+	for (i = 0; i < n; i++)
+		rte_pktmbuf_free(m[i]);
+}
+
+static int
+if_txbuf_alloc(struct ifnet *ifp)
+{
+	struct rte_eth_dev_tx_buffer *txb;
+	unsigned lcore;
+
+	RTE_LCORE_FOREACH(lcore) {
+		txb = rte_zmalloc_socket("if_txbuf",
+		    RTE_ETH_TX_BUFFER_SIZE(IF_TXBURST), RTE_CACHE_LINE_SIZE,
+		    rte_lcore_to_socket_id(lcore));
+		if (txb == NULL)
+			return (ENOMEM);
+		rte_eth_tx_buffer_init(txb, IF_TXBURST);
+		rte_eth_tx_buffer_set_err_callback(txb, if_txdrop, ifp);
+		if_txbuf[ifp->if_port][lcore] = txb;
+	}
+	return (0);
+}
+
+static void
+if_txbuf_free(struct ifnet *ifp)
+{
+	unsigned lcore;
+
+	for (lcore = 0; lcore < RTE_MAX_LCORE; lcore++) {
+		rte_free(if_txbuf[ifp->if_port][lcore]);
+		if_txbuf[ifp->if_port][lcore] = NULL;
+	}
+}
+
+void
+if_transmit(struct ifnet *ifp, struct rte_mbuf *m)
+{
+	unsigned lcore;
+
+	KASSERT(ifp->if_parent == NULL, ("%s: %s is not a port", __func__,
+	    if_name(ifp)));
+
+	lcore = rte_lcore_id();
+	rte_eth_tx_buffer(ifp->if_port, rte_lcore_index(lcore),
+	    if_txbuf[ifp->if_port][lcore], m);
+}
+
+void
+if_flush(void)
+{
+	struct rte_eth_dev_tx_buffer *txb;
+	unsigned lcore, port;
+	uint16_t queue;
+
+	lcore = rte_lcore_id();
+	queue = rte_lcore_index(lcore);
+	for (port = 0; port < RTE_MAX_ETHPORTS; port++) {
+		txb = if_txbuf[port][lcore];
+		if (txb != NULL && txb->length != 0)
+			rte_eth_tx_buffer_flush(port, queue, txb);
+	}
+}
+
+/*
+ * Attach the ifnet of a DPDK port; called once the port is configured.
+ * Its name is that of the port's KNI interface, which is how the netlink
+ * monitor finds it.
+ */
+struct ifnet *
+if_attach(uint8_t port)
+{
+	struct rte_eth_dev_info dev_info;
+	struct ifnet *ifp;
+	uint16_t mtu;
+
+	KASSERT(ifnet_byport[port] == NULL,
+	    ("%s: port %u already attached", __func__, port));
+
+	ifp = if_alloc(rte_eth_dev_socket_id(port));
+	if (ifp == NULL) {
+		RTE_LOG(ERR, NET, "%s: cannot allocate ifnet for port %u\n",
+		    __func__, port);
+		return (NULL);
+	}
+	ifp->if_port = port;
+	snprintf(ifp->if_xname, sizeof(ifp->if_xname), "vEth%u", port);
+	rte_eth_macaddr_get(port, &ifp->if_addr);
+	if (rte_eth_dev_get_mtu(port, &mtu) == 0)
+		ifp->if_mtu = mtu;
+	else
+		ifp->if_mtu = ETHER_MTU;
+
+	memset(&dev_info, 0, sizeof(dev_info));
+	rte_eth_dev_info_get(port, &dev_info);
+	ifp->if_capabilities = if_devcaps(&dev_info);
+	/* Only VLAN tagging is turned on by init_port(). */
+	ifp->if_capenable = ifp->if_capabilities &
+	    (IFCAP_VLAN_MTU | IFCAP_VLAN_HWTAGGING);
+	ifp->if_flags = IFF_UP | IFF_BROADCAST | IFF_SIMPLEX | IFF_MULTICAST;
+	if (rte_eth_promiscuous_get(port) == 1)
+		ifp->if_flags |= IFF_PROMISC;
+	if_addmulti(ifp, &if_allhosts);
+	if_addmulti(ifp, &if_allnodes);
+
+	if (if_txbuf_alloc(ifp) != 0) {
+		RTE_LOG(ERR, NET, "%s: cannot allocate TX buffers for port %u\n",
+		    __func__, port);
+		if_txbuf_free(ifp);
+		if_free(ifp);
+		return (NULL);
+	}
+
+	ifnet_byport[port] = ifp;
+	return (ifp);
+}
+
+void
+if_detach(struct ifnet *ifp)
+{
+
+	KASSERT(ifp->if_parent == NULL, ("%s: %s is not a port", __func__,
+	    if_name(ifp)));
+
+	ifnet_byport[ifp->if_port] = NULL;
+	if_txbuf_free(ifp);
+	vlan_ifdetach(ifp);
+	if_free(ifp);
+}
+
+/*
+ * Call f on every ifnet, ports first then their VLANs, until it returns
+ * non-zero; returns that ifnet, or NULL.
+ */
+struct ifnet *
+if_walk(int (*f)(struct ifnet *, const void *), const void *arg)
+{
+	struct ifnet *ifp, *vifp;
+	u_int port, vid;
+
+	for (port = 0; port < RTE_MAX_ETHPORTS; port++) {
+		ifp = ifnet_byport[port];
+		if (ifp == NULL)
+			continue;
+		if (f(ifp, arg))
+			return (ifp);
+		if (ifp->if_vlans == NULL)
+			continue;
+		for (vid = 0; vid <= EVL_VLID_MASK; vid++) {
+			vifp = ifp->if_vlans[vid];
+			if (vifp != NULL && f(vifp, arg))
+				return (vifp);
+		}
+	}
+	return (NULL);
+}
+
+static int
+if_match_name(struct ifnet *ifp, const void *name)
+{
+
+	return (strcmp(if_name(ifp), name) == 0);
+}
+
+static int
+if_match_index(struct ifnet *ifp, const void *idx)
+{
+
+	return (ifp->if_index == *(const int *)idx);
+}
+
+/*
+ * Look up an ifnet by name.
+ */
+struct ifnet *
+ifunit(const char *name)
+{
+
+	return (if_walk(if_match_name, name));
+}
+
+/*
+ * Look up an ifnet by kernel interface index.
+ */
+struct ifnet *
+ifnet_byindex(int idx)
+{
+
+	if (idx <= 0)
+		return (NULL);
+	return (if_walk(if_match_index, &idx));
+}
+
+int
+if_addmulti(struct ifnet *ifp, const struct ether_addr *ea)
+{
+	u_int h;
+
+	if (!is_multicast_ether_addr(ea))
+		return (EINVAL);
+	if (ifp->if_parent != NULL)
+		ifp = ifnet_byport[ifp->if_port];
+	h = if_mchash(ea);
+	if (ifp->if_mcrefs[h] == UINT16_MAX)
+		return (ENOSPC);
+	if (ifp->if_mcrefs[h]++ == 0)
+		ifp->if_mcfilter |= UINT64_C(1) << h;
+	return (0);
+}
+
+int
+if_delmulti(struct ifnet *ifp, const struct ether_addr *ea)
+{
+	u_int h;
+
+	if (ifp->if_parent != NULL)
+		ifp = ifnet_byport[ifp->if_port];
+	h = if_mchash(ea);
+	if (ifp->if_mcrefs[h] == 0)
+		return (ENOENT);
+	if (--ifp->if_mcrefs[h] == 0)
+		ifp->if_mcfilter &= ~(UINT64_C(1) << h);
+	return (0);
+}
+
+/*
+ * Solicited-node multicast group of an IPv6 address, joined for as long
+ * as the address is configured.
+ */
+static void
+if_solnode(const struct in6_addr *in6, struct ether_addr *ea)
+{
+
+	ea->addr_bytes[0] = 0x33;
+	ea->addr_bytes[1] = 0x33;
+	ea->addr_bytes[2] = 0xff;
+	memcpy(&ea->addr_bytes[3], &in6->s6_addr[13], 3);
+}
+
+int
+if_addaddr(struct ifnet *ifp, int af, const void *addr, int plen)
+{
+	struct ether_addr ea;
+	u_int i;
+
+	switch (af) {
+	case AF_INET:
+		for (i = 0; i < ifp->if_naddrs; i++)
+			if (memcmp(&ifp->if_inaddrs[i].ia_addr, addr,
+			    sizeof(struct in_addr)) == 0) {
+				ifp->if_inaddrs[i].ia_plen = plen;
+				return (EEXIST);
+			}
+		if (ifp->if_naddrs == IF_MAXADDRS)
+			return (ENOSPC);
+		memcpy(&ifp->if_inaddrs[i].ia_addr, addr,
+		    sizeof(struct in_addr));
+		ifp->if_inaddrs[i].ia_plen = plen;
+		ifp->if_naddrs++;
+		return (0);
+	case AF_INET6:
+		for (i = 0; i < ifp->if_naddrs6; i++)
+			if (memcmp(&ifp->if_in6addrs[i].ia6_addr, addr,
+			    sizeof(struct in6_addr)) == 0) {
+				ifp->if_in6addrs[i].ia6_plen = plen;
+				return (EEXIST);
+			}
+		if (ifp->if_naddrs6 == IF_MAXADDRS)
+			return (ENOSPC);
+		memcpy(&ifp->if_in6addrs[i].ia6_addr, addr,
+		    sizeof(struct in6_addr));
+		ifp->if_in6addrs[i].ia6_plen = plen;
+		ifp->if_naddrs6++;
+		if_solnode(addr, &ea);
+		if_addmulti(ifp, &ea);
+		return (0);
+	default:
+		return (EAFNOSUPPORT);
+	}
+}
+
+int
+if_deladdr(struct ifnet *ifp, int af, const void *addr)
+{
+	struct ether_addr ea;
+	u_int i;
+
+	switch (af) {
+	case AF_INET:
+		for (i = 0; i < ifp->if_naddrs; i++)
+			if (memcmp(&ifp->if_inaddrs[i].ia_addr, addr,
+			    sizeof(struct in_addr)) == 0) {
+				ifp->if_inaddrs[i] =
+				    ifp->if_inaddrs[--ifp->if_naddrs];
+				return (0);
+			}
+		return (ENOENT);
+	case AF_INET6:
+		for (i = 0; i < ifp->if_naddrs6; i++)
+			if (memcmp(&ifp->if_in6addrs[i].ia6_addr, addr,
+			    sizeof(struct in6_addr)) == 0) {
+				ifp->if_in6addrs[i] =
+				    ifp->if_in6addrs[--ifp->if_naddrs6];
+				if_solnode(addr, &ea);
+				if_delmulti(ifp, &ea);
+				return (0);
+			}
+		return (ENOENT);
+	default:
+		return (EAFNOSUPPORT);
+	}
+}
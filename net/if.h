@@ -35,6 +35,12 @@
 
 #include <sys/cdefs.h>
 
+/*
+ * Length of interface external name, including terminating '\0'.
+ * Note: this is the same size as a generic device's external name.
+ */
+#define		IF_NAMESIZE	16
+#define		IFNAMSIZ	IF_NAMESIZE
 
 /*-
  * Interface flags are of two types: network stack owned flags, and driver
@@ -168,6 +174,27 @@
 
 #define	IFCAP_CANTCHANGE	(IFCAP_NETMAP)
 
+/*
+ * Interface counters, see if_inc_counter().
+ */
+typedef enum {
+	IFCOUNTER_IPACKETS = 0,
+	IFCOUNTER_IERRORS,
+	IFCOUNTER_OPACKETS,
+	IFCOUNTER_OERRORS,
+	IFCOUNTER_COLLISIONS,
+	IFCOUNTER_IBYTES,
+	IFCOUNTER_OBYTES,
+	IFCOUNTER_IMCASTS,
+	IFCOUNTER_OMCASTS,
+	IFCOUNTER_IQDROPS,
+	IFCOUNTER_OQDROPS,
+	IFCOUNTER_NOPROTO,
+	IFCOUNTER_IUCFILTERED,	/* promiscuous: unicast to another host */
+	IFCOUNTER_IMCFILTERED,	/* promiscuous: multicast not joined */
+	IFCOUNTERS /* Array size. */
+} ift_counter;
+
 #define	IFQ_MAXLEN	50
 #define	IFNET_SLOWHZ	1		/* granularity is 1 second */
 
@@ -33,6 +33,11 @@
 #ifndef _NET_IF_ARP_H_
 #define	_NET_IF_ARP_H_
 
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "pcpustat.h"
+
 /*
  * Address Resolution Protocol.
  *
@@ -105,21 +110,36 @@ struct arpstat {
 	uint64_t dupips;	/* # of duplicate IPs detected. */
 };
 
-#ifdef _KERNEL
-#include <sys/counter.h>
-#include <net/vnet.h>
+/*
+ * ARP on the dataplane, see net/if_ether.c.
+ */
+struct ifnet;
+struct rte_mbuf;
+
+int	arp_init(void);
+u_int	arp_poll(u_int budget);
+int	arpresolve(struct ifnet *ifp, struct rte_mbuf *m, struct in_addr dst);
 
-VNET_PCPUSTAT_DECLARE(struct arpstat, arpstat);
 /*
- * In-kernel consumers can use these accessor macros directly to update
- * stats.
+ * Gratuitous ARP and unsolicited NA trains, see net/if_garp.c.
  */
-#define	ARPSTAT_ADD(name, val)	\
-    VNET_PCPUSTAT_ADD(struct arpstat, arpstat, name, (val))
+#define	GARP_COUNT	3	/* default announcements per address */
+#define	GARP_INTERVAL	20	/* default ms between them */
+
+int	garp_init(void);
+int	garp_announce(struct ifnet *ifp, int af, const void *addrs,
+	    u_int naddrs, u_int count, u_int interval_ms);
+u_int	garp_poll(void);
+
+/*
+ * Statistics are per-lcore, see net/pcpustat.h.
+ */
+PCPUSTAT_DECLARE(struct arpstat, arpstat);
+
+#define	ARPSTAT_ADD(name, val)	PCPUSTAT_ADD(arpstat, name, (val))
 #define	ARPSTAT_SUB(name, val)	ARPSTAT_ADD(name, -(val))
 #define	ARPSTAT_INC(name)	ARPSTAT_ADD(name, 1)
 #define	ARPSTAT_DEC(name)	ARPSTAT_SUB(name, 1)
-
-#endif /* _KERNEL */
+#define	ARPSTAT_FETCH(dst)	PCPUSTAT_FETCH(struct arpstat, arpstat, (dst))
 
 #endif /* !_NET_IF_ARP_H_ */
@@ -29,22 +29,76 @@
  *	@(#)if_ether.c	8.1 (Berkeley) 6/10/93
  */
 
+#include <errno.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+
 #include <rte_mbuf.h>
 #include <rte_byteorder.h>
+#include <rte_cycles.h>
 #include <rte_ether.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+#include <rte_ring.h>
 
 #include "if_arp.h"
+#include "if_var.h"
+#include "if_llatbl.h"
+#include "ethernet.h"
 #include "netisr.h"
+#include "netinet/ip_var.h"
 
 #define RTE_LOGTYPE_ETHER RTE_LOGTYPE_USER1
 
+#define	ARP_LEARNQ_LEN	1024	/* ARP packets awaiting the control lcore */
+#define	ARP_MISSQ_LEN	1024	/* packets to unknown next hops, likewise */
+#define	ARP_POLL_BURST	32
+#define	ARP_NB_MBUF	1023	/* for the ARP packets we originate */
+#define	ARP_MAXQUERIES	1024	/* next hops being resolved at once */
+#define	ARP_MAXTRIES	5	/* requests before giving up on one */
+#define	ARP_MAXAGE	1200	/* seconds an entry goes unconfirmed */
+
+PCPUSTAT_DEFINE(struct arpstat, arpstat);
+
+/*
+ * ARP packets the neighbour table should learn from, and packets to next
+ * hops it does not know, passed from the dataplane lcores to the control
+ * lcore, the table's only writer.
+ */
+static struct rte_ring	*arp_learnq;
+static struct rte_ring	*arp_missq;
+static struct rte_mempool	*arp_pool;
+
+/*
+ * Next hops being resolved, control lcore only.  Each has an incomplete
+ * entry holding the packets sent to it meanwhile; requests go out once a
+ * second until it resolves or ARP_MAXTRIES requests went unanswered.
+ */
+struct arp_query {
+	TAILQ_ENTRY(arp_query) aq_link;
+	struct in_addr	aq_addr;
+	struct ifnet	*aq_ifp;
+	u_int		aq_asked;	/* requests sent */
+	uint64_t	aq_next;	/* TSC of the next request */
+};
+
+static TAILQ_HEAD(, arp_query)	arp_queries =
+    TAILQ_HEAD_INITIALIZER(arp_queries);
+static u_int	arp_nqueries;
+
+static const struct ether_addr	arp_bcast = {
+	.addr_bytes = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }
+};
 
+static void	in_arpinput(struct ifnet *, struct rte_mbuf *);
 
 /*
  * Common length and type checks are done here,
  * then the protocol-specific routine is called.
  */
-static void
+void
 arpintr(struct rte_mbuf *m)
 {
 	struct arphdr *ar;
@@ -52,7 +106,11 @@ arpintr(struct rte_mbuf *m)
 	char *layer;
 	int hlen;
 
-
+	ifp = m_rcvif(m);
+	if (ifp == NULL) {
+		rte_pktmbuf_free(m);
+		return;
+	}
 	ar = rte_pktmbuf_mtod(m, struct arphdr *);
 
 	hlen = 0;
@@ -90,7 +148,7 @@ arpintr(struct rte_mbuf *m)
 		RTE_LOG(NOTICE, ETHER,
 		    "packet with unknown hardware format 0x%02d received on "
 		    "%s\n", ntohs(ar->ar_hrd), if_name(ifp));
-		m_freem(m);
+		rte_pktmbuf_free(m);
 		return;
 	}
 
@@ -98,16 +156,434 @@ arpintr(struct rte_mbuf *m)
 		RTE_LOG(NOTICE, ETHER,
 		    "packet with invalid %s address length %d received on %s\n",
 		    layer, ar->ar_hln, if_name(ifp));
-		m_freem(m);
+		rte_pktmbuf_free(m);
 		return;
 	}
 
 	switch (ntohs(ar->ar_pro)) {
 	case ETHER_TYPE_IPv4:
-		in_arpinput(m);
+		in_arpinput(ifp, m);
 		return;
 	}
-	m_freem(m);
+	rte_pktmbuf_free(m);
+}
+
+/*
+ * Whether addr is one of ifp's addresses.
+ */
+static int
+arp_ifaddr(const struct ifnet *ifp, struct in_addr addr)
+{
+	u_int i;
+
+	for (i = 0; i < ifp->if_naddrs; i++)
+		if (ifp->if_inaddrs[i].ia_addr.s_addr == addr.s_addr)
+			return (1);
+	return (0);
+}
+
+/*
+ * Whether we answer for addr on ifp: it is one of ifp's addresses, or a
+ * local or virtual service address of the box.
+ */
+static int
+arp_owned(const struct ifnet *ifp, struct in_addr addr)
+{
+
+	return (arp_ifaddr(ifp, addr) || in_addrtype(addr) != IN_ADDR_NONE);
+}
+
+/*
+ * Whether the neighbour table should learn that isaddr is at sha on ifp:
+ * an entry it has says otherwise or wants confirming, or it has none and
+ * may create one.
+ */
+static int
+arp_stale(const struct ifnet *ifp, struct in_addr isaddr,
+    const struct ether_addr *sha, int create)
+{
+	struct llentry *lle;
+
+	if (isaddr.s_addr == INADDR_ANY)
+		return (0);
+	lle = lla_lookup(AF_INET, &isaddr);
+	if (lle == NULL)
+		return (create && !arp_ifaddr(ifp, isaddr));
+	return ((lle->la_flags & LLE_STATIC) == 0 &&
+	    (lle->lle_ifp != ifp || !is_same_ether_addr(&lle->ll_addr, sha) ||
+	    lla_expired(lle)));
+}
+
+/*
+ * Pass a copy of ARP packet m to the control lcore to learn from, creating
+ * an entry if need be when create is set; m itself becomes the reply, or
+ * goes to the host.
+ */
+static void
+arp_learncopy(const struct rte_mbuf *m, int create)
+{
+	struct rte_mbuf *n;
+	size_t len;
+
+	n = rte_pktmbuf_alloc(arp_pool);
+	if (n == NULL)
+		return;
+	len = arphdr_len2(ETHER_ADDR_LEN, sizeof(struct in_addr));
+	rte_memcpy(rte_pktmbuf_append(n, len), rte_pktmbuf_mtod(m, void *),
+	    len);
+	/* What if_rcvif() goes by. */
+	n->port = m->port;
+	n->ol_flags = m->ol_flags & (PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT);
+	n->vlan_tci = m->vlan_tci;
+	n->vlan_tci_outer = m->vlan_tci_outer;
+	n->hash.usr = create;
+	if (rte_ring_mp_enqueue(arp_learnq, n) != 0)
+		rte_pktmbuf_free(n);
+}
+
+/*
+ * Rewrite request m for our address into the reply, in place, and send
+ * it back through this lcore's TX queue.
+ */
+static void
+arpreply(struct ifnet *ifp, struct rte_mbuf *m, struct arphdr *ah)
+{
+	struct ether_l2tmpl t;
+	struct in_addr itaddr;
+
+	memcpy(&itaddr, ar_tpa(ah), sizeof(itaddr));
+	ah->ar_op = htons(ARPOP_REPLY);
+	memcpy(ar_tha(ah), ar_sha(ah), ETHER_ADDR_LEN);
+	memcpy(ar_tpa(ah), ar_spa(ah), sizeof(struct in_addr));
+	memcpy(ar_sha(ah), &ifp->if_addr, ETHER_ADDR_LEN);
+	memcpy(ar_spa(ah), &itaddr, sizeof(itaddr));
+
+	/* The request's stripped tags and RX flags do not apply. */
+	m->ol_flags = 0;
+	ether_l2tmpl_set(&t, ifp, (struct ether_addr *)ar_tha(ah),
+	    ETHER_TYPE_ARP);
+	if (ether_output(ifp, m, &t) == 0)
+		ARPSTAT_INC(txreplies);
+}
+
+/*
+ * ARP for Internet protocols on Ethernet.  Runs on the receiving lcore.
+ * A request for an address we own is answered right here.  As in RFC 826,
+ * any request or reply, gratuitous ARP included, refreshes the entry of
+ * its sender if the neighbour table has one, and one to an address we own
+ * creates the entry; unless the table already says so, a copy goes to
+ * the control lcore, which updates the table from arp_poll().  Everything
+ * but the requests answered goes on to the host, whose own neighbour cache
+ * needs the replies to the requests it sends.
+ */
+static void
+in_arpinput(struct ifnet *ifp, struct rte_mbuf *m)
+{
+	struct arphdr *ah;
+	struct ether_addr *sha;
+	struct in_addr isaddr, itaddr;
+	uint16_t op;
+	int owned;
+
+	if (m->data_len < arphdr_len2(ETHER_ADDR_LEN, sizeof(struct in_addr)))
+		goto drop;
+	ah = rte_pktmbuf_mtod(m, struct arphdr *);
+	if (ah->ar_pln != sizeof(struct in_addr)) {
+		RTE_LOG(NOTICE, ETHER, "requested protocol length != %zu\n",
+		    sizeof(struct in_addr));
+		goto drop;
+	}
+	sha = (struct ether_addr *)ar_sha(ah);
+	if (is_multicast_ether_addr(sha)) {
+		RTE_LOG(NOTICE, ETHER, "link address is multicast on %s\n",
+		    if_name(ifp));
+		goto drop;
+	}
+	ARPSTAT_INC(received);
+	op = ntohs(ah->ar_op);
+	if (op == ARPOP_REQUEST)
+		ARPSTAT_INC(rxrequests);
+	else if (op == ARPOP_REPLY)
+		ARPSTAT_INC(rxreplies);
+	else
+		goto host;
+	memcpy(&isaddr, ar_spa(ah), sizeof(isaddr));
+	memcpy(&itaddr, ar_tpa(ah), sizeof(itaddr));
+	owned = arp_owned(ifp, itaddr);
+	if (arp_stale(ifp, isaddr, sha, owned))
+		arp_learncopy(m, owned);
+	if (!owned)
+		goto host;
+	/* Nothing to answer to a reply or a gratuitous ARP. */
+	if (op == ARPOP_REPLY || isaddr.s_addr == itaddr.s_addr)
+		goto host;
+	arpreply(ifp, m, ah);
+	return;
+
+host:
+	ether_host_input(m);
+	return;
+
+drop:
+	rte_pktmbuf_free(m);
+}
+
+/*
+ * Send m to next hop dst on ifp, resolving dst first if need be.  Packets
+ * to a next hop being resolved are held, a bounded number of them; the
+ * first packet to an unknown one goes to the control lcore, which starts
+ * resolving it.  Consumes m.
+ */
+int
+arpresolve(struct ifnet *ifp, struct rte_mbuf *m, struct in_addr dst)
+{
+	struct llentry *lle;
+
+	lle = lla_lookup(AF_INET, &dst);
+	if (likely(lle != NULL && (lle->la_flags & LLE_VALID)))
+		return (ether_output(lle->lle_ifp, m, &lle->lle_l2tmpl));
+	if (lle != NULL) {
+		if (lla_hold(lle, m) != 0) {
+			ARPSTAT_INC(dropped);
+			return (ENOBUFS);
+		}
+		return (0);
+	}
+
+	m->hash.usr = dst.s_addr;
+	m->udata64 = (uintptr_t)ifp;
+	if (rte_ring_mp_enqueue(arp_missq, m) != 0) {
+		ARPSTAT_INC(dropped);
+		rte_pktmbuf_free(m);
+		return (ENOBUFS);
+	}
+	return (0);
+}
+
+/*
+ * Our address on ifp to ask for dst from: one on dst's subnet if there is
+ * one, the first otherwise.
+ */
+static int
+arp_srcaddr(const struct ifnet *ifp, struct in_addr dst, struct in_addr *src)
+{
+	uint32_t mask;
+	u_int i;
+
+	if (ifp->if_naddrs == 0)
+		return (EADDRNOTAVAIL);
+	*src = ifp->if_inaddrs[0].ia_addr;
+	for (i = 0; i < ifp->if_naddrs; i++) {
+		mask = ifp->if_inaddrs[i].ia_plen == 0 ? 0 :
+		    htonl(~0U << (32 - ifp->if_inaddrs[i].ia_plen));
+		if (((ifp->if_inaddrs[i].ia_addr.s_addr ^ dst.s_addr) &
+		    mask) == 0) {
+			*src = ifp->if_inaddrs[i].ia_addr;
+			break;
+		}
+	}
+	return (0);
+}
+
+/*
+ * Broadcast a request for tip on ifp.
+ */
+static void
+arprequest(struct ifnet *ifp, struct in_addr tip)
+{
+	struct ether_l2tmpl t;
+	struct rte_mbuf *m;
+	struct arphdr *ah;
+	struct in_addr sip;
+
+	if (arp_srcaddr(ifp, tip, &sip) != 0)
+		return;
+	m = rte_pktmbuf_alloc(arp_pool);
+	if (m == NULL)
+		return;
+	ah = (struct arphdr *)rte_pktmbuf_append(m,
+	    arphdr_len2(ETHER_ADDR_LEN, sizeof(struct in_addr)));
+	ah->ar_hrd = htons(ARPHRD_ETHER);
+	ah->ar_pro = htons(ETHER_TYPE_IPv4);
+	ah->ar_hln = ETHER_ADDR_LEN;
+	ah->ar_pln = sizeof(struct in_addr);
+	ah->ar_op = htons(ARPOP_REQUEST);
+	memcpy(ar_sha(ah), &ifp->if_addr, ETHER_ADDR_LEN);
+	memcpy(ar_spa(ah), &sip, sizeof(sip));
+	memset(ar_tha(ah), 0, ETHER_ADDR_LEN);
+	memcpy(ar_tpa(ah), &tip, sizeof(tip));
+
+	ether_l2tmpl_set(&t, ifp, &arp_bcast, ETHER_TYPE_ARP);
+	if (ether_output(ifp, m, &t) == 0)
+		ARPSTAT_INC(txrequests);
+}
+
+/*
+ * Start resolving dst on ifp.
+ */
+static int
+arp_query(struct ifnet *ifp, struct in_addr dst)
+{
+	struct arp_query *aq;
+	int error;
+
+	if (arp_nqueries == ARP_MAXQUERIES)
+		return (ENOBUFS);
+	aq = rte_zmalloc("arp_query", sizeof(*aq), 0);
+	if (aq == NULL)
+		return (ENOMEM);
+	error = lla_create(AF_INET, ifp, &dst);
+	if (error != 0) {
+		rte_free(aq);
+		return (error);
+	}
+	aq->aq_addr = dst;
+	aq->aq_ifp = ifp;
+	aq->aq_asked = 1;
+	aq->aq_next = rte_get_timer_cycles() + rte_get_timer_hz();
+	TAILQ_INSERT_TAIL(&arp_queries, aq, aq_link);
+	arp_nqueries++;
+	arprequest(ifp, dst);
+	return (0);
+}
+
+/*
+ * Retransmit requests that are due, and retire queries that resolved or
+ * timed out.
+ */
+static void
+arp_timer(void)
+{
+	struct arp_query *aq, *next;
+	struct llentry *lle;
+	uint64_t now;
+
+	now = rte_get_timer_cycles();
+	for (aq = TAILQ_FIRST(&arp_queries); aq != NULL; aq = next) {
+		next = TAILQ_NEXT(aq, aq_link);
+		lle = lla_lookup(AF_INET, &aq->aq_addr);
+		if (lle == NULL || (lle->la_flags & LLE_VALID))
+			goto done;
+		if (now < aq->aq_next)
+			continue;
+		if (aq->aq_asked == ARP_MAXTRIES) {
+			ARPSTAT_INC(timeouts);
+			lla_delete(AF_INET, &aq->aq_addr);
+			goto done;
+		}
+		arprequest(aq->aq_ifp, aq->aq_addr);
+		aq->aq_asked++;
+		aq->aq_next = now + rte_get_timer_hz();
+		continue;
+done:
+		TAILQ_REMOVE(&arp_queries, aq, aq_link);
+		arp_nqueries--;
+		rte_free(aq);
+	}
+}
+
+/*
+ * Ask again for an entry nothing confirmed for ARP_MAXAGE, see lla_timer().
+ */
+static void
+arp_probe(const struct llentry *lle)
+{
+
+	arprequest(lle->lle_ifp, lle->r_l3addr.addr4);
+}
+
+/*
+ * Packets held on an entry that was replaced or deleted: send them with
+ * the entry now in the table, if it resolved.
+ */
+static void
+arp_held(const struct llentry *old, struct rte_mbuf **m, u_int n)
+{
+	struct llentry *lle;
+	u_int i;
+
+	lle = lla_lookup(AF_INET, &old->r_l3addr.addr4);
+	if (lle == NULL || !(lle->la_flags & LLE_VALID)) {
+		ARPSTAT_ADD(dropped, n);
+		for (i = 0; i < n; i++)
+			rte_pktmbuf_free(m[i]);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		ether_output(lle->lle_ifp, m[i], &lle->lle_l2tmpl);
+}
+
+/*
+ * A packet arpresolve() found no entry for.
+ */
+static void
+arp_miss(struct rte_mbuf *m)
+{
+	struct llentry *lle;
+	struct ifnet *ifp;
+	struct in_addr dst;
+
+	ifp = (struct ifnet *)(uintptr_t)m->udata64;
+	dst.s_addr = m->hash.usr;
+	lle = lla_lookup(AF_INET, &dst);
+	if (lle == NULL && arp_query(ifp, dst) == 0)
+		lle = lla_lookup(AF_INET, &dst);
+	if (lle == NULL) {
+		ARPSTAT_INC(dropped);
+		rte_pktmbuf_free(m);
+	} else if (lle->la_flags & LLE_VALID)
+		ether_output(lle->lle_ifp, m, &lle->lle_l2tmpl);
+	else if (lla_hold(lle, m) != 0)
+		ARPSTAT_INC(dropped);
+}
+
+/*
+ * Apply what in_arpinput() passed on, start resolving what arpresolve()
+ * could not, at most budget packets of each, and run the request timer;
+ * returns the number of packets processed.  Control lcore only.
+ */
+u_int
+arp_poll(u_int budget)
+{
+	struct rte_mbuf *m[ARP_POLL_BURST];
+	struct arphdr *ah;
+	struct ifnet *ifp;
+	struct in_addr isaddr;
+	u_int i, n, done, total;
+
+	for (done = 0; done < budget; done += n) {
+		n = rte_ring_sc_dequeue_burst(arp_learnq, (void **)m,
+		    RTE_MIN(budget - done, ARP_POLL_BURST));
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			/* The interface may have gone meanwhile. */
+			ifp = if_rcvif(m[i]);
+			ah = rte_pktmbuf_mtod(m[i], struct arphdr *);
+			memcpy(&isaddr, ar_spa(ah), sizeof(isaddr));
+			/* Nor may the entry to refresh still be there. */
+			if (ifp != NULL && (m[i]->hash.usr ||
+			    lla_lookup(AF_INET, &isaddr) != NULL))
+				lla_update(AF_INET, ifp, &isaddr,
+				    (struct ether_addr *)ar_sha(ah), 0);
+			rte_pktmbuf_free(m[i]);
+		}
+	}
+	total = done;
+
+	for (done = 0; done < budget; done += n) {
+		n = rte_ring_sc_dequeue_burst(arp_missq, (void **)m,
+		    RTE_MIN(budget - done, ARP_POLL_BURST));
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++)
+			arp_miss(m[i]);
+	}
+	total += done;
+
+	arp_timer();
+	lla_timer(AF_INET);
+	return (total);
 }
 
 static const struct netisr_handler arp_nh = {
@@ -117,8 +593,20 @@ static const struct netisr_handler arp_nh = {
 	.nh_policy = NETISR_POLICY_SOURCE,
 };
 
-vnet_arp_init(void)
+int
+arp_init(void)
 {
 
+	arp_learnq = rte_ring_create("arp_learnq", ARP_LEARNQ_LEN,
+	    rte_socket_id(), RING_F_SC_DEQ);
+	arp_missq = rte_ring_create("arp_missq", ARP_MISSQ_LEN,
+	    rte_socket_id(), RING_F_SC_DEQ);
+	arp_pool = rte_pktmbuf_pool_create("arp_pool", ARP_NB_MBUF,
+	    ARP_POLL_BURST, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (arp_learnq == NULL || arp_missq == NULL || arp_pool == NULL)
+		return (ENOMEM);
+	lltable_register_held(AF_INET, arp_held);
+	lltable_register_probe(AF_INET, ARP_MAXAGE, ARP_MAXTRIES, arp_probe);
 	netisr_register(&arp_nh);
+	return (0);
 }
@@ -31,81 +31,619 @@
  * $FreeBSD$
  */
 
+#include <errno.h>
+#include <string.h>
+
+#include <rte_atomic.h>
 #include <rte_mbuf.h>
+#include <rte_memcpy.h>
+#include <rte_prefetch.h>
 #include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ethdev.h>
+#include <rte_cpuflags.h>
+#ifdef RTE_ARCH_X86
+#include <immintrin.h>
+#endif
 
 #include "if.h"
 #include "if_var.h"
+#include "if_vlan_var.h"
+#include "ethernet.h"
 #include "netisr.h"
 
 #define RTE_LOGTYPE_NET RTE_LOGTYPE_USER1
 
+/*
+ * Burst classification by ethertype.  The ethertypes of a burst are gathered
+ * into one array and compared against the types we handle 8 (SSE2) or 16
+ * (AVX2) at a time, yielding a class per packet; the burst is then split into
+ * one sub-burst per class and each is handed to netisr in one go.  The
+ * vector width is picked at run time, see ether_init().
+ */
+#define	ETHER_CLASS_OTHER	0
+#define	ETHER_CLASS_IPV4	1
+#define	ETHER_CLASS_ARP		2
+#define	ETHER_CLASS_IPV6	3
+#define	ETHER_CLASS_VLAN	4
+#define	ETHER_NCLASS		5
+
+#define	ETHER_DEMUX_BURST	32
+
+typedef void	ether_classify_t(const uint16_t *types, uint8_t *cls, u_int n);
+
+/*
+ * Classify one ethertype, given in network byte order.
+ */
+static inline uint8_t
+ether_classify_one(uint16_t type)
+{
+
+	switch (rte_be_to_cpu_16(type)) {
+	case ETHER_TYPE_IPv4:
+		return (ETHER_CLASS_IPV4);
+	case ETHER_TYPE_ARP:
+		return (ETHER_CLASS_ARP);
+	case ETHER_TYPE_IPv6:
+		return (ETHER_CLASS_IPV6);
+	case ETHER_TYPE_VLAN:
+	case ETHER_TYPE_QINQ:
+		return (ETHER_CLASS_VLAN);
+	default:
+		return (ETHER_CLASS_OTHER);
+	}
+}
+
 static void
-ether_input(struct ifnet *ifp, struct rte_mbuf *m)
+ether_classify_scalar(const uint16_t *types, uint8_t *cls, u_int n)
 {
+	u_int i;
+
+	for (i = 0; i < n; i++)
+		cls[i] = ether_classify_one(types[i]);
+}
 
-	struct rte_mbuf *mn;
+#ifdef RTE_ARCH_X86
+/*
+ * Each comparison yields 0xffff in matching lanes; masking with the class
+ * number and or-ing the results leaves the class (or 0) in every lane.
+ */
+#define	ETHER_CLASSIFY_LANES(set1, cmpeq, and, or, t)			\
+	or(or(and(cmpeq(t, set1(rte_cpu_to_be_16(ETHER_TYPE_IPv4))),	\
+		set1(ETHER_CLASS_IPV4)),				\
+	    and(cmpeq(t, set1(rte_cpu_to_be_16(ETHER_TYPE_ARP))),	\
+		set1(ETHER_CLASS_ARP))),				\
+	    or(and(cmpeq(t, set1(rte_cpu_to_be_16(ETHER_TYPE_IPv6))),	\
+		set1(ETHER_CLASS_IPV6)),				\
+	    and(or(cmpeq(t, set1(rte_cpu_to_be_16(ETHER_TYPE_VLAN))),	\
+		cmpeq(t, set1(rte_cpu_to_be_16(ETHER_TYPE_QINQ)))),	\
+		set1(ETHER_CLASS_VLAN))))
 
-	/*
-	 * The drivers are allowed to pass in a chain of packets linked with
-	 * next. We split them up into separate packets here and pass
-	 * them up. This allows the drivers to amortize the receive lock.
-	 */
-	while (m) {
-		mn = m->next;
-		m->next = NULL;
+static inline __m128i
+ether_set1_sse(uint16_t v)
+{
 
-		netisr_dispatch(NETISR_ETHER, m);
-		m = mn;
+	return (_mm_set1_epi16((short)v));
+}
+
+static void
+ether_classify_sse(const uint16_t *types, uint8_t *cls, u_int n)
+{
+	__m128i t, c;
+	u_int i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		t = _mm_loadu_si128((const __m128i *)&types[i]);
+		c = ETHER_CLASSIFY_LANES(ether_set1_sse,
+		    _mm_cmpeq_epi16, _mm_and_si128, _mm_or_si128, t);
+		_mm_storel_epi64((__m128i *)&cls[i], _mm_packus_epi16(c, c));
 	}
+	ether_classify_scalar(&types[i], &cls[i], n - i);
 }
 
+static inline __attribute__((target("avx2"))) __m256i
+ether_set1_avx2(uint16_t v)
+{
+
+	return (_mm256_set1_epi16((short)v));
+}
+
+static __attribute__((target("avx2"))) void
+ether_classify_avx2(const uint16_t *types, uint8_t *cls, u_int n)
+{
+	__m256i t, c;
+	u_int i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		t = _mm256_loadu_si256((const __m256i *)&types[i]);
+		c = ETHER_CLASSIFY_LANES(ether_set1_avx2,
+		    _mm256_cmpeq_epi16, _mm256_and_si256, _mm256_or_si256, t);
+		_mm_storeu_si128((__m128i *)&cls[i],
+		    _mm_packus_epi16(_mm256_castsi256_si128(c),
+		    _mm256_extracti128_si256(c, 1)));
+	}
+	ether_classify_sse(&types[i], &cls[i], n - i);
+}
+#endif /* RTE_ARCH_X86 */
+
+static ether_classify_t	*ether_classify = ether_classify_scalar;
+
+static ether_host_input_t	*ether_host;
+
 /*
- * Upper layer processing for a received Ethernet packet.
+ * Input a vector of n frames received on ifp.  Each frame may be a chain
+ * of segments linked with m->next (scattered RX of jumbo frames); frames
+ * are only ever linked together by the vector.  This is the only place
+ * received frames go through ether_rxfilter().
  */
 void
-ether_demux(struct ifnet *ifp, struct rte_mbuf *m)
+ether_input(struct ifnet *ifp, struct rte_mbuf **m, u_int n)
+{
+
+	n = ether_rxfilter(ifp->if_port, m, n);
+	netisr_dispatch_burst(NETISR_ETHER, 0, m, n);
+}
+
+void
+ether_host_register(ether_host_input_t *input)
+{
+
+	ether_host = input;
+}
+
+/*
+ * Pass a frame the stack does not consume to the host.  m is at its
+ * network header with the m->l2_len bytes of Ethernet header it came with
+ * in front, as ether_demux() leaves it; the header and the tags the NIC or
+ * vlan_input() stripped are put back on.  Consumes m.
+ */
+void
+ether_host_input(struct rte_mbuf *m)
+{
+	struct ifnet *ifp;
+
+	if (unlikely(ether_host == NULL ||
+	    rte_pktmbuf_prepend(m, m->l2_len) == NULL ||
+	    vlan_restore(m) != 0)) {
+		ifp = ifnet_byport[m->port];
+		if (ifp != NULL)
+			if_inc_counter(ifp, IFCOUNTER_IQDROPS, 1);
+		rte_pktmbuf_free(m);
+		return;
+	}
+	ether_host(m);
+}
+
+#define	ETHER_FILTER_PREFETCH	4
+
+/*
+ * Destination address of a frame as an integer, for one-compare matching.
+ */
+static inline uint64_t
+ether_addr_u64(const struct ether_addr *ea)
+{
+	uint64_t v;
+
+	v = 0;
+	memcpy(&v, ea, ETHER_ADDR_LEN);
+	return (v);
+}
+
+/*
+ * Destination filter for a port in promiscuous mode, where the NIC hands
+ * us every frame on the segment: keep frames to our address, broadcast and
+ * the multicast groups in the port's hash filter (all multicast with
+ * IFF_ALLMULTI), and drop the rest before anything else looks at them.
+ * Compacts m[] and returns the number of frames kept.
+ */
+u_int
+ether_rxfilter(uint8_t port, struct rte_mbuf **m, u_int n)
+{
+	const struct ether_hdr *eh;
+	struct ifnet *ifp;
+	uint64_t lladdr, mcfilter;
+	u_int i, k, ucdrops, mcdrops;
+	int allmulti;
+
+	ifp = ifnet_byport[port];
+	if (ifp == NULL || !(ifp->if_flags & IFF_PROMISC))
+		return (n);
+
+	lladdr = ether_addr_u64(&ifp->if_addr);
+	mcfilter = ifp->if_mcfilter;
+	allmulti = ifp->if_flags & IFF_ALLMULTI;
+	ucdrops = mcdrops = 0;
+	for (i = 0; i < RTE_MIN(n, ETHER_FILTER_PREFETCH); i++)
+		rte_prefetch0(rte_pktmbuf_mtod(m[i], void *));
+	for (i = k = 0; i < n; i++) {
+		if (i + ETHER_FILTER_PREFETCH < n)
+			rte_prefetch0(rte_pktmbuf_mtod(
+			    m[i + ETHER_FILTER_PREFETCH], void *));
+		eh = rte_pktmbuf_mtod(m[i], const struct ether_hdr *);
+		if (likely(ether_addr_u64(&eh->d_addr) == lladdr)) {
+			m[k++] = m[i];
+			continue;
+		}
+		if (!is_multicast_ether_addr(&eh->d_addr)) {
+			ucdrops++;
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (!allmulti && !is_broadcast_ether_addr(&eh->d_addr) &&
+		    !(mcfilter & (UINT64_C(1) << if_mchash(&eh->d_addr)))) {
+			mcdrops++;
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		m[k++] = m[i];
+	}
+	if (ucdrops != 0)
+		if_inc_counter(ifp, IFCOUNTER_IUCFILTERED, ucdrops);
+	if (mcdrops != 0)
+		if_inc_counter(ifp, IFCOUNTER_IMCFILTERED, mcdrops);
+	return (k);
+}
+
+/*
+ * Hardware packet types.  Most PMDs classify frames on receive and leave
+ * the result in m->packet_type; ether_probe_ptypes() records, per port,
+ * whether the PMD says it does, and for those ports the demux takes the
+ * protocol from packet_type without touching the frame.  Frames the PMD
+ * could not classify, and all frames of other ports, are classified in
+ * software, which then fills in packet_type itself.  Either way upper
+ * layers get packet_type, l2_len and l3_len set.
+ */
+#define	ETHER_HWPT_L3		0x01	/* PMD reports IPv4/IPv6. */
+#define	ETHER_HWPT_ARP		0x02	/* PMD reports ARP. */
+static uint8_t	ether_hwptypes[RTE_MAX_ETHPORTS];
+
+#define	ETHER_CLASS_UNKNOWN	0xff	/* packet_type says nothing. */
+
+void
+ether_probe_ptypes(uint8_t port)
+{
+	uint32_t ptypes[64];
+	int i, n;
+
+	ether_hwptypes[port] = 0;
+	n = rte_eth_dev_get_supported_ptypes(port,
+	    RTE_PTYPE_L2_MASK | RTE_PTYPE_L3_MASK, ptypes, RTE_DIM(ptypes));
+	for (i = 0; i < n && i < (int)RTE_DIM(ptypes); i++) {
+		if (RTE_ETH_IS_IPV4_HDR(ptypes[i]) ||
+		    RTE_ETH_IS_IPV6_HDR(ptypes[i]))
+			ether_hwptypes[port] |= ETHER_HWPT_L3;
+		else if (ptypes[i] == RTE_PTYPE_L2_ETHER_ARP)
+			ether_hwptypes[port] |= ETHER_HWPT_ARP;
+	}
+	RTE_LOG(INFO, NET, "port %u: %s packet type classification\n",
+	    port, ether_hwptypes[port] & ETHER_HWPT_L3 ? "hardware" :
+	    "software");
+}
+
+/*
+ * Attach the ifnet of a started port and find out whether the PMD
+ * classifies packets for us.  Returns the ifnet, NULL on failure.
+ */
+struct ifnet *
+ether_ifattach(uint8_t port)
+{
+	struct ifnet *ifp;
+
+	ifp = if_attach(port);
+	if (ifp == NULL)
+		return (NULL);
+	ether_probe_ptypes(port);
+	return (ifp);
+}
+
+/*
+ * Set up the L2 template of a next hop reached through ifp.
+ */
+void
+ether_l2tmpl_set(struct ether_l2tmpl *t, const struct ifnet *ifp,
+    const struct ether_addr *dst, uint16_t type)
 {
 	struct ether_hdr *eh;
-	int i, isr;
-	u_short ether_type;
 
-	//KASSERT(ifp != NULL, ("%s: NULL interface pointer", __func__));
+	t->et_valid = 0;
+	rte_smp_wmb();
+	eh = (struct ether_hdr *)&t->et_hdr[2];
+	memset(t->et_hdr, 0, 2);
+	ether_addr_copy(dst, &eh->d_addr);
+	ether_addr_copy(&ifp->if_addr, &eh->s_addr);
+	eh->ether_type = rte_cpu_to_be_16(type);
+	rte_smp_wmb();
+	t->et_valid = 1;
+}
 
-	eh = rte_pktmbuf_mtod(m, struct ether_hdr *);
-	ether_type = rte_be_to_cpu_16(eh->ether_type);
+void
+ether_l2tmpl_invalidate(struct ether_l2tmpl *t)
+{
 
-	rte_pktmbuf_adj(m, ETHER_HDR_LEN);
+	t->et_valid = 0;
+	rte_smp_wmb();
+}
+
+/*
+ * Prepend the Ethernet header of template t to the frame and send it on
+ * ifp.  The header is written in place in the headroom; the payload is
+ * never copied.  Consumes the mbuf.
+ */
+int
+ether_output(struct ifnet *ifp, struct rte_mbuf *m,
+    const struct ether_l2tmpl *t)
+{
+	struct ether_hdr *eh;
+	struct ifnet *port;
+
+	if (unlikely(!t->et_valid)) {
+		if_inc_counter(ifp, IFCOUNTER_OERRORS, 1);
+		rte_pktmbuf_free(m);
+		return (EHOSTUNREACH);
+	}
+	rte_smp_rmb();
+
+	eh = (struct ether_hdr *)rte_pktmbuf_prepend(m, ETHER_HDR_LEN);
+	if (unlikely(eh == NULL)) {
+		if_inc_counter(ifp, IFCOUNTER_OERRORS, 1);
+		rte_pktmbuf_free(m);
+		return (ENOBUFS);
+	}
+#ifdef RTE_ARCH_X86
+	/* The 2 bytes in front of the header are headroom we may clobber. */
+	if (likely(rte_pktmbuf_headroom(m) >= 2))
+		_mm_storeu_si128((__m128i *)((uint8_t *)eh - 2),
+		    _mm_load_si128((const __m128i *)t->et_hdr));
+	else
+#endif
+		rte_memcpy(eh, &t->et_hdr[2], ETHER_HDR_LEN);
+	m->l2_len = ETHER_HDR_LEN;
+
+	if (ifp->if_parent != NULL) {
+		port = vlan_encap(ifp, m);
+		if (port == NULL)
+			return (ENOBUFS);
+	} else
+		port = ifp;
+	if_inc_counter(port, IFCOUNTER_OPACKETS, 1);
+	if_inc_counter(port, IFCOUNTER_OBYTES, m->pkt_len);
+	if_transmit(port, m);
+	return (0);
+}
+
+/*
+ * Send what ether_output() buffered on this lcore.
+ */
+void
+ether_flush(void)
+{
+
+	if_flush();
+}
+
+/*
+ * Classify a frame from its hardware packet type alone.
+ */
+static inline uint8_t
+ether_classify_ptype(uint32_t ptype, uint8_t hwpt)
+{
+
+	switch (ptype & RTE_PTYPE_L2_MASK) {
+	case RTE_PTYPE_L2_ETHER_VLAN:
+	case RTE_PTYPE_L2_ETHER_QINQ:
+		return (ETHER_CLASS_VLAN);
+	case RTE_PTYPE_L2_ETHER_ARP:
+		if (hwpt & ETHER_HWPT_ARP)
+			return (ETHER_CLASS_ARP);
+		break;
+	}
+	if (RTE_ETH_IS_IPV4_HDR(ptype))
+		return (ETHER_CLASS_IPV4);
+	if (RTE_ETH_IS_IPV6_HDR(ptype))
+		return (ETHER_CLASS_IPV6);
+	return (ETHER_CLASS_UNKNOWN);
+}
+
+static inline uint8_t
+ether_classify_mbuf(struct rte_mbuf *m, uint8_t hwpt)
+{
+	uint8_t c;
+
+	if (hwpt & ETHER_HWPT_L3) {
+		c = ether_classify_ptype(m->packet_type, hwpt);
+		if (c != ETHER_CLASS_UNKNOWN)
+			return (c);
+	}
+	return (ether_classify_one(rte_pktmbuf_mtod(m,
+	    struct ether_hdr *)->ether_type));
+}
+
+/*
+ * Fill in l2_len, l3_len and, where the PMD did not, packet_type for a
+ * classified frame whose Ethernet header is still in place.
+ */
+static inline void
+ether_input_ptype(struct rte_mbuf *m, uint8_t c)
+{
+	const struct ipv4_hdr *ip;
+	struct ipv4_hdr iph;
+
+	m->l2_len = ETHER_HDR_LEN;
+	switch (c) {
+	case ETHER_CLASS_IPV4:
+		if ((m->packet_type & RTE_PTYPE_L3_MASK) == RTE_PTYPE_L3_IPV4) {
+			m->l3_len = sizeof(struct ipv4_hdr);
+			break;
+		}
+		/* The header may span segments; ip_input() checks it. */
+		ip = rte_pktmbuf_read(m, ETHER_HDR_LEN, sizeof(iph), &iph);
+		m->l3_len = ip == NULL ? sizeof(iph) :
+		    (ip->version_ihl & IPV4_HDR_IHL_MASK) * IPV4_IHL_MULTIPLIER;
+		if (!RTE_ETH_IS_IPV4_HDR(m->packet_type))
+			m->packet_type = RTE_PTYPE_L2_ETHER |
+			    (m->l3_len == sizeof(struct ipv4_hdr) ?
+			    RTE_PTYPE_L3_IPV4 : RTE_PTYPE_L3_IPV4_EXT);
+		break;
+	case ETHER_CLASS_IPV6:
+		/* Fixed header only; ip6_input walks extension headers. */
+		m->l3_len = sizeof(struct ipv6_hdr);
+		if (!RTE_ETH_IS_IPV6_HDR(m->packet_type))
+			m->packet_type = RTE_PTYPE_L2_ETHER |
+			    RTE_PTYPE_L3_IPV6_EXT_UNKNOWN;
+		break;
+	case ETHER_CLASS_ARP:
+		m->l3_len = 0;
+		m->packet_type = RTE_PTYPE_L2_ETHER_ARP;
+		break;
+	}
+}
+
+/*
+ * Whether the NIC stripped 802.1Q tags off a frame into the mbuf.
+ */
+static inline int
+ether_vlan_stripped(const struct rte_mbuf *m)
+{
+
+	return ((m->ol_flags & (PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT)) != 0);
+}
+
+/*
+ * Record the receiving interface of a frame in the mbuf, see m_rcvif(): ifp
+ * if the caller knows it, else the port or the VLAN interface the stripped
+ * tags name.  Returns -1 if the frame was for no VLAN of ours and is gone.
+ */
+static inline int
+ether_setrcvif(struct ifnet *ifp, struct rte_mbuf *m)
+{
+
+	if (ifp == NULL) {
+		if (likely(!ether_vlan_stripped(m)))
+			ifp = ifnet_byport[m->port];
+		else if ((ifp = vlan_rcvif(m)) == NULL)
+			return (-1);
+	}
+	m_setrcvif(m, ifp);
+	return (0);
+}
+
+/*
+ * Upper layer processing for a received Ethernet packet.  ifp is NULL for
+ * a frame straight off a port, and the VLAN interface for a frame whose
+ * tags vlan_input() removed.
+ */
+void
+ether_demux(struct ifnet *ifp, struct rte_mbuf *m)
+{
+	int isr;
+	uint8_t c;
+
+	//KASSERT(ifp != NULL, ("%s: NULL interface pointer", __func__));
+
+	c = ether_classify_mbuf(m, ether_hwptypes[m->port]);
+	if (c == ETHER_CLASS_VLAN) {
+		vlan_input(m);
+		return;
+	}
+	if (ether_setrcvif(ifp, m) != 0)
+		return;
 
 	/*
 	 * Dispatch frame to upper layer.
 	 */
-	switch (ether_type) {
-	case ETHER_TYPE_IPv4:
+	switch (c) {
+	case ETHER_CLASS_IPV4:
 		isr = NETISR_IP;
 		break;
 
-	case ETHER_TYPE_ARP:
+	case ETHER_CLASS_ARP:
 		isr = NETISR_ARP;
 		break;
 #ifdef INET6
-	case ETHER_TYPE_IPv6:
+	case ETHER_CLASS_IPV6:
 		isr = NETISR_IPV6;
 		break;
 #endif
 	default:
-		goto discard;
+		goto host;
 	}
+	ether_input_ptype(m, c);
+	rte_pktmbuf_adj(m, ETHER_HDR_LEN);
 	netisr_dispatch(isr, m);
 	return;
 
-discard:
+host:
 	/*
-	 * Packet is to be discarded.  If netgraph is present,
-	 * hand the packet to it for last chance processing;
-	 * otherwise dispose of it.
+	 * Not a protocol of ours: hand the frame, header in place, to the
+	 * host for last chance processing.
 	 */
-	rte_pktmbuf_free(m);
+	m->l2_len = 0;
+	ether_host_input(m);
+}
+
+/*
+ * Burst version of ether_demux(): classify the burst, from the hardware
+ * packet types when the port has them and by ethertype otherwise, and hand
+ * each protocol its packets as one sub-burst.
+ */
+void
+ether_demux_burst(struct ifnet *ifp, struct rte_mbuf **m, u_int n)
+{
+	struct rte_mbuf *sub[ETHER_NCLASS][ETHER_DEMUX_BURST];
+	uint16_t types[ETHER_DEMUX_BURST];
+	uint8_t cls[ETHER_DEMUX_BURST];
+	u_int cnt[ETHER_NCLASS];
+	u_int c, i, j, k, l;
+	uint8_t hwpt;
+
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, ETHER_DEMUX_BURST);
+		hwpt = ether_hwptypes[m[i]->port];
+		if (hwpt & ETHER_HWPT_L3) {
+			for (j = 0; j < k; j++)
+				cls[j] = ether_classify_mbuf(m[i + j], hwpt);
+		} else {
+			for (j = 0; j < k; j++)
+				types[j] = rte_pktmbuf_mtod(m[i + j],
+				    struct ether_hdr *)->ether_type;
+			ether_classify(types, cls, k);
+		}
+
+		memset(cnt, 0, sizeof(cnt));
+		for (j = 0; j < k; j++) {
+			c = cls[j];
+			sub[c][cnt[c]++] = m[i + j];
+		}
+		for (c = ETHER_CLASS_IPV4; c <= ETHER_CLASS_IPV6; c++) {
+			for (j = l = 0; j < cnt[c]; j++) {
+				if (unlikely(ether_setrcvif(ifp,
+				    sub[c][j]) != 0))
+					continue;
+				ether_input_ptype(sub[c][j], c);
+				rte_pktmbuf_adj(sub[c][j], ETHER_HDR_LEN);
+				sub[c][l++] = sub[c][j];
+			}
+			cnt[c] = l;
+		}
+
+		netisr_dispatch_burst(NETISR_IP, 0, sub[ETHER_CLASS_IPV4],
+		    cnt[ETHER_CLASS_IPV4]);
+		netisr_dispatch_burst(NETISR_ARP, 0, sub[ETHER_CLASS_ARP],
+		    cnt[ETHER_CLASS_ARP]);
+#ifdef INET6
+		netisr_dispatch_burst(NETISR_IPV6, 0, sub[ETHER_CLASS_IPV6],
+		    cnt[ETHER_CLASS_IPV6]);
+#else
+		for (j = 0; j < cnt[ETHER_CLASS_IPV6]; j++)
+			ether_host_input(sub[ETHER_CLASS_IPV6][j]);
+#endif
+		for (j = 0; j < cnt[ETHER_CLASS_VLAN]; j++)
+			vlan_input(sub[ETHER_CLASS_VLAN][j]);
+		for (j = 0; j < cnt[ETHER_CLASS_OTHER]; j++) {
+			sub[ETHER_CLASS_OTHER][j]->l2_len = 0;
+			ether_host_input(sub[ETHER_CLASS_OTHER][j]);
+		}
+	}
 }
 
 /*
@@ -130,7 +668,7 @@ ether_input_internal(struct ifnet *ifp, struct rte_mbuf *m)
 	ether_demux(ifp, m);
 }
 
-static void
+void
 ether_nh_input(struct rte_mbuf *m)
 {
 
@@ -138,9 +676,29 @@ ether_nh_input(struct rte_mbuf *m)
 	ether_input_internal(NULL, m);
 }
 
+static void
+ether_nh_input_burst(struct rte_mbuf **m, u_int n)
+{
+	u_int i, k;
+
+	/* Drop runts, as ether_input_internal() does, then demux. */
+	for (i = k = 0; i < n; i++) {
+		if (unlikely(m[i]->data_len < ETHER_HDR_LEN)) {
+			RTE_LOG(ERR, NET, "discard frame w/o leading ethernet "
+			    "header (len %u pkt len %u)\n",
+			    m[i]->data_len, m[i]->pkt_len);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		m[k++] = m[i];
+	}
+	ether_demux_burst(NULL, m, k);
+}
+
 static struct netisr_handler	ether_nh = {
 	.nh_name = "ether",
 	.nh_handler = ether_nh_input,
+	.nh_bhandler = ether_nh_input_burst,
 	.nh_proto = NETISR_ETHER,
 #ifdef RSS
 	.nh_policy = NETISR_POLICY_CPU,
@@ -152,8 +710,15 @@ static struct netisr_handler	ether_nh = {
 #endif
 };
 
-static void
-ether_init(void *arg)
+void
+ether_init(void)
 {
+
+#ifdef RTE_ARCH_X86
+	if (rte_cpu_get_flag_enabled(RTE_CPUFLAG_AVX2) > 0)
+		ether_classify = ether_classify_avx2;
+	else
+		ether_classify = ether_classify_sse;
+#endif
 	netisr_register(&ether_nh);
 }
@@ -0,0 +1,260 @@
+/*
+ * Gratuitous ARP and unsolicited neighbour advertisement trains, sent by
+ * the control lcore when addresses arrive on this box (a VIP added, or
+ * taken over from a failed peer) so that switches and neighbours learn
+ * where they are now.  Each address gets its announcement built once, as
+ * a complete frame; every shot of the train is a clone of it, and only
+ * the template is freed when the train is over.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
+
+#include <rte_byteorder.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include "if_arp.h"
+#include "if_var.h"
+#include "if_vlan_var.h"
+#include "ethernet.h"
+
+#define	GARP_NB_MBUF	1023
+#define	GARP_CACHE	32
+
+struct garp {
+	TAILQ_ENTRY(garp) ga_link;
+	struct rte_mbuf	*ga_m;		/* the frame, with its tags */
+	struct ifnet	*ga_ifp;	/* interface announced on */
+	struct ifnet	*ga_port;	/* port it goes out of */
+	int		ga_af;
+	union {
+		struct in_addr	addr4;
+		struct in6_addr	addr6;
+	} ga_addr;
+	u_int		ga_left;	/* shots to go */
+	uint64_t	ga_interval;	/* TSC cycles between shots */
+	uint64_t	ga_next;	/* TSC of the next shot */
+};
+
+static TAILQ_HEAD(, garp)	garp_trains = TAILQ_HEAD_INITIALIZER(garp_trains);
+static struct rte_mempool	*garp_pool;
+
+static const struct ether_addr	garp_bcast = {
+	.addr_bytes = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }
+};
+static const struct ether_addr	garp_allnodes = {
+	.addr_bytes = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 }
+};
+
+/*
+ * Gratuitous ARP request for addr: sender and target are both addr.
+ */
+static void
+garp_build_arp(struct ifnet *ifp, struct rte_mbuf *m,
+    const struct in_addr *addr)
+{
+	struct arphdr *ah;
+
+	ah = (struct arphdr *)rte_pktmbuf_append(m,
+	    arphdr_len2(ETHER_ADDR_LEN, sizeof(struct in_addr)));
+	ah->ar_hrd = htons(ARPHRD_ETHER);
+	ah->ar_pro = htons(ETHER_TYPE_IPv4);
+	ah->ar_hln = ETHER_ADDR_LEN;
+	ah->ar_pln = sizeof(struct in_addr);
+	ah->ar_op = htons(ARPOP_REQUEST);
+	memcpy(ar_sha(ah), &ifp->if_addr, ETHER_ADDR_LEN);
+	memcpy(ar_spa(ah), addr, sizeof(*addr));
+	memset(ar_tha(ah), 0, ETHER_ADDR_LEN);
+	memcpy(ar_tpa(ah), addr, sizeof(*addr));
+}
+
+/*
+ * Unsolicited neighbour advertisement for addr to all nodes, with the
+ * override flag and our link-layer address (RFC 4861 7.2.6).
+ */
+static void
+garp_build_na(struct ifnet *ifp, struct rte_mbuf *m,
+    const struct in6_addr *addr)
+{
+	struct ip6_hdr *ip6;
+	struct nd_neighbor_advert *na;
+	struct nd_opt_hdr *opt;
+	uint32_t sum;
+	uint16_t plen;
+
+	plen = sizeof(*na) + sizeof(*opt) + ETHER_ADDR_LEN;
+	ip6 = (struct ip6_hdr *)rte_pktmbuf_append(m, sizeof(*ip6) + plen);
+	ip6->ip6_flow = htonl(6 << 28);
+	ip6->ip6_plen = htons(plen);
+	ip6->ip6_nxt = IPPROTO_ICMPV6;
+	ip6->ip6_hlim = 255;
+	ip6->ip6_src = *addr;
+	memset(&ip6->ip6_dst, 0, sizeof(ip6->ip6_dst));
+	ip6->ip6_dst.s6_addr[0] = 0xff;
+	ip6->ip6_dst.s6_addr[1] = 0x02;
+	ip6->ip6_dst.s6_addr[15] = 0x01;
+
+	na = (struct nd_neighbor_advert *)(ip6 + 1);
+	memset(na, 0, sizeof(*na));
+	na->nd_na_type = ND_NEIGHBOR_ADVERT;
+	na->nd_na_flags_reserved = ND_NA_FLAG_OVERRIDE;
+	na->nd_na_target = *addr;
+	opt = (struct nd_opt_hdr *)(na + 1);
+	opt->nd_opt_type = ND_OPT_TARGET_LINKADDR;
+	opt->nd_opt_len = 1;
+	memcpy(opt + 1, &ifp->if_addr, ETHER_ADDR_LEN);
+
+	/* Pseudo-header, then the message. */
+	sum = rte_raw_cksum(&ip6->ip6_src, 2 * sizeof(struct in6_addr));
+	sum += rte_cpu_to_be_16(plen) + rte_cpu_to_be_16(IPPROTO_ICMPV6);
+	sum += rte_raw_cksum(na, plen);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	na->nd_na_cksum = (uint16_t)~sum;
+}
+
+/*
+ * Build the announcement of addr on ifp, ready to go out of its port.
+ */
+static struct rte_mbuf *
+garp_build(struct ifnet *ifp, int af, const void *addr, struct ifnet **port)
+{
+	struct ether_hdr *eh;
+	struct rte_mbuf *m;
+
+	m = rte_pktmbuf_alloc(garp_pool);
+	if (m == NULL)
+		return (NULL);
+	if (af == AF_INET)
+		garp_build_arp(ifp, m, addr);
+	else
+		garp_build_na(ifp, m, addr);
+
+	eh = (struct ether_hdr *)rte_pktmbuf_prepend(m, ETHER_HDR_LEN);
+	ether_addr_copy(af == AF_INET ? &garp_bcast : &garp_allnodes,
+	    &eh->d_addr);
+	ether_addr_copy(&ifp->if_addr, &eh->s_addr);
+	eh->ether_type = rte_cpu_to_be_16(af == AF_INET ? ETHER_TYPE_ARP :
+	    ETHER_TYPE_IPv6);
+	m->l2_len = ETHER_HDR_LEN;
+
+	if (ifp->if_parent != NULL)
+		*port = vlan_encap(ifp, m);
+	else
+		*port = ifp;
+	return (*port != NULL ? m : NULL);
+}
+
+static int
+garp_match(const struct garp *ga, const struct ifnet *ifp, int af,
+    const void *addr)
+{
+
+	return (ga->ga_ifp == ifp && ga->ga_af == af &&
+	    memcmp(&ga->ga_addr, addr, af == AF_INET ?
+	    sizeof(struct in_addr) : sizeof(struct in6_addr)) == 0);
+}
+
+/*
+ * Announce naddrs addresses of family af (an array of struct in_addr or
+ * struct in6_addr) on ifp, count times each, interval_ms apart; the first
+ * shot goes out on the next garp_poll().  Announcing an address whose
+ * train is still running starts it over.  Control lcore only.
+ */
+int
+garp_announce(struct ifnet *ifp, int af, const void *addrs, u_int naddrs,
+    u_int count, u_int interval_ms)
+{
+	const uint8_t *addr;
+	struct garp *ga;
+	size_t alen;
+	u_int i;
+
+	if (af != AF_INET && af != AF_INET6)
+		return (EAFNOSUPPORT);
+	if (count == 0)
+		return (0);
+	alen = af == AF_INET ? sizeof(struct in_addr) :
+	    sizeof(struct in6_addr);
+	for (i = 0, addr = addrs; i < naddrs; i++, addr += alen) {
+		TAILQ_FOREACH(ga, &garp_trains, ga_link)
+			if (garp_match(ga, ifp, af, addr))
+				break;
+		if (ga == NULL) {
+			ga = rte_zmalloc("garp", sizeof(*ga), 0);
+			if (ga == NULL)
+				return (ENOMEM);
+			ga->ga_m = garp_build(ifp, af, addr, &ga->ga_port);
+			if (ga->ga_m == NULL) {
+				rte_free(ga);
+				return (ENOBUFS);
+			}
+			ga->ga_ifp = ifp;
+			ga->ga_af = af;
+			memcpy(&ga->ga_addr, addr, alen);
+			TAILQ_INSERT_TAIL(&garp_trains, ga, ga_link);
+		}
+		ga->ga_left = count;
+		ga->ga_interval = rte_get_timer_hz() * interval_ms / 1000;
+		ga->ga_next = 0;
+	}
+	return (0);
+}
+
+/*
+ * Send the shots that are due; returns how many went out.  Control lcore
+ * only, the frames leave with its next ether_flush().
+ */
+u_int
+garp_poll(void)
+{
+	struct garp *ga, *next;
+	struct rte_mbuf *m;
+	uint64_t now;
+	u_int n;
+
+	now = rte_get_timer_cycles();
+	n = 0;
+	for (ga = TAILQ_FIRST(&garp_trains); ga != NULL; ga = next) {
+		next = TAILQ_NEXT(ga, ga_link);
+		if (now < ga->ga_next)
+			continue;
+		/*
+		 * Out of mbufs, which is likely just as a failover sends
+		 * many trains at once: the shot is not lost, only late, it
+		 * goes again on the next poll.
+		 */
+		m = rte_pktmbuf_clone(ga->ga_m, garp_pool);
+		if (m == NULL)
+			continue;
+		if_inc_counter(ga->ga_port, IFCOUNTER_OPACKETS, 1);
+		if_inc_counter(ga->ga_port, IFCOUNTER_OBYTES, m->pkt_len);
+		if_transmit(ga->ga_port, m);
+		n++;
+		ga->ga_next = now + ga->ga_interval;
+		if (--ga->ga_left == 0) {
+			TAILQ_REMOVE(&garp_trains, ga, ga_link);
+			rte_pktmbuf_free(ga->ga_m);
+			rte_free(ga);
+		}
+	}
+	return (n);
+}
+
+int
+garp_init(void)
+{
+
+	garp_pool = rte_pktmbuf_pool_create("garp_pool", GARP_NB_MBUF,
+	    GARP_CACHE, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	return (garp_pool == NULL ? ENOMEM : 0);
+}
@@ -0,0 +1,517 @@
+/*-
+ * Copyright (c) 2004 Luigi Rizzo, Alessandro Cerri. All rights reserved.
+ * Copyright (c) 2004-2008 Qing Li. All rights reserved.
+ * Copyright (c) 2008 Kip Macy. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <rte_atomic.h>
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_ether.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+
+#include "if_var.h"
+#include "if_llatbl.h"
+#include "ethernet.h"
+#include "epoch.h"
+
+#define RTE_LOGTYPE_NET RTE_LOGTYPE_USER1
+
+struct lltable {
+	struct llentry	*llt_hash[LLTBL_HASHSIZE];
+	int		llt_socket;
+	u_int		llt_entries;
+};
+
+#define	LLT_INDEX(af)	((af) == AF_INET6)
+
+/* Buckets lla_timer() looks at per call. */
+#define	LLT_TIMER_BUCKETS	64
+
+static struct lltable	*lltables[2][RTE_MAX_NUMA_NODES];
+static lla_held_t	*lla_held[2];
+
+/*
+ * Expiry, see lltable_register_probe().  The timer goes by the entries of
+ * one table, the first, where la_asked and la_next are kept; la_expire is
+ * the same in all.
+ */
+static lla_probe_t	*lla_probe[2];
+static uint64_t	lla_maxage[2];		/* TSC cycles */
+static u_int	lla_maxprobes[2];
+static u_int	lla_cursor[2];		/* next bucket for lla_timer() */
+
+static inline uint32_t
+llt_hash(int af, const void *l3addr)
+{
+	uint32_t h;
+
+	if (af == AF_INET)
+		h = rte_hash_crc_4byte(((const struct in_addr *)l3addr)->s_addr,
+		    0);
+	else
+		h = rte_hash_crc(l3addr, sizeof(struct in6_addr), 0);
+	return (h & (LLTBL_HASHSIZE - 1));
+}
+
+static inline int
+llt_match(int af, const struct llentry *lle, const void *l3addr)
+{
+
+	if (af == AF_INET)
+		return (lle->r_l3addr.addr4.s_addr ==
+		    ((const struct in_addr *)l3addr)->s_addr);
+	return (memcmp(&lle->r_l3addr.addr6, l3addr,
+	    sizeof(struct in6_addr)) == 0);
+}
+
+static inline size_t
+llt_keylen(int af)
+{
+
+	return (af == AF_INET ? sizeof(struct in_addr) :
+	    sizeof(struct in6_addr));
+}
+
+/*
+ * The table of this lcore's socket.
+ */
+static inline const struct lltable *
+llt_local(int af)
+{
+	unsigned socket;
+
+	socket = rte_socket_id();
+	if (unlikely(socket >= RTE_MAX_NUMA_NODES))
+		socket = 0;
+	return (lltables[LLT_INDEX(af)][socket]);
+}
+
+int
+lltable_init(void)
+{
+	struct lltable *llt;
+	unsigned lcore, socket;
+	int i;
+
+	RTE_BUILD_BUG_ON(offsetof(struct llentry, lle_ifp) +
+	    sizeof(struct ifnet *) > RTE_CACHE_LINE_SIZE);
+
+	RTE_LCORE_FOREACH(lcore) {
+		socket = rte_lcore_to_socket_id(lcore);
+		for (i = 0; i < 2; i++) {
+			if (lltables[i][socket] != NULL)
+				continue;
+			llt = rte_zmalloc_socket("lltable", sizeof(*llt),
+			    RTE_CACHE_LINE_SIZE, socket);
+			if (llt == NULL) {
+				RTE_LOG(ERR, NET, "%s: cannot allocate table "
+				    "on socket %u\n", __func__, socket);
+				return (ENOMEM);
+			}
+			llt->llt_socket = socket;
+			lltables[i][socket] = llt;
+		}
+	}
+	return (0);
+}
+
+void
+lltable_register_held(int af, lla_held_t *fn)
+{
+
+	lla_held[LLT_INDEX(af)] = fn;
+}
+
+/*
+ * Have the entries of family af expire after maxage seconds unconfirmed,
+ * and fn probe them up to maxprobes times before they go.
+ */
+void
+lltable_register_probe(int af, u_int maxage, u_int maxprobes,
+    lla_probe_t *fn)
+{
+
+	lla_maxage[LLT_INDEX(af)] = (uint64_t)maxage * rte_get_timer_hz();
+	lla_maxprobes[LLT_INDEX(af)] = maxprobes;
+	lla_probe[LLT_INDEX(af)] = fn;
+}
+
+struct llentry *
+lla_lookup(int af, const void *l3addr)
+{
+	const struct lltable *llt;
+	struct llentry *lle;
+
+	llt = llt_local(af);
+	if (unlikely(llt == NULL))
+		return (NULL);
+	for (lle = llt->llt_hash[llt_hash(af, l3addr)]; lle != NULL;
+	    lle = lle->lle_next)
+		if (llt_match(af, lle, l3addr))
+			break;
+	return (lle);
+}
+
+/*
+ * Bulk lookup, in three passes over up to LLTBL_BULK keys so that the
+ * cache misses of a pass overlap: hash and prefetch the buckets, load and
+ * prefetch the chain heads, then walk the chains.  Inlined once per
+ * family so that hashing and matching are specialized.
+ */
+static inline __attribute__((always_inline)) void
+llt_lookup_bulk(const struct lltable *llt, int af, const uint8_t *keys,
+    u_int n, struct llentry **lle)
+{
+	uint32_t h[LLTBL_BULK];
+	struct llentry *e;
+	const size_t keylen = llt_keylen(af);
+	u_int i, j, k;
+
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, LLTBL_BULK);
+		for (j = 0; j < k; j++) {
+			h[j] = llt_hash(af, keys + (i + j) * keylen);
+			rte_prefetch0(&llt->llt_hash[h[j]]);
+		}
+		for (j = 0; j < k; j++) {
+			lle[i + j] = llt->llt_hash[h[j]];
+			if (lle[i + j] != NULL)
+				rte_prefetch0(lle[i + j]);
+		}
+		for (j = 0; j < k; j++) {
+			for (e = lle[i + j]; e != NULL; e = e->lle_next)
+				if (llt_match(af, e, keys + (i + j) * keylen))
+					break;
+			lle[i + j] = e;
+		}
+	}
+}
+
+void
+lla_lookup_bulk(int af, const void *l3addrs, u_int n, struct llentry **lle)
+{
+	const struct lltable *llt;
+
+	llt = llt_local(af);
+	if (unlikely(llt == NULL)) {
+		memset(lle, 0, n * sizeof(*lle));
+		return;
+	}
+	if (af == AF_INET)
+		llt_lookup_bulk(llt, AF_INET, l3addrs, n, lle);
+	else
+		llt_lookup_bulk(llt, AF_INET6, l3addrs, n, lle);
+}
+
+/*
+ * Queue m on incomplete entry lle; consumes m.  Returns ENOBUFS when the
+ * queue is full and m was dropped.
+ */
+int
+lla_hold(struct llentry *lle, struct rte_mbuf *m)
+{
+	struct llentry_hold *lh;
+	uint32_t slot;
+
+	lh = lle->la_hold;
+	slot = __atomic_fetch_add(&lh->lh_count, 1, __ATOMIC_RELAXED);
+	if (slot >= LLE_MAXHOLD) {
+		rte_pktmbuf_free(m);
+		return (ENOBUFS);
+	}
+	lh->lh_m[slot] = m;
+	return (0);
+}
+
+static void
+lla_free(struct epoch_context *ctx)
+{
+	struct llentry *lle;
+	struct llentry_hold *lh;
+	lla_held_t *fn;
+	u_int i, n;
+
+	lle = epoch_containerof(ctx, struct llentry, lle_epoch);
+	lh = lle->la_hold;
+	if (lh != NULL) {
+		n = RTE_MIN(lh->lh_count, (uint32_t)LLE_MAXHOLD);
+		fn = lla_held[LLT_INDEX(lle->lle_af)];
+		if (n != 0 && fn != NULL)
+			fn(lle, lh->lh_m, n);
+		else
+			for (i = 0; i < n; i++)
+				rte_pktmbuf_free(lh->lh_m[i]);
+		rte_free(lh);
+	}
+	rte_free(lle);
+}
+
+/*
+ * The link that points to the entry for l3addr, or ends its chain.
+ */
+static struct llentry **
+llt_find(struct lltable *llt, int af, const void *l3addr)
+{
+	struct llentry **prev;
+
+	for (prev = &llt->llt_hash[llt_hash(af, l3addr)]; *prev != NULL;
+	    prev = &(*prev)->lle_next)
+		if (llt_match(af, *prev, l3addr))
+			break;
+	return (prev);
+}
+
+/*
+ * Retire an unlinked entry.  Readers that still hold it see its template
+ * invalidated; the memory goes once they are all done.
+ */
+static void
+llt_retire(struct llentry *lle)
+{
+
+	ether_l2tmpl_invalidate(&lle->lle_l2tmpl);
+	epoch_call(&lle->lle_epoch, lla_free);
+}
+
+static void
+llt_unlink(struct lltable *llt, struct llentry **prev, struct llentry *lle)
+{
+
+	*prev = lle->lle_next;
+	llt->llt_entries--;
+	llt_retire(lle);
+}
+
+static struct llentry *
+lla_alloc(int af, struct ifnet *ifp, const void *l3addr, unsigned socket)
+{
+	struct llentry *lle;
+
+	lle = rte_zmalloc_socket("llentry", sizeof(*lle), RTE_CACHE_LINE_SIZE,
+	    socket);
+	if (lle == NULL)
+		return (NULL);
+	memcpy(&lle->r_l3addr, l3addr, llt_keylen(af));
+	lle->lle_ifp = ifp;
+	lle->lle_af = af;
+	return (lle);
+}
+
+/*
+ * Link complete entry lle at *prev, in place of old if there is one.
+ */
+static void
+llt_link(struct lltable *llt, struct llentry **prev, struct llentry *old,
+    struct llentry *lle)
+{
+
+	lle->lle_next = old != NULL ? old->lle_next : NULL;
+	rte_smp_wmb();
+	*prev = lle;
+	if (old != NULL)
+		llt_retire(old);
+	else
+		llt->llt_entries++;
+}
+
+/*
+ * Enter an incomplete entry for a next hop being resolved, so that packets
+ * to it can be held; EEXIST if there is an entry already.
+ */
+int
+lla_create(int af, struct ifnet *ifp, const void *l3addr)
+{
+	struct llentry **prev, *lle;
+	struct lltable *llt;
+	unsigned socket;
+
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		llt = lltables[LLT_INDEX(af)][socket];
+		if (llt == NULL)
+			continue;
+		prev = llt_find(llt, af, l3addr);
+		if (*prev != NULL)
+			return (EEXIST);
+		if (llt->llt_entries >= LLTBL_MAXENTRIES)
+			return (ENOBUFS);
+		lle = lla_alloc(af, ifp, l3addr, socket);
+		if (lle == NULL)
+			return (ENOMEM);
+		lle->la_hold = rte_zmalloc_socket("llentry_hold",
+		    sizeof(*lle->la_hold), RTE_CACHE_LINE_SIZE, socket);
+		if (lle->la_hold == NULL) {
+			rte_free(lle);
+			return (ENOMEM);
+		}
+		llt_link(llt, prev, NULL, lle);
+	}
+	return (0);
+}
+
+int
+lla_update(int af, struct ifnet *ifp, const void *l3addr,
+    const struct ether_addr *lladdr, uint16_t flags)
+{
+	struct llentry **prev, *old, *lle;
+	struct lltable *llt;
+	unsigned socket;
+	uint64_t expire;
+
+	flags |= LLE_VALID;
+	expire = rte_get_timer_cycles() + lla_maxage[LLT_INDEX(af)];
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		llt = lltables[LLT_INDEX(af)][socket];
+		if (llt == NULL)
+			continue;
+		prev = llt_find(llt, af, l3addr);
+		old = *prev;
+		if (old != NULL && old->lle_ifp == ifp &&
+		    is_same_ether_addr(&old->ll_addr, lladdr) &&
+		    old->la_flags == flags) {
+			/* Only the control lcore looks at these. */
+			old->la_expire = expire;
+			old->la_asked = 0;
+			continue;
+		}
+		if (old == NULL && llt->llt_entries >= LLTBL_MAXENTRIES)
+			return (ENOBUFS);
+
+		lle = lla_alloc(af, ifp, l3addr, socket);
+		if (lle == NULL)
+			return (ENOMEM);
+		ether_addr_copy(lladdr, &lle->ll_addr);
+		lle->la_flags = flags;
+		lle->la_expire = expire;
+		ether_l2tmpl_set(&lle->lle_l2tmpl, ifp, lladdr,
+		    af == AF_INET ? ETHER_TYPE_IPv4 : ETHER_TYPE_IPv6);
+		llt_link(llt, prev, old, lle);
+	}
+	return (0);
+}
+
+int
+lla_delete(int af, const void *l3addr)
+{
+	struct llentry **prev;
+	struct lltable *llt;
+	unsigned socket;
+	int error;
+
+	error = ENOENT;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		llt = lltables[LLT_INDEX(af)][socket];
+		if (llt == NULL)
+			continue;
+		prev = llt_find(llt, af, l3addr);
+		if (*prev != NULL) {
+			llt_unlink(llt, prev, *prev);
+			error = 0;
+		}
+	}
+	return (error);
+}
+
+/*
+ * Drop all entries through ifp, before it goes away.
+ */
+void
+lla_flush(struct ifnet *ifp)
+{
+	struct llentry **prev;
+	struct lltable *llt;
+	unsigned socket;
+	u_int i, j;
+
+	for (i = 0; i < 2; i++)
+		for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+			llt = lltables[i][socket];
+			if (llt == NULL)
+				continue;
+			for (j = 0; j < LLTBL_HASHSIZE; j++) {
+				prev = &llt->llt_hash[j];
+				while (*prev != NULL) {
+					if ((*prev)->lle_ifp == ifp)
+						llt_unlink(llt, prev, *prev);
+					else
+						prev = &(*prev)->lle_next;
+				}
+			}
+		}
+}
+
+/*
+ * Probe the expired entries of family af in the next LLT_TIMER_BUCKETS
+ * buckets, and delete those that went unanswered; see
+ * lltable_register_probe().
+ */
+void
+lla_timer(int af)
+{
+	struct llentry *lle, *next;
+	struct lltable *llt;
+	unsigned socket;
+	uint64_t now;
+	u_int i, b, idx;
+
+	idx = LLT_INDEX(af);
+	if (lla_probe[idx] == NULL)
+		return;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++)
+		if ((llt = lltables[idx][socket]) != NULL)
+			break;
+	if (socket == RTE_MAX_NUMA_NODES)
+		return;
+	now = rte_get_timer_cycles();
+	for (i = 0; i < LLT_TIMER_BUCKETS; i++) {
+		b = lla_cursor[idx];
+		lla_cursor[idx] = (b + 1) & (LLTBL_HASHSIZE - 1);
+		for (lle = llt->llt_hash[b]; lle != NULL; lle = next) {
+			next = lle->lle_next;
+			if ((lle->la_flags & (LLE_VALID | LLE_STATIC)) !=
+			    LLE_VALID || now < lle->la_expire ||
+			    now < lle->la_next)
+				continue;
+			if (lle->la_asked == lla_maxprobes[idx]) {
+				/* Retired, not freed: next is still good. */
+				lla_delete(af, &lle->r_l3addr);
+				continue;
+			}
+			lla_probe[idx](lle);
+			lle->la_asked++;
+			lle->la_next = now + rte_get_timer_hz();
+		}
+	}
+}
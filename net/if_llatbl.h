@@ -0,0 +1,141 @@
+/*-
+ * Copyright (c) 2004 Luigi Rizzo, Alessandro Cerri. All rights reserved.
+ * Copyright (c) 2004-2008 Qing Li. All rights reserved.
+ * Copyright (c) 2008 Kip Macy. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef	_NET_IF_LLATBL_H_
+#define	_NET_IF_LLATBL_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include <rte_cycles.h>
+#include <rte_ether.h>
+
+#include "ethernet.h"
+#include "epoch.h"
+
+struct ifnet;
+struct rte_mbuf;
+
+/*
+ * Link-layer address tables: one per address family and NUMA socket, all
+ * holding the same entries, so that each lcore resolves next hops from
+ * memory local to it.  Lookups are lock-free; entries are immutable once
+ * linked, bar the expiry fields, and the control lcore, the only writer,
+ * replaces an entry to change it and reclaims the old one through
+ * epoch_call().
+ */
+struct llentry {
+	/* First cache line: everything a lookup and ether_output() touch. */
+	struct ether_l2tmpl	lle_l2tmpl;	/* header to the neighbour */
+	struct llentry		*lle_next;	/* hash chain */
+	union {
+		struct in_addr	addr4;
+		struct in6_addr	addr6;
+	} r_l3addr;
+	struct ifnet		*lle_ifp;	/* interface to the neighbour */
+
+	struct ether_addr	ll_addr;
+	uint16_t		la_flags;
+	uint8_t			lle_af;
+	uint8_t			la_asked;	/* probes since it expired */
+	struct llentry_hold	*la_hold;	/* incomplete entries only */
+	uint64_t		la_expire;	/* TSC it wants confirming by */
+	uint64_t		la_next;	/* TSC of the next probe */
+	struct epoch_context	lle_epoch;
+} __rte_cache_aligned;
+
+#define	LLE_STATIC	0x0002	/* entry is static */
+#define	LLE_VALID	0x0008	/* ll_addr is valid */
+
+/*
+ * Packets waiting for an incomplete entry to resolve.  Any lcore appends
+ * with lla_hold(); nobody takes them out until the entry is retired, at
+ * which point no lcore can append any more and the packets are handed to
+ * the family's lla_held_t, see lltable_register_held().
+ */
+#define	LLE_MAXHOLD	16
+
+struct llentry_hold {
+	volatile uint32_t	lh_count;	/* slots claimed, may exceed max */
+	struct rte_mbuf		*lh_m[LLE_MAXHOLD];
+};
+
+typedef void	lla_held_t(const struct llentry *lle, struct rte_mbuf **m,
+		    u_int n);
+
+/*
+ * Complete entries that are not static expire when nothing confirmed them
+ * for the family's max age: lla_timer() then hands them to its lla_probe_t
+ * once a second, and deletes them after maxprobes went unanswered.  An
+ * answer, like anything else from the neighbour, goes through lla_update(),
+ * which confirms the entry; the dataplane passes such packets on to the
+ * control lcore when the entry has changed or lla_expired() says so.
+ */
+typedef void	lla_probe_t(const struct llentry *lle);
+
+#define	LLTBL_HASHSIZE	4096	/* buckets per table, a power of 2 */
+#define	LLTBL_BULK	32	/* lookups pipelined together */
+#define	LLTBL_MAXENTRIES	65536	/* per table, incomplete ones included */
+
+int	lltable_init(void);
+void	lltable_register_held(int af, lla_held_t *fn);
+void	lltable_register_probe(int af, u_int maxage, u_int maxprobes,
+	    lla_probe_t *fn);
+
+static inline int
+lla_expired(const struct llentry *lle)
+{
+
+	return ((lle->la_flags & (LLE_VALID | LLE_STATIC)) == LLE_VALID &&
+	    rte_get_timer_cycles() >= lle->la_expire);
+}
+
+/*
+ * Dataplane: resolve one or n next hops of family af on this lcore's
+ * socket.  l3addrs is an array of struct in_addr or struct in6_addr;
+ * unknown next hops come back NULL, ones being resolved without
+ * LLE_VALID.
+ */
+struct llentry	*lla_lookup(int af, const void *l3addr);
+void	lla_lookup_bulk(int af, const void *l3addrs, u_int n,
+	    struct llentry **lle);
+int	lla_hold(struct llentry *lle, struct rte_mbuf *m);
+
+/*
+ * Control lcore only.  Adding an entry to a table holding LLTBL_MAXENTRIES
+ * fails with ENOBUFS.
+ */
+int	lla_create(int af, struct ifnet *ifp, const void *l3addr);
+int	lla_update(int af, struct ifnet *ifp, const void *l3addr,
+	    const struct ether_addr *lladdr, uint16_t flags);
+int	lla_delete(int af, const void *l3addr);
+void	lla_flush(struct ifnet *ifp);
+void	lla_timer(int af);
+
+#endif  /* _NET_IF_LLATBL_H_ */
@@ -33,6 +33,19 @@
 #ifndef	_NET_IF_VAR_H_
 #define	_NET_IF_VAR_H_
 
+#include <netinet/in.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_hash_crc.h>
+#include <rte_debug.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+
+#include "if.h"
+#include "ethernet.h"
+
 /*
  * Structures defining a network interface, providing a packet
  * transport mechanism (ala level 0 of the PUP protocols).
@@ -58,9 +71,180 @@
  * interfaces.  These routines live in the files if.c and route.c
  */
 
+/*
+ * Kernel-style assertions; msg is a parenthesized printf argument list.
+ * Compiled in only with INVARIANTS, as in the kernel.
+ */
+#ifdef INVARIANTS
+#define	KASSERT(exp, msg) do {						\
+	if (unlikely(!(exp)))						\
+		rte_panic msg;						\
+} while (0)
+#else
+#define	KASSERT(exp, msg) do {						\
+} while (0)
+#endif
+
+/*
+ * There is one ifnet per DPDK port, attached by if_attach(), and one per
+ * configured 802.1Q VLAN on top of a port (or, for QinQ, on top of an outer
+ * VLAN), see if_vlan.c: ifnet_byport[] and the if_vlans[] of each port are
+ * the ifnet table.  The dataplane finds the receiving ifnet of a packet from
+ * m->port and the VLAN tags left in the mbuf, see if_rcvif().  Entries are
+ * filled in from the kernel's view of the KNI interfaces, see
+ * core/kip_monitor.c.
+ *
+ * The fields the dataplane reads per packet share the first cache line;
+ * configuration only the control plane looks at follows.  Counters are per
+ * lcore, see if_inc_counter().
+ */
+#define	IF_MAXADDRS	8		/* addresses per family */
+
+struct if_pcpu {
+	uint64_t ifc_counters[IFCOUNTERS];
+} __rte_cache_aligned;
+
 struct ifnet {
-	/* Variable fields that are touched by the stack and drivers. */
-	int	if_flags;
+	/* Hot: read by the dataplane for every packet. */
+	int	if_flags;		/* up/down, broadcast, etc. */
+	int	if_capenable;		/* enabled features & capabilities */
+	uint8_t	if_port;		/* DPDK port ID */
+	uint16_t if_vlantag;		/* 802.1Q VLAN ID, 0 on a port */
+	uint16_t if_mtu;		/* maximum transmission unit */
+	struct	ether_addr if_addr;	/* link-level address */
+	struct	ifnet *if_parent;	/* port, or outer VLAN for QinQ */
+	struct	ifnet **if_vlans;	/* VLANs on top, by VLAN ID */
+	struct	if_pcpu *if_pcpu;	/* per-lcore counters */
+	uint64_t if_mcfilter;		/* joined multicast, see if_mchash() */
+
+	/* Cold: configuration. */
+	int	if_capabilities		/* interface features & capabilities */
+	    __rte_cache_aligned;
+	int	if_index;		/* kernel interface index, 0 if none */
+	char	if_xname[IFNAMSIZ];	/* external name */
+	u_int	if_naddrs;		/* IPv4 addresses */
+	struct {
+		struct	in_addr ia_addr;
+		uint8_t	ia_plen;
+	} if_inaddrs[IF_MAXADDRS];
+	u_int	if_naddrs6;		/* IPv6 addresses */
+	struct {
+		struct	in6_addr ia6_addr;
+		uint8_t	ia6_plen;
+	} if_in6addrs[IF_MAXADDRS];
+	uint16_t if_mcrefs[64];		/* joins per if_mcfilter bit */
 };
 
+/*
+ * Counters are per lcore; threads that are not EAL lcores share the last
+ * slot, with the races that implies.
+ */
+static inline void
+if_inc_counter(struct ifnet *ifp, ift_counter cnt, int64_t inc)
+{
+	unsigned lcore;
+
+	lcore = rte_lcore_id();
+	if (unlikely(lcore >= RTE_MAX_LCORE))
+		lcore = RTE_MAX_LCORE;
+	ifp->if_pcpu[lcore].ifc_counters[cnt] += inc;
+}
+
+uint64_t	if_get_counter(const struct ifnet *ifp, ift_counter cnt);
+
+#define	if_name(ifp)	((ifp)->if_xname)
+
+extern struct ifnet	*ifnet_byport[RTE_MAX_ETHPORTS];
+
+/*
+ * Return the VLAN interface with the given ID on top of ifp, if any.
+ */
+static inline struct ifnet *
+if_vlandev(const struct ifnet *ifp, uint16_t vid)
+{
+	struct ifnet *vifp;
+
+	if (ifp == NULL || ifp->if_vlans == NULL)
+		return (NULL);
+	vifp = ifp->if_vlans[vid & EVL_VLID_MASK];
+	if (vifp == NULL || !(vifp->if_flags & IFF_UP))
+		return (NULL);
+	return (vifp);
+}
+
+/*
+ * Receiving interface of a packet: its port, or the VLAN interface the tags
+ * stripped into the mbuf (by the NIC or by vlan_input()) name.
+ */
+static inline struct ifnet *
+if_rcvif(const struct rte_mbuf *m)
+{
+	struct ifnet *ifp;
+
+	ifp = ifnet_byport[m->port];
+	if (m->ol_flags & PKT_RX_QINQ_PKT)
+		ifp = if_vlandev(if_vlandev(ifp, m->vlan_tci_outer),
+		    m->vlan_tci);
+	else if (m->ol_flags & PKT_RX_VLAN_PKT)
+		ifp = if_vlandev(ifp, m->vlan_tci);
+	return (ifp);
+}
+
+/*
+ * The receiving interface is resolved once, by ether_demux(), and kept in
+ * the mbuf for the protocol input routines.  The field is the mbuf's
+ * udata64, which the output path reuses, see arpresolve().
+ */
+static inline struct ifnet *
+m_rcvif(const struct rte_mbuf *m)
+{
+
+	return ((struct ifnet *)(uintptr_t)m->udata64);
+}
+
+static inline void
+m_setrcvif(struct rte_mbuf *m, struct ifnet *ifp)
+{
+
+	m->udata64 = (uintptr_t)ifp;
+}
+
+/*
+ * Multicast groups joined on a port are kept as a 64-bit hash filter, as
+ * NICs do: a group sets the bit its CRC selects.  Groups joined on a VLAN
+ * go to the filter of its port.
+ */
+static inline u_int
+if_mchash(const struct ether_addr *ea)
+{
+
+	return (rte_hash_crc(ea, ETHER_ADDR_LEN, 0) >> 26);
+}
+
+int	if_addmulti(struct ifnet *ifp, const struct ether_addr *ea);
+int	if_delmulti(struct ifnet *ifp, const struct ether_addr *ea);
+
+struct ifnet	*if_alloc(int socket);
+void	if_free(struct ifnet *ifp);
+struct ifnet	*if_attach(uint8_t port);
+void	if_detach(struct ifnet *ifp);
+
+/*
+ * Transmit on a port, through this lcore's TX queue.  Packets are buffered
+ * and go out in bursts; if_flush() sends what this lcore has buffered.
+ */
+void	if_transmit(struct ifnet *ifp, struct rte_mbuf *m);
+void	if_flush(void);
+
+/*
+ * Control plane lookups and configuration.  if_addaddr() of an address
+ * ifp already has updates its prefix length and returns EEXIST.
+ */
+struct ifnet	*ifunit(const char *name);
+struct ifnet	*ifnet_byindex(int idx);
+struct ifnet	*if_walk(int (*f)(struct ifnet *, const void *),
+		    const void *arg);
+int	if_addaddr(struct ifnet *ifp, int af, const void *addr, int plen);
+int	if_deladdr(struct ifnet *ifp, int af, const void *addr);
+
 #endif /* !_NET_IF_VAR_H_ */
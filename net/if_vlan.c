@@ -0,0 +1,325 @@
+/*-
+ * Copyright 1998 Massachusetts Institute of Technology
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that both the above copyright notice and this
+ * permission notice appear in all copies, that both the above
+ * copyright notice and this permission notice appear in all
+ * supporting documentation, and that the name of M.I.T. not be used
+ * in advertising or publicity pertaining to distribution of the
+ * software without specific, written prior permission.  M.I.T. makes
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THIS SOFTWARE IS PROVIDED BY M.I.T. ``AS IS''.  M.I.T. DISCLAIMS
+ * ALL EXPRESS OR IMPLIED WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT
+ * SHALL M.I.T. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+/*
+ * if_vlan.c - pseudo-device driver for IEEE 802.1Q virtual LANs.
+ *
+ * Where the port has IFCAP_VLAN_HWTAGGING, the NIC strips the 802.1Q tag
+ * on receive (m->vlan_tci, PKT_RX_VLAN_PKT) and inserts it on transmit
+ * (PKT_TX_VLAN_PKT); otherwise, and for QinQ, tags are popped and pushed
+ * in software.  A VLAN ifnet has its own
+ * counters and addresses; its MAC address is its port's.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <rte_atomic.h>
+#include <rte_byteorder.h>
+#include <rte_ether.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+
+#include "if.h"
+#include "if_var.h"
+#include "if_vlan_var.h"
+#include "ethernet.h"
+
+#define	VLAN_NVIDS	(EVL_VLID_MASK + 1)
+
+/*
+ * Set by vlan_input() on a frame whose outermost tag did not have the
+ * usual TPID for where it sat: 802.1ad on a lone tag, 802.1Q outside
+ * another one.  rte_mbuf has no flag for it; this bit is one DPDK leaves
+ * free between its receive and transmit flags.
+ */
+#define	PKT_RX_VLAN_ALTTPID	(1ULL << 32)
+
+struct ifnet *
+vlan_create(struct ifnet *parent, uint16_t vid)
+{
+	struct ifnet *ifp;
+
+	KASSERT(vid != 0 && vid < EVL_VLID_MASK,
+	    ("%s: invalid VLAN ID %u", __func__, vid));
+	KASSERT(parent->if_parent == NULL ||
+	    parent->if_parent->if_parent == NULL,
+	    ("%s: more than two tags on %s", __func__, if_name(parent)));
+
+	if (parent->if_vlans == NULL) {
+		parent->if_vlans = rte_zmalloc_socket("if_vlans",
+		    VLAN_NVIDS * sizeof(struct ifnet *), RTE_CACHE_LINE_SIZE,
+		    rte_eth_dev_socket_id(parent->if_port));
+		if (parent->if_vlans == NULL)
+			return (NULL);
+	}
+
+	ifp = parent->if_vlans[vid];
+	if (ifp != NULL) {
+		ifp->if_flags |= IFF_UP;
+		return (ifp);
+	}
+
+	ifp = if_alloc(rte_eth_dev_socket_id(parent->if_port));
+	if (ifp == NULL)
+		return (NULL);
+	ifp->if_port = parent->if_port;
+	ifp->if_vlantag = vid;
+	ifp->if_parent = parent;
+	ifp->if_addr = parent->if_addr;
+	ifp->if_mtu = parent->if_mtu;
+	snprintf(ifp->if_xname, sizeof(ifp->if_xname), "%s.%u",
+	    if_name(parent), vid);
+	ifp->if_flags = parent->if_flags | IFF_UP;
+
+	/* Make the ifnet visible to the dataplane only once it is set up. */
+	rte_smp_wmb();
+	parent->if_vlans[vid] = ifp;
+	return (ifp);
+}
+
+void
+vlan_destroy(struct ifnet *ifp)
+{
+
+	KASSERT(ifp->if_parent != NULL, ("%s: %s is not a VLAN", __func__,
+	    if_name(ifp)));
+
+	ifp->if_flags &= ~IFF_UP;
+}
+
+/*
+ * Free all VLAN ifnets on top of ifp; the dataplane must be stopped.
+ */
+void
+vlan_ifdetach(struct ifnet *ifp)
+{
+	u_int vid;
+
+	if (ifp->if_vlans == NULL)
+		return;
+	for (vid = 0; vid < VLAN_NVIDS; vid++) {
+		if (ifp->if_vlans[vid] == NULL)
+			continue;
+		vlan_ifdetach(ifp->if_vlans[vid]);
+		if_free(ifp->if_vlans[vid]);
+	}
+	rte_free(ifp->if_vlans);
+	ifp->if_vlans = NULL;
+}
+
+static inline int
+vlan_is_tpid(uint16_t type)
+{
+
+	return (type == rte_cpu_to_be_16(ETHER_TYPE_VLAN) ||
+	    type == rte_cpu_to_be_16(ETHER_TYPE_QINQ));
+}
+
+/*
+ * Remove the outermost tag of a frame, returning its TCI.
+ */
+static int
+vlan_pop(struct rte_mbuf *m, uint16_t *tag)
+{
+	struct ether_hdr *eh;
+	struct vlan_hdr *vh;
+
+	if (rte_pktmbuf_data_len(m) < ETHER_HDR_LEN + sizeof(*vh))
+		return (-1);
+	eh = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	vh = (struct vlan_hdr *)(eh + 1);
+	*tag = rte_be_to_cpu_16(vh->vlan_tci);
+	memmove((char *)eh + sizeof(*vh), eh, 2 * ETHER_ADDR_LEN);
+	rte_pktmbuf_adj(m, sizeof(*vh));
+	return (0);
+}
+
+/*
+ * Insert a tag after the MAC addresses of a frame.
+ */
+static int
+vlan_push(struct rte_mbuf *m, uint16_t tpid, uint16_t tag)
+{
+	struct ether_hdr *eh;
+	struct vlan_hdr *vh;
+
+	eh = (struct ether_hdr *)rte_pktmbuf_prepend(m, sizeof(*vh));
+	if (eh == NULL)
+		return (-1);
+	memmove(eh, (char *)eh + sizeof(*vh), 2 * ETHER_ADDR_LEN);
+	vh = (struct vlan_hdr *)&eh->ether_type;
+	vh->eth_proto = rte_cpu_to_be_16(tpid);
+	vh->vlan_tci = rte_cpu_to_be_16(tag);
+	return (0);
+}
+
+struct ifnet *
+vlan_rcvif(struct rte_mbuf *m)
+{
+	struct ifnet *ifp;
+
+	ifp = if_rcvif(m);
+	if (unlikely(ifp == NULL)) {
+		ifp = ifnet_byport[m->port];
+		if (ifp != NULL)
+			if_inc_counter(ifp, IFCOUNTER_NOPROTO, 1);
+		rte_pktmbuf_free(m);
+		return (NULL);
+	}
+	if_inc_counter(ifp, IFCOUNTER_IPACKETS, 1);
+	if_inc_counter(ifp, IFCOUNTER_IBYTES, m->pkt_len);
+	return (ifp);
+}
+
+/*
+ * Input of a frame classified as tagged, Ethernet header in front.  Some
+ * PMDs flag tagged frames they did not strip, so the flags only stand for a
+ * stripped tag where the port strips them (IFCAP_VLAN_HWTAGGING).  A tag
+ * the NIC took off is the outermost one, and tags left in the frame sit
+ * inside it.  Up to two tags in all end up in vlan_tci (and vlan_tci_outer)
+ * and the inner frame goes through the demux again on its VLAN ifnet.
+ */
+void
+vlan_input(struct rte_mbuf *m)
+{
+	struct ether_hdr *eh;
+	struct ifnet *ifp;
+	uint16_t tag, type;
+	int ntags;
+
+	eh = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	ntags = 0;
+	if (vlan_is_tpid(eh->ether_type)) {
+		ifp = ifnet_byport[m->port];
+		if ((m->ol_flags & (PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT)) &&
+		    ifp != NULL && (ifp->if_capenable & IFCAP_VLAN_HWTAGGING))
+			ntags = (m->ol_flags & PKT_RX_QINQ_PKT) ? 2 : 1;
+		else
+			m->ol_flags &= ~(PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT);
+	}
+	for (; vlan_is_tpid(eh->ether_type); ntags++) {
+		type = eh->ether_type;
+		if (ntags == 2 || vlan_pop(m, &tag) != 0)
+			goto drop;
+		if (ntags == 0) {
+			m->vlan_tci = tag;
+			m->ol_flags |= PKT_RX_VLAN_PKT;
+			if (type == rte_cpu_to_be_16(ETHER_TYPE_QINQ))
+				m->ol_flags |= PKT_RX_VLAN_ALTTPID;
+		} else {
+			/*
+			 * The tag before is the outer one now: 802.1Q, as
+			 * the NIC strips, is the odd one out there.
+			 */
+			m->vlan_tci_outer = m->vlan_tci;
+			m->vlan_tci = tag;
+			m->ol_flags |= PKT_RX_QINQ_PKT;
+			m->ol_flags ^= PKT_RX_VLAN_ALTTPID;
+		}
+		eh = rte_pktmbuf_mtod(m, struct ether_hdr *);
+	}
+
+	ifp = vlan_rcvif(m);
+	if (ifp == NULL)
+		return;
+	/* The PMD's packet type described the tagged frame. */
+	m->packet_type = RTE_PTYPE_UNKNOWN;
+	ether_demux(ifp, m);
+	return;
+
+drop:
+	ifp = ifnet_byport[m->port];
+	if (ifp != NULL)
+		if_inc_counter(ifp, IFCOUNTER_IQDROPS, 1);
+	rte_pktmbuf_free(m);
+}
+
+/*
+ * Put the tags a received frame was stripped of, by the NIC or by
+ * vlan_input(), back into it, Ethernet header in front, for the host to
+ * see the frame as it came in.
+ */
+int
+vlan_restore(struct rte_mbuf *m)
+{
+	uint16_t inner, outer;
+
+	inner = ETHER_TYPE_VLAN;
+	outer = ETHER_TYPE_QINQ;
+	if (m->ol_flags & PKT_RX_VLAN_ALTTPID) {
+		if (m->ol_flags & PKT_RX_QINQ_PKT)
+			outer = ETHER_TYPE_VLAN;
+		else
+			inner = ETHER_TYPE_QINQ;
+	}
+	if ((m->ol_flags & (PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT)) &&
+	    vlan_push(m, inner, m->vlan_tci) != 0)
+		return (-1);
+	if ((m->ol_flags & PKT_RX_QINQ_PKT) &&
+	    vlan_push(m, outer, m->vlan_tci_outer) != 0)
+		return (-1);
+	m->ol_flags &= ~(PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT |
+	    PKT_RX_VLAN_ALTTPID);
+	return (0);
+}
+
+struct ifnet *
+vlan_encap(struct ifnet *ifp, struct rte_mbuf *m)
+{
+	struct ifnet *port;
+
+	KASSERT(ifp->if_parent != NULL, ("%s: %s is not a VLAN", __func__,
+	    if_name(ifp)));
+
+	port = ifnet_byport[ifp->if_port];
+	if (ifp->if_parent == port) {
+		if (port->if_capenable & IFCAP_VLAN_HWTAGGING) {
+			m->vlan_tci = ifp->if_vlantag;
+			m->ol_flags |= PKT_TX_VLAN_PKT;
+		} else if (vlan_push(m, ETHER_TYPE_VLAN, ifp->if_vlantag) != 0)
+			goto drop;
+	} else {
+		/* QinQ: inner 802.1Q tag, then the 802.1ad outer tag. */
+		if (vlan_push(m, ETHER_TYPE_VLAN, ifp->if_vlantag) != 0 ||
+		    vlan_push(m, ETHER_TYPE_QINQ,
+		    ifp->if_parent->if_vlantag) != 0)
+			goto drop;
+	}
+	if_inc_counter(ifp, IFCOUNTER_OPACKETS, 1);
+	if_inc_counter(ifp, IFCOUNTER_OBYTES, m->pkt_len);
+	return (port);
+
+drop:
+	if_inc_counter(ifp, IFCOUNTER_OERRORS, 1);
+	rte_pktmbuf_free(m);
+	return (NULL);
+}
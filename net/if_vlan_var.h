@@ -0,0 +1,68 @@
+/*-
+ * Copyright 1998 Massachusetts Institute of Technology
+ *
+ * Permission to use, copy, modify, and distribute this software and
+ * its documentation for any purpose and without fee is hereby
+ * granted, provided that both the above copyright notice and this
+ * permission notice appear in all copies, that both the above
+ * copyright notice and this permission notice appear in all
+ * supporting documentation, and that the name of M.I.T. not be used
+ * in advertising or publicity pertaining to distribution of the
+ * software without specific, written prior permission.  M.I.T. makes
+ * no representations about the suitability of this software for any
+ * purpose.  It is provided "as is" without express or implied
+ * warranty.
+ *
+ * THIS SOFTWARE IS PROVIDED BY M.I.T. ``AS IS''.  M.I.T. DISCLAIMS
+ * ALL EXPRESS OR IMPLIED WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE. IN NO EVENT
+ * SHALL M.I.T. BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * $FreeBSD$
+ */
+
+#ifndef _NET_IF_VLAN_VAR_H_
+#define	_NET_IF_VLAN_VAR_H_	1
+
+#include <sys/types.h>
+
+struct ifnet;
+struct rte_mbuf;
+
+/*
+ * VLAN interfaces.  vlan_create() adds VLAN vid on top of a port's ifnet,
+ * or on top of a VLAN ifnet for QinQ; vlan_destroy() takes it down.  VLAN
+ * ifnets stay allocated until their port is detached, as dataplane lcores
+ * may still hold pointers to them.
+ */
+struct ifnet	*vlan_create(struct ifnet *parent, uint16_t vid);
+void	vlan_destroy(struct ifnet *ifp);
+void	vlan_ifdetach(struct ifnet *ifp);
+
+/*
+ * Input: vlan_input() pops the tags of a frame the NIC did not strip and
+ * demuxes the inner frame; vlan_rcvif() accounts a frame with stripped
+ * tags to its VLAN ifnet, dropping it if there is none.
+ */
+void	vlan_input(struct rte_mbuf *m);
+struct ifnet	*vlan_rcvif(struct rte_mbuf *m);
+
+/*
+ * Put the tags stripped off a received frame back into it.
+ */
+int	vlan_restore(struct rte_mbuf *m);
+
+/*
+ * Output: tag a frame for VLAN ifp and return the port to send it on.
+ */
+struct ifnet	*vlan_encap(struct ifnet *ifp, struct rte_mbuf *m);
+
+#endif /* _NET_IF_VLAN_VAR_H_ */
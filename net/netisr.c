@@ -66,7 +66,14 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_rwlock.h>
+#include <rte_spinlock.h>
 
 #define	_WANT_NETISR_INTERNAL	/* Enable definitions from netisr_internal.h */
 #include "if_var.h"
@@ -79,23 +86,334 @@
  */
 static struct netisr_proto	netisr_proto[NETISR_MAXPROT];
 
+/*
+ * Registration lock; serializes netisr_register() and netisr_unregister()
+ * against each other.  The dataplane does not take it: protocols are
+ * registered before the dataplane lcores are launched.
+ */
+static rte_rwlock_t	netisr_rwlock = RTE_RWLOCK_INITIALIZER;
+#define	NETISR_WLOCK()		rte_rwlock_write_lock(&netisr_rwlock)
+#define	NETISR_WUNLOCK()	rte_rwlock_write_unlock(&netisr_rwlock)
+
+/*
+ * One workstream per lcore, indexed by lcore ID.  Only the slave lcores
+ * running the dataplane take part in deferred dispatch; nws_array lists
+ * their IDs in order so that flow and source IDs can be mapped to them.
+ * Threads that are not EAL lcores share the extra last workstream, which
+ * is never attached: they dispatch directly or queue to the lcores, see
+ * netisr_curcpu().  Its batch state and counters are not theirs alone, so
+ * they take turns on it under netisr_noteal_lock, see netisr_enter(); the
+ * lock is recursive, as a handler may dispatch again.
+ */
+#define	NETISR_CPU_NOTEAL	RTE_MAX_LCORE
+static struct netisr_workstream	netisr_ws[RTE_MAX_LCORE + 1];
+static rte_spinlock_recursive_t	netisr_noteal_lock =
+    RTE_SPINLOCK_RECURSIVE_INITIALIZER;
+static u_int	nws_array[RTE_MAX_LCORE];
+static u_int	nws_count;
+
+/*
+ * Global default dispatch policy, used by protocols that register with
+ * NETISR_DISPATCH_DEFAULT.
+ */
+static u_int	netisr_dispatch_policy = NETISR_DISPATCH_DIRECT;
+
+/*
+ * Largest number of packets dequeued from a workstream at once.
+ */
+#define	NETISR_POLL_BURST	32
+
 #define	NETISR_DEFAULT_MAXQLIMIT	10240
 static u_int	netisr_maxqlimit = NETISR_DEFAULT_MAXQLIMIT;
 
 #define	NETISR_DEFAULT_DEFAULTQLIMIT	256
 static u_int	netisr_defaultqlimit = NETISR_DEFAULT_DEFAULTQLIMIT;
 
+#ifdef NETISR_STATIC_DISPATCH
+/*
+ * With NETISR_STATIC_DISPATCH, handlers for the built-in protocols are bound
+ * at compile time: netisr_static_dispatch() switches on the protocol number
+ * and calls the handler directly, so the compiler can inline it and no
+ * indirect branch (or retpoline thunk) is taken per packet.  Protocols not
+ * listed here still go through np_handler.  netisr_register() checks that a
+ * built-in protocol registers the same handler that is bound here.
+ */
+static netisr_handler_t *
+netisr_static_handler(u_int proto)
+{
+
+	switch (proto) {
+	case NETISR_IP:
+		return (ip_input);
+	case NETISR_ETHER:
+		return (ether_nh_input);
+	case NETISR_ARP:
+		return (arpintr);
+#ifdef INET6
+	case NETISR_IPV6:
+		return (ip6_input);
+#endif
+	default:
+		return (NULL);
+	}
+}
+
+static inline __attribute__((always_inline)) int
+netisr_static_dispatch(u_int proto, struct rte_mbuf *m)
+{
+
+	switch (proto) {
+	case NETISR_IP:
+		ip_input(m);
+		return (1);
+	case NETISR_ETHER:
+		ether_nh_input(m);
+		return (1);
+	case NETISR_ARP:
+		arpintr(m);
+		return (1);
+#ifdef INET6
+	case NETISR_IPV6:
+		ip6_input(m);
+		return (1);
+#endif
+	default:
+		return (0);
+	}
+}
+#endif /* NETISR_STATIC_DISPATCH */
+
+u_int
+netisr_get_cpucount(void)
+{
+
+	return (nws_count);
+}
+
+u_int
+netisr_get_cpuid(u_int cpunumber)
+{
+
+	KASSERT(cpunumber < nws_count, ("%s: %u > %u", __func__, cpunumber,
+	    nws_count));
+
+	return (nws_array[cpunumber]);
+}
+
+/*
+ * Workstream index of the calling thread: its lcore ID, or the shared
+ * NETISR_CPU_NOTEAL slot for threads that are not EAL lcores, whose
+ * rte_lcore_id() is LCORE_ID_ANY.
+ */
+static inline u_int
+netisr_curcpu(void)
+{
+	u_int cpuid;
+
+	cpuid = rte_lcore_id();
+	if (unlikely(cpuid >= RTE_MAX_LCORE))
+		return (NETISR_CPU_NOTEAL);
+	return (cpuid);
+}
+
+/*
+ * Claim the calling thread's workstream for a dispatch or a poll pass,
+ * and let it go after; only the shared NETISR_CPU_NOTEAL one is locked.
+ */
+static inline u_int
+netisr_enter(void)
+{
+	u_int cpuid;
+
+	cpuid = netisr_curcpu();
+	if (unlikely(cpuid == NETISR_CPU_NOTEAL))
+		rte_spinlock_recursive_lock(&netisr_noteal_lock);
+	return (cpuid);
+}
+
+static inline void
+netisr_leave(u_int cpuid)
+{
+
+	if (unlikely(cpuid == NETISR_CPU_NOTEAL))
+		rte_spinlock_recursive_unlock(&netisr_noteal_lock);
+}
+
+/*
+ * The default implementation of flow ID -> CPU ID mapping.
+ *
+ * Non-static so that protocols can use it to map their own work to specific
+ * CPUs in a manner consistent to netisr for affinity purposes.
+ */
+u_int
+netisr_default_flow2cpu(u_int flowid)
+{
+
+	return (nws_array[flowid % nws_count]);
+}
+
+/*
+ * Return the dispatch policy for a protocol, resolving the global default.
+ */
+static inline u_int
+netisr_get_dispatch(struct netisr_proto *npp)
+{
+
+	if (npp->np_dispatch != NETISR_DISPATCH_DEFAULT)
+		return (npp->np_dispatch);
+	return (netisr_dispatch_policy);
+}
+
+/*
+ * Look up the workstream given a packet and source identifier.  Do this by
+ * checking the protocol's policy, and optionally call out to the protocol
+ * for assistance if required.  A NULL return means the protocol freed the
+ * packet while classifying it.
+ */
+static struct rte_mbuf *
+netisr_select_cpuid(struct netisr_proto *npp, u_int dispatch_policy,
+    uintptr_t source, struct rte_mbuf *m, u_int *cpuidp)
+{
+	u_int cpuid;
+
+	switch (npp->np_policy) {
+	case NETISR_POLICY_CPU:
+		m = npp->np_m2cpuid(m, source, cpuidp);
+		if (m == NULL)
+			return (NULL);
+
+		/*
+		 * It's possible for a protocol not to have a good idea about
+		 * where to process a packet, in which case we fall back on
+		 * the netisr code to decide.  In the hybrid case, return the
+		 * current CPU ID, which will force an immediate direct
+		 * dispatch.  In the queued case, fall back on the SOURCE
+		 * policy.
+		 */
+		if (*cpuidp != NETISR_CPUID_NONE)
+			return (m);
+		if (dispatch_policy == NETISR_DISPATCH_HYBRID) {
+			*cpuidp = netisr_curcpu();
+			return (m);
+		}
+		break;
+
+	case NETISR_POLICY_FLOW:
+		if (!(m->ol_flags & PKT_RX_RSS_HASH) &&
+		    npp->np_m2flow != NULL) {
+			m = npp->np_m2flow(m, source);
+			if (m == NULL)
+				return (NULL);
+		}
+		if (m->ol_flags & PKT_RX_RSS_HASH) {
+			*cpuidp = netisr_default_flow2cpu(m->hash.rss);
+			return (m);
+		}
+		/* FALLTHROUGH */
+
+	case NETISR_POLICY_SOURCE:
+		break;
+
+	default:
+		rte_panic("%s: invalid policy %u for %s", __func__,
+		    npp->np_policy, npp->np_name);
+	}
+
+	/*
+	 * Source ordering: without a source identifier keep the work on the
+	 * receiving lcore, otherwise spread sources over the workstreams.
+	 */
+	cpuid = netisr_curcpu();
+	if (source == 0 && (netisr_ws[cpuid].nws_flags & NWS_ATTACHED))
+		*cpuidp = cpuid;
+	else
+		*cpuidp = nws_array[source % nws_count];
+	return (m);
+}
+
+/*
+ * Mark a workstream as having pending work; see netisr_internal.h.
+ */
+void
+netisr_sched_poll(u_int cpuid)
+{
+
+	rte_smp_wmb();
+	netisr_ws[cpuid].nws_sched = 1;
+}
+
+static int
+netisr_queue_workstream(struct netisr_workstream *nwsp,
+    struct netisr_work *npwp, struct rte_mbuf *m)
+{
+	u_int len;
+
+	if (unlikely(rte_ring_enqueue(npwp->nw_ring, m) == -ENOBUFS)) {
+		npwp->nw_qdrops++;
+		rte_pktmbuf_free(m);
+		return (ENOBUFS);
+	}
+	len = rte_ring_count(npwp->nw_ring);
+	if (len > npwp->nw_watermark)
+		npwp->nw_watermark = len;
+	npwp->nw_queued++;
+	netisr_sched_poll(nwsp->nws_cpu);
+	return (0);
+}
+
+static int
+netisr_queue_internal(u_int proto, struct rte_mbuf *m, u_int cpuid)
+{
+	struct netisr_workstream *nwsp;
+	struct netisr_work *npwp;
+
+	KASSERT(cpuid < RTE_MAX_LCORE, ("%s: invalid cpuid %u", __func__,
+	    cpuid));
+
+	nwsp = &netisr_ws[cpuid];
+	npwp = &nwsp->nws_work[proto];
+	KASSERT(npwp->nw_ring != NULL, ("%s: lcore %u is not a netisr CPU",
+	    __func__, cpuid));
+	return (netisr_queue_workstream(nwsp, npwp, m));
+}
+
+int
+netisr_queue_src(u_int proto, uintptr_t source, struct rte_mbuf *m)
+{
+	struct netisr_proto *npp;
+	u_int cpuid;
+
+	KASSERT(proto < NETISR_MAXPROT,
+	    ("%s: invalid proto %u", __func__, proto));
+
+	npp = &netisr_proto[proto];
+	KASSERT(npp->np_handler != NULL, ("%s: invalid proto %u", __func__,
+	    proto));
+
+	m = netisr_select_cpuid(npp, NETISR_DISPATCH_DEFERRED, source, m,
+	    &cpuid);
+	if (m == NULL)
+		return (ENOBUFS);
+	return (netisr_queue_internal(proto, m, cpuid));
+}
+
+int
+netisr_queue(u_int proto, struct rte_mbuf *m)
+{
+
+	return (netisr_queue_src(proto, 0, m));
+}
+
 /*
  * Dispatch a packet for netisr processing; direct dispatch is permitted by
  * calling context.
  */
-int
-netisr_dispatch_src(u_int proto, uintptr_t source, struct rte_mbuf *m)
+static int
+netisr_dispatch_ws(struct netisr_workstream *nwsp, u_int proto,
+    uintptr_t source, struct rte_mbuf *m)
 {
-	struct netisr_workstream *nwsp;
 	struct netisr_proto *npp;
 	struct netisr_work *npwp;
-	int dosignal, error;
 	u_int cpuid, dispatch_policy;
 
 	KASSERT(proto < NETISR_MAXPROT,
@@ -105,8 +423,85 @@ netisr_dispatch_src(u_int proto, uintptr_t source, struct rte_mbuf *m)
 	KASSERT(npp->np_handler != NULL, ("%s: invalid proto %u", __func__,
 	    proto));
 
+	dispatch_policy = netisr_get_dispatch(npp);
+	if (dispatch_policy == NETISR_DISPATCH_DEFERRED)
+		return (netisr_queue_src(proto, source, m));
+
+	/*
+	 * If direct dispatch is forced, then unconditionally dispatch
+	 * without a formal CPU selection.  Borrow the current CPU's stats,
+	 * even if there's no worker on it.
+	 */
+	if (dispatch_policy == NETISR_DISPATCH_DIRECT) {
+		npwp = &nwsp->nws_work[proto];
+		npwp->nw_dispatched++;
+		npwp->nw_handled++;
+		goto direct;
+	}
+
+	KASSERT(dispatch_policy == NETISR_DISPATCH_HYBRID,
+	    ("%s: unknown dispatch policy (%u)", __func__, dispatch_policy));
+
+	/*
+	 * Otherwise, we execute in a hybrid mode where we will try to direct
+	 * dispatch if we're on the right CPU and the netisr worker isn't
+	 * already running.
+	 */
+	m = netisr_select_cpuid(npp, dispatch_policy, source, m, &cpuid);
+	if (m == NULL)
+		return (ENOBUFS);
+	if (cpuid != nwsp->nws_cpu)
+		return (netisr_queue_internal(proto, m, cpuid));
+
+	/*
+	 * The workstream is ours.  Hold its queue for the duration of the
+	 * dispatch, as netisr_process_workstream_proto() does, so a thief
+	 * cannot handle later packets of the protocol meanwhile; if someone
+	 * already holds it, or earlier work is still queued, queue behind
+	 * that to keep ordering.
+	 */
+	npwp = &nwsp->nws_work[proto];
+	if (npwp->nw_ring != NULL) {
+		if (!rte_spinlock_trylock(&npwp->nw_lock))
+			return (netisr_queue_workstream(nwsp, npwp, m));
+		if (!rte_ring_empty(npwp->nw_ring)) {
+			rte_spinlock_unlock(&npwp->nw_lock);
+			return (netisr_queue_workstream(nwsp, npwp, m));
+		}
+	}
+	npwp->nw_hybrid_dispatched++;
+	npwp->nw_handled++;
+	nwsp->nws_drainbits |= 1 << proto;
+#ifdef NETISR_STATIC_DISPATCH
+	if (!netisr_static_dispatch(proto, m))
+		npp->np_handler(m);
+#else
 	npp->np_handler(m);
+#endif
+	if (npwp->nw_ring != NULL)
+		rte_spinlock_unlock(&npwp->nw_lock);
+	return (0);
 
+direct:
+	nwsp->nws_drainbits |= 1 << proto;
+#ifdef NETISR_STATIC_DISPATCH
+	if (netisr_static_dispatch(proto, m))
+		return (0);
+#endif
+	npp->np_handler(m);
+
+	return (0);
+}
+
+int
+netisr_dispatch_src(u_int proto, uintptr_t source, struct rte_mbuf *m)
+{
+	u_int cpuid;
+	int error;
+
+	cpuid = netisr_enter();
+	error = netisr_dispatch_ws(&netisr_ws[cpuid], proto, source, m);
+	netisr_leave(cpuid);
 	return (error);
 }
 
@@ -117,6 +512,334 @@ netisr_dispatch(u_int proto, struct rte_mbuf *m)
 	return (netisr_dispatch_src(proto, 0, m));
 }
 
+/*
+ * Hand a batch of packets to their protocol handlers.
+ */
+static inline void
+netisr_handle_burst(struct netisr_proto *npp, u_int proto,
+    struct rte_mbuf **m, u_int n)
+{
+	u_int i;
+
+	if (npp->np_bhandler != NULL) {
+		npp->np_bhandler(m, n);
+		return;
+	}
+	for (i = 0; i < n; i++) {
+#ifdef NETISR_STATIC_DISPATCH
+		if (netisr_static_dispatch(proto, m[i]))
+			continue;
+#endif
+		npp->np_handler(m[i]);
+	}
+}
+
+/*
+ * End of a batch on the current lcore: run np_drainedcpu once for every
+ * protocol that handled packets here since the last time, so that
+ * protocols can flush buffered transmits, timer and stats updates once per
+ * batch rather than once per packet.  Nested bursts (ether dispatching IP,
+ * say) only flush when the outermost one completes.
+ */
+static void
+netisr_drain(struct netisr_workstream *nwsp)
+{
+	netisr_drainedcpu_t *drainedcpu;
+	u_int bits, proto;
+
+	while ((bits = nwsp->nws_drainbits) != 0) {
+		nwsp->nws_drainbits = 0;
+		while (bits != 0) {
+			proto = __builtin_ctz(bits);
+			bits &= bits - 1;
+			drainedcpu = netisr_proto[proto].np_drainedcpu;
+			if (drainedcpu != NULL)
+				drainedcpu(nwsp->nws_cpu);
+		}
+	}
+}
+
+/*
+ * Dispatch a burst of packets of one protocol.  With direct dispatch the
+ * whole burst goes to the protocol's burst handler, if it registered one,
+ * or to its per-packet handler in turn; otherwise each packet is placed by
+ * policy as netisr_dispatch_src() would.  The end-of-batch callbacks of all
+ * protocols involved run once, when the burst is done.
+ */
+void
+netisr_dispatch_burst(u_int proto, uintptr_t source, struct rte_mbuf **m,
+    u_int n)
+{
+	struct netisr_workstream *nwsp;
+	struct netisr_proto *npp;
+	struct netisr_work *npwp;
+	u_int cpuid, i;
+
+	KASSERT(proto < NETISR_MAXPROT,
+	    ("%s: invalid proto %u", __func__, proto));
+
+	npp = &netisr_proto[proto];
+	KASSERT(npp->np_handler != NULL, ("%s: invalid proto %u", __func__,
+	    proto));
+
+	if (n == 0)
+		return;
+	cpuid = netisr_enter();
+	nwsp = &netisr_ws[cpuid];
+	nwsp->nws_depth++;
+	if (netisr_get_dispatch(npp) == NETISR_DISPATCH_DIRECT) {
+		npwp = &nwsp->nws_work[proto];
+		npwp->nw_dispatched += n;
+		npwp->nw_handled += n;
+		nwsp->nws_drainbits |= 1 << proto;
+		netisr_handle_burst(npp, proto, m, n);
+	} else {
+		for (i = 0; i < n; i++)
+			netisr_dispatch_ws(nwsp, proto, source, m[i]);
+	}
+	if (--nwsp->nws_depth == 0)
+		netisr_drain(nwsp);
+	netisr_leave(cpuid);
+}
+
+/*
+ * Process up to budget packets of one protocol from a workstream on behalf
+ * of lcore cpuid, which is the owner unless the work is being stolen.  The
+ * per-work lock makes the owner and any thief take turns on the queue, so
+ * packets are handled one batch after another in queue order.  The caller
+ * runs the end-of-batch callbacks, see netisr_drain().
+ */
+static u_int
+netisr_process_workstream_proto(struct netisr_workstream *nwsp, u_int proto,
+    u_int budget, u_int cpuid)
+{
+	struct rte_mbuf *pkts[NETISR_POLL_BURST];
+	struct netisr_proto *npp;
+	struct netisr_work *npwp;
+	u_int handled, n;
+
+	npp = &netisr_proto[proto];
+	npwp = &nwsp->nws_work[proto];
+	if (!rte_spinlock_trylock(&npwp->nw_lock)) {
+		/* Someone else holds the queue; look again next pass. */
+		netisr_sched_poll(nwsp->nws_cpu);
+		return (0);
+	}
+	handled = 0;
+	while (handled < budget) {
+		n = RTE_MIN(budget - handled, NETISR_POLL_BURST);
+		n = rte_ring_sc_dequeue_burst(npwp->nw_ring, (void **)pkts, n);
+		if (n == 0)
+			break;
+		netisr_handle_burst(npp, proto, pkts, n);
+		handled += n;
+	}
+	/* Owner and thieves count apart, see struct netisr_work. */
+	if (cpuid == nwsp->nws_cpu)
+		npwp->nw_handled += handled;
+	else
+		npwp->nw_stolen += handled;
+	npwp->nw_len = rte_ring_count(npwp->nw_ring);
+	rte_spinlock_unlock(&npwp->nw_lock);
+
+	if (handled != 0)
+		netisr_ws[cpuid].nws_drainbits |= 1 << proto;
+	return (handled);
+}
+
+/*
+ * Work stealing.  An lcore that found nothing to do on its own workstream
+ * for NETISR_STEAL_IDLE consecutive polls looks for the longest queue of a
+ * stealable protocol on any other workstream and, if it holds at least
+ * netisr_steal_thresh packets, handles up to half of it.  Queues are judged
+ * by their length alone: the owner clears nws_sched as it starts a pass, so
+ * a backlog it cannot keep up with may well sit in an unscheduled one.
+ *
+ * Only NETISR_POLICY_SOURCE protocols are stealable: their queued packets
+ * carry no flow affinity, and as the thief takes the per-work lock and
+ * handles the batch in queue order, source ordering is kept.  FLOW and CPU
+ * placement is a promise about where work runs, so it is never moved.
+ */
+#define	NETISR_STEAL_IDLE	8
+static u_int	netisr_steal_thresh = 2 * NETISR_POLL_BURST;
+static u_int	netisr_steal_protos;	/* Bitmask of stealable protocols. */
+
+static u_int
+netisr_steal(struct netisr_workstream *thief, u_int budget)
+{
+	struct netisr_workstream *nwsp, *victim;
+	u_int i, len, maxlen, proto, vproto;
+
+	victim = NULL;
+	vproto = 0;
+	maxlen = 0;
+	for (i = 0; i < nws_count; i++) {
+		nwsp = &netisr_ws[nws_array[i]];
+		if (nwsp == thief)
+			continue;
+		for (proto = 0; proto < NETISR_MAXPROT; proto++) {
+			if (!(netisr_steal_protos & (1 << proto)))
+				continue;
+			len = rte_ring_count(nwsp->nws_work[proto].nw_ring);
+			if (len > maxlen) {
+				maxlen = len;
+				victim = nwsp;
+				vproto = proto;
+			}
+		}
+	}
+	if (victim == NULL || maxlen < netisr_steal_thresh)
+		return (0);
+	return (netisr_process_workstream_proto(victim, vproto,
+	    RTE_MIN(budget, maxlen / 2), thief->nws_cpu));
+}
+
+/*
+ * Drain deferred work queued on the current lcore's workstream, handling at
+ * most budget packets so that the caller's other duties (NIC RX, mostly)
+ * keep a bounded latency.  Protocols are visited round-robin, starting
+ * after the one the previous pass stopped at, so a busy protocol cannot
+ * starve the others.  An lcore that stays idle helps out busier ones, see
+ * netisr_steal().  The pass ends a batch: np_drainedcpu runs for every
+ * protocol that handled packets on this lcore since the last batch ended,
+ * including packets dispatched directly outside of a burst.  Returns the
+ * number of packets handled.
+ */
+static u_int
+netisr_poll_ws(struct netisr_workstream *nwsp, u_int cpuid, u_int budget)
+{
+	u_int handled, i, proto;
+
+	if (nwsp->nws_sched == 0) {
+		handled = 0;
+		if (netisr_steal_protos != 0 &&
+		    ++nwsp->nws_idle >= NETISR_STEAL_IDLE) {
+			nwsp->nws_idle = 0;
+			handled = netisr_steal(nwsp, budget);
+		}
+		if (nwsp->nws_drainbits != 0)
+			netisr_drain(nwsp);
+		return (handled);
+	}
+	nwsp->nws_idle = 0;
+	nwsp->nws_sched = 0;
+	rte_smp_mb();
+
+	nwsp->nws_flags |= NWS_RUNNING;
+	handled = 0;
+	proto = nwsp->nws_lastproto;
+	for (i = 0; i < NETISR_MAXPROT && handled < budget; i++) {
+		proto = (proto + 1) % NETISR_MAXPROT;
+		if (nwsp->nws_work[proto].nw_ring == NULL ||
+		    netisr_proto[proto].np_handler == NULL)
+			continue;
+		handled += netisr_process_workstream_proto(nwsp, proto,
+		    budget - handled, cpuid);
+	}
+	nwsp->nws_lastproto = proto;
+	nwsp->nws_flags &= ~NWS_RUNNING;
+	netisr_drain(nwsp);
+
+	if (handled >= budget)
+		netisr_pollmore();
+	return (handled);
+}
+
+u_int
+netisr_poll(u_int budget)
+{
+	u_int cpuid, handled;
+
+	cpuid = netisr_enter();
+	handled = netisr_poll_ws(&netisr_ws[cpuid], cpuid, budget);
+	netisr_leave(cpuid);
+	return (handled);
+}
+
+/*
+ * Report whether the current lcore's workstream still holds work, and if
+ * so make sure the next netisr_poll() pass looks at it.
+ */
+int
+netisr_pollmore(void)
+{
+	struct netisr_workstream *nwsp;
+	u_int cpuid, proto;
+	int more;
+
+	cpuid = netisr_enter();
+	nwsp = &netisr_ws[cpuid];
+	more = 0;
+	for (proto = 0; proto < NETISR_MAXPROT; proto++) {
+		if (nwsp->nws_work[proto].nw_ring == NULL ||
+		    rte_ring_empty(nwsp->nws_work[proto].nw_ring))
+			continue;
+		nwsp->nws_sched = 1;
+		more = 1;
+		break;
+	}
+	netisr_leave(cpuid);
+	return (more);
+}
+
+static void
+netisr_work_init(u_int cpuid, u_int proto)
+{
+	struct netisr_work *npwp;
+	char name[RTE_RING_NAMESIZE];
+
+	npwp = &netisr_ws[cpuid].nws_work[proto];
+	rte_spinlock_init(&npwp->nw_lock);
+	snprintf(name, sizeof(name), "netisr_%u_%u", cpuid, proto);
+	npwp->nw_qlimit = netisr_proto[proto].np_qlimit;
+	npwp->nw_ring = rte_ring_create(name,
+	    rte_align32pow2(npwp->nw_qlimit + 1),
+	    rte_lcore_to_socket_id(cpuid), RING_F_SC_DEQ);
+	if (npwp->nw_ring == NULL)
+		rte_panic("%s: cannot create ring %s\n", __func__, name);
+}
+
+static void
+netisr_work_fini(u_int cpuid, u_int proto)
+{
+	struct netisr_work *npwp;
+	struct rte_mbuf *m;
+
+	npwp = &netisr_ws[cpuid].nws_work[proto];
+	if (npwp->nw_ring == NULL)
+		return;
+	while (rte_ring_sc_dequeue(npwp->nw_ring, (void **)&m) == 0)
+		rte_pktmbuf_free(m);
+	rte_ring_free(npwp->nw_ring);
+	memset(npwp, 0, sizeof(*npwp));
+}
+
+/*
+ * Attach the dataplane (slave) lcores as netisr workstreams.  Must be
+ * called after rte_eal_init() and before any protocol registers.
+ */
+void
+netisr_init(void)
+{
+	u_int cpuid;
+
+	KASSERT(nws_count == 0, ("%s: already initialized", __func__));
+
+	for (cpuid = 0; cpuid <= NETISR_CPU_NOTEAL; cpuid++)
+		netisr_ws[cpuid].nws_cpu = cpuid;
+
+	RTE_LCORE_FOREACH_SLAVE(cpuid) {
+		netisr_ws[cpuid].nws_flags = NWS_ATTACHED;
+		nws_array[nws_count++] = cpuid;
+	}
+	if (nws_count == 0) {
+		/* No slaves: everything runs on the master lcore. */
+		cpuid = rte_get_master_lcore();
+		netisr_ws[cpuid].nws_flags = NWS_ATTACHED;
+		nws_array[nws_count++] = cpuid;
+	}
+}
+
 /*
  * Register a new netisr handler, which requires initializing per-protocol
  * fields for each workstream.  All netisr work is briefly suspended while
@@ -161,6 +884,12 @@ netisr_register(const struct netisr_handler *nhp)
 
 	KASSERT(proto < NETISR_MAXPROT,
 	    ("%s(%u, %s): protocol too big", __func__, proto, name));
+#ifdef NETISR_STATIC_DISPATCH
+	KASSERT(netisr_static_handler(proto) == NULL ||
+	    netisr_static_handler(proto) == nhp->nh_handler,
+	    ("%s(%u, %s): handler differs from static binding", __func__,
+	    proto, name));
+#endif
 
 	/*
 	 * Test that no existing registration exists for this protocol.
@@ -173,6 +902,7 @@ netisr_register(const struct netisr_handler *nhp)
 
 	netisr_proto[proto].np_name = name;
 	netisr_proto[proto].np_handler = nhp->nh_handler;
+	netisr_proto[proto].np_bhandler = nhp->nh_bhandler;
 	netisr_proto[proto].np_m2flow = nhp->nh_m2flow;
 	netisr_proto[proto].np_m2cpuid = nhp->nh_m2cpuid;
 	netisr_proto[proto].np_drainedcpu = nhp->nh_drainedcpu;
@@ -188,6 +918,11 @@ netisr_register(const struct netisr_handler *nhp)
 		netisr_proto[proto].np_qlimit = nhp->nh_qlimit;
 	netisr_proto[proto].np_policy = nhp->nh_policy;
 	netisr_proto[proto].np_dispatch = nhp->nh_dispatch;
+	for (i = 0; i < nws_count; i++)
+		netisr_work_init(nws_array[i], proto);
+	if (nhp->nh_policy == NETISR_POLICY_SOURCE && nws_count > 1)
+		netisr_steal_protos |= 1 << proto;
+	NETISR_WUNLOCK();
 }
 
 /*
@@ -213,11 +948,17 @@ netisr_unregister(const struct netisr_handler *nhp)
 	    ("%s(%u): protocol not registered for %s", __func__, proto,
 	    name));
 
-
+	netisr_steal_protos &= ~(1 << proto);
 	netisr_proto[proto].np_name = NULL;
 	netisr_proto[proto].np_handler = NULL;
+	netisr_proto[proto].np_bhandler = NULL;
 	netisr_proto[proto].np_m2flow = NULL;
 	netisr_proto[proto].np_m2cpuid = NULL;
+	netisr_proto[proto].np_drainedcpu = NULL;
 	netisr_proto[proto].np_qlimit = 0;
 	netisr_proto[proto].np_policy = 0;
+	netisr_proto[proto].np_dispatch = 0;
+	for (i = 0; i < nws_count; i++)
+		netisr_work_fini(nws_array[i], proto);
+	NETISR_WUNLOCK();
 }
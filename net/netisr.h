@@ -138,8 +138,9 @@ struct sysctl_netisr_work {
 	uint64_t	snw_qdrops;		/* nw_qdrops */
 	uint64_t	snw_queued;		/* nw_queued */
 	uint64_t	snw_handled;		/* nw_handled */
+	uint64_t	snw_stolen;		/* nw_stolen */
 
-	uint64_t	_snw_llspare[7];
+	uint64_t	_snw_llspare[6];
 };
 
 
@@ -171,12 +172,19 @@ struct sysctl_netisr_work {
  * calculate a flow.  Both protocol handlers may return a new mbuf pointer
  * for the chain, or NULL if the packet proves invalid or m_pullup() fails.
  *
+ * A protocol may also supply nh_bhandler to take whole bursts at a time,
+ * and nh_drainedcpu, which netisr calls on an lcore once at the end of each
+ * batch (a netisr_dispatch_burst() or a netisr_poll() pass) in which the
+ * protocol handled packets there.  That is the place to flush transmit
+ * buffers and commit per-batch state.
+ *
  * XXXRW: If we eventually support dynamic reconfiguration, there should be
  * protocol handlers to notify them of CPU configuration changes so that they
  * can rebalance work.
  */
 struct rte_mbuf;
 typedef void		 netisr_handler_t(struct rte_mbuf *m);
+typedef void		 netisr_bhandler_t(struct rte_mbuf **m, u_int n);
 typedef struct rte_mbuf	*netisr_m2cpuid_t(struct rte_mbuf *m, uintptr_t source,
 			 u_int *cpuid);
 typedef	struct rte_mbuf	*netisr_m2flow_t(struct rte_mbuf *m, uintptr_t source);
@@ -190,17 +198,30 @@ typedef void		 netisr_drainedcpu_t(u_int cpuid);
 struct netisr_handler {
 	const char	*nh_name;	/* Character string protocol name. */
 	netisr_handler_t *nh_handler;	/* Protocol handler. */
+	netisr_bhandler_t *nh_bhandler;	/* Optional burst handler. */
 	netisr_m2flow_t	*nh_m2flow;	/* Query flow for untagged packet. */
 	netisr_m2cpuid_t *nh_m2cpuid;	/* Query CPU to process mbuf on. */
-	netisr_drainedcpu_t *nh_drainedcpu; /* Callback when drained a queue. */
+	netisr_drainedcpu_t *nh_drainedcpu; /* End-of-batch callback. */
 	u_int		 nh_proto;	/* Integer protocol ID. */
 	u_int		 nh_qlimit;	/* Maximum per-CPU queue depth. */
 	u_int		 nh_policy;	/* Work placement policy. */
 	u_int		 nh_dispatch;	/* Dispatch policy. */
 	u_int		 nh_ispare[4];	/* For future use. */
-	void		*nh_pspare[4];	/* For future use. */
+	void		*nh_pspare[3];	/* For future use. */
 };
 
+#ifdef NETISR_STATIC_DISPATCH
+/*
+ * Handlers of built-in protocols, bound at compile time by netisr.c.
+ */
+netisr_handler_t	ip_input;
+netisr_handler_t	ether_nh_input;
+netisr_handler_t	arpintr;
+#ifdef INET6
+netisr_handler_t	ip6_input;
+#endif
+#endif
+
 /*
  * Register, unregister, and other netisr handler management functions.
  */
@@ -223,6 +244,8 @@ void	netisr_unregister_vnet(const struct netisr_handler *nhp);
  */
 int	netisr_dispatch(u_int proto, struct rte_mbuf *m);
 int	netisr_dispatch_src(u_int proto, uintptr_t source, struct rte_mbuf *m);
+void	netisr_dispatch_burst(u_int proto, uintptr_t source,
+	    struct rte_mbuf **m, u_int n);
 int	netisr_queue(u_int proto, struct rte_mbuf *m);
 int	netisr_queue_src(u_int proto, uintptr_t source, struct rte_mbuf *m);
 
@@ -240,10 +263,18 @@ u_int	netisr_get_cpucount(void);
 u_int	netisr_get_cpuid(u_int cpunumber);
 
 /*
- * Interfaces between DEVICE_POLLING and netisr.
+ * Attach the dataplane lcores as workstreams; called once after EAL init.
+ */
+void	netisr_init(void);
+
+/*
+ * Polling-mode service of deferred work.  Each dataplane lcore calls
+ * netisr_poll() from its main loop to handle at most budget queued packets;
+ * netisr_pollmore() reports whether work remains.  netisr_sched_poll()
+ * flags a workstream as having queued work.
  */
-void	netisr_sched_poll(void);
-void	netisr_poll(void);
-void	netisr_pollmore(void);
+void	netisr_sched_poll(u_int cpuid);
+u_int	netisr_poll(u_int budget);
+int	netisr_pollmore(void);
 
 #endif /* !_NET_NETISR_H_ */
@@ -52,9 +52,10 @@
 struct netisr_proto {
 	const char	*np_name;	/* Character string protocol name. */
 	netisr_handler_t *np_handler;	/* Protocol handler. */
+	netisr_bhandler_t *np_bhandler;	/* Optional burst handler. */
 	netisr_m2flow_t	*np_m2flow;	/* Query flow for untagged packet. */
 	netisr_m2cpuid_t *np_m2cpuid;	/* Query CPU to process packet on. */
-	netisr_drainedcpu_t *np_drainedcpu; /* Callback when drained a queue. */
+	netisr_drainedcpu_t *np_drainedcpu; /* End-of-batch callback. */
 	u_int		 np_qlimit;	/* Maximum per-CPU queue depth. */
 	u_int		 np_policy;	/* Work placement policy. */
 	u_int		 np_dispatch;	/* Work dispatch policy. */
@@ -69,29 +70,57 @@ struct netisr_proto {
  */
 struct netisr_work {
 	/*
-	 * Packet queue, linked by m_nextpkt.
+	 * Packet queue.  rte_mbuf has no m_nextpkt, so this is a ring:
+	 * multi-producer, as any lcore may queue work here, and drained by
+	 * one lcore at a time under nw_lock (the owner, or a thief).
 	 */
-	struct rte_mbuf	*nw_head;
-	struct rte_mbuf	*nw_tail;
+	struct rte_ring	*nw_ring;
+	rte_spinlock_t	 nw_lock;	/* Held while draining. */
 	u_int		 nw_len;
 	u_int		 nw_qlimit;
 	u_int		 nw_watermark;
 
 	/*
-	 * Statistics -- written unlocked, but mostly from curcpu.
+	 * Statistics -- written unlocked, but mostly from curcpu.  Packets
+	 * handled by the owner and by thieves are counted apart, so that
+	 * each counter has a single writer at a time: nw_handled the owner,
+	 * nw_stolen whichever thief holds nw_lock.  Their sum is the number
+	 * of packets handled.
 	 */
 	u_int64_t	 nw_dispatched; /* Number of direct dispatches. */
 	u_int64_t	 nw_hybrid_dispatched; /* "" hybrid dispatches. */
 	u_int64_t	 nw_qdrops;	/* "" drops. */
 	u_int64_t	 nw_queued;	/* "" enqueues. */
-	u_int64_t	 nw_handled;	/* "" handled in worker. */
+	u_int64_t	 nw_handled;	/* "" handled by the owner. */
+	u_int64_t	 nw_stolen;	/* "" handled by another lcore. */
 };
 
+/*
+ * Workstreams hold the queued work for one lcore, one netisr_work per
+ * protocol.  Unlike the kernel there is no SWI thread: the owning lcore
+ * drains its workstream from its main loop with netisr_poll().
+ *
+ * nws_sched is set by whichever lcore queues work here and cleared by the
+ * owner before each poll pass, so an idle lcore does not scan its rings.
+ */
+struct netisr_workstream {
+	u_int		 nws_cpu;	/* lcore ID. */
+	u_int		 nws_flags;	/* NWS_* flags. */
+	volatile u_int	 nws_sched;	/* Work queued since last poll. */
+	u_int		 nws_lastproto;	/* Where the last pass stopped. */
+	u_int		 nws_idle;	/* Consecutive idle polls. */
+	u_int		 nws_drainbits;	/* Protocols run in this batch. */
+	u_int		 nws_depth;	/* netisr_dispatch_burst() nesting. */
+
+	struct netisr_work	nws_work[NETISR_MAXPROT];
+} __rte_cache_aligned;
+
 /*
  * Per-workstream flags.
  */
 #define	NWS_RUNNING	0x00000001	/* Currently running in a thread. */
 #define	NWS_DISPATCHING	0x00000002	/* Currently being direct-dispatched. */
 #define	NWS_SCHEDULED	0x00000004	/* Signal issued. */
+#define	NWS_ATTACHED	0x00000008	/* Lcore takes deferred work. */
 
 #endif /* !_NET_NETISR_INTERNAL_H_ */
@@ -0,0 +1,66 @@
+#ifndef _NET_PCPUSTAT_H_
+#define	_NET_PCPUSTAT_H_
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <rte_common.h>
+#include <rte_lcore.h>
+
+/*
+ * Per-lcore statistics, the counterpart of the kernel's VNET_PCPUSTAT.
+ *
+ * A statistics structure, made of uint64_t counters only, is instantiated
+ * once per lcore on cache lines of its own, plus one copy shared by
+ * threads that are not EAL lcores, as for the ifnet counters.  Updates
+ * are plain increments of the caller's copy: no atomics, no line
+ * bouncing between lcores.  Readers sum the copies with PCPUSTAT_FETCH(),
+ * which may see a counter a few updates behind.
+ */
+#define	PCPUSTAT_DECLARE(type, name)					\
+	struct name##_pcpu {						\
+		type	ps_stat;					\
+	} __rte_cache_aligned;						\
+	extern struct name##_pcpu	name##_pcpu[RTE_MAX_LCORE + 1]
+
+#define	PCPUSTAT_DEFINE(type, name)					\
+	struct name##_pcpu	name##_pcpu[RTE_MAX_LCORE + 1]
+
+#define	PCPUSTAT_ADD(name, f, v)					\
+	(name##_pcpu[pcpustat_slot()].ps_stat.f += (v))
+
+#define	PCPUSTAT_FETCH(type, name, dst)					\
+	pcpustat_fetch(&name##_pcpu[0].ps_stat, sizeof(name##_pcpu[0]),	\
+	    sizeof(type) / sizeof(uint64_t), (uint64_t *)(dst))
+
+#define	PCPUSTAT_RESET(name)						\
+	memset(name##_pcpu, 0, sizeof(name##_pcpu))
+
+static inline unsigned
+pcpustat_slot(void)
+{
+	unsigned lcore;
+
+	lcore = rte_lcore_id();
+	if (unlikely(lcore >= RTE_MAX_LCORE))
+		lcore = RTE_MAX_LCORE;
+	return (lcore);
+}
+
+static inline void
+pcpustat_fetch(const void *base, size_t stride, size_t n, uint64_t *dst)
+{
+	const uint64_t *src;
+	size_t i;
+	u_int c;
+
+	memset(dst, 0, n * sizeof(*dst));
+	for (c = 0; c <= RTE_MAX_LCORE; c++) {
+		src = (const uint64_t *)((const char *)base + c * stride);
+		for (i = 0; i < n; i++)
+			dst[i] += src[i];
+	}
+}
+
+#endif /* _NET_PCPUSTAT_H_ */
@@ -0,0 +1,176 @@
+/*-
+ * Copyright (c) 1982, 1986, 1989, 1993
+ *	The Regents of the University of California.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	@(#)in.c	8.4 (Berkeley) 1/9/95
+ * $FreeBSD$
+ */
+
+/*
+ * Local IPv4 addresses: those of this host, which core/kip_monitor.c
+ * mirrors from the kernel, and those of the virtual services, which
+ * ip_input() delivers rather than forwards.  They are in a hash the
+ * dataplane looks up without locking, in one probe; the control lcore is
+ * the only writer, and removed entries go through epoch_call().
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_atomic.h>
+#include <rte_hash_crc.h>
+#include <rte_malloc.h>
+
+#include "net/epoch.h"
+#include "ip_var.h"
+
+#define	IN_LOCAL_HASHSIZE	256	/* a power of 2 */
+
+struct in_local {
+	struct in_local	*il_next;
+	struct in_addr	il_addr;
+	int		il_type;
+	uint32_t	il_gen;		/* see in_local_mark() */
+	struct epoch_context il_epoch;
+};
+
+static struct in_local	*in_local_hash[IN_LOCAL_HASHSIZE];
+static uint32_t	in_local_gen;
+
+static inline struct in_local **
+in_local_bucket(struct in_addr addr)
+{
+
+	return (&in_local_hash[rte_hash_crc_4byte(addr.s_addr, 0) &
+	    (IN_LOCAL_HASHSIZE - 1)]);
+}
+
+/*
+ * The link that points to the entry for addr, or ends its chain.
+ */
+static struct in_local **
+in_findlocal(struct in_addr addr)
+{
+	struct in_local **prev;
+
+	for (prev = in_local_bucket(addr); *prev != NULL;
+	    prev = &(*prev)->il_next)
+		if ((*prev)->il_addr.s_addr == addr.s_addr)
+			break;
+	return (prev);
+}
+
+int
+in_addlocal(struct in_addr addr, int type)
+{
+	struct in_local **prev, *il;
+
+	if (type != IN_ADDR_LOCAL && type != IN_ADDR_VIP)
+		return (EINVAL);
+	prev = in_findlocal(addr);
+	if (*prev != NULL) {
+		if ((*prev)->il_type == type)
+			(*prev)->il_gen = in_local_gen;
+		return (EEXIST);
+	}
+	il = rte_zmalloc("in_local", sizeof(*il), 0);
+	if (il == NULL)
+		return (ENOMEM);
+	il->il_addr = addr;
+	il->il_type = type;
+	il->il_gen = in_local_gen;
+	rte_smp_wmb();
+	*prev = il;
+	return (0);
+}
+
+static void
+in_local_free(struct epoch_context *ctx)
+{
+
+	rte_free(epoch_containerof(ctx, struct in_local, il_epoch));
+}
+
+/*
+ * Remove addr if it is of the given type: a virtual service address the
+ * kernel also had stays when the kernel drops it.
+ */
+int
+in_dellocal(struct in_addr addr, int type)
+{
+	struct in_local **prev, *il;
+
+	prev = in_findlocal(addr);
+	il = *prev;
+	if (il == NULL || il->il_type != type)
+		return (ENOENT);
+	*prev = il->il_next;
+	epoch_call(&il->il_epoch, in_local_free);
+	return (0);
+}
+
+/*
+ * Resynchronization with the kernel: the addresses of this host not added
+ * again between in_local_mark() and in_local_sweep() go.  Virtual service
+ * addresses stay.
+ */
+void
+in_local_mark(void)
+{
+
+	in_local_gen++;
+}
+
+void
+in_local_sweep(void)
+{
+	struct in_local **prev, *il;
+	u_int i;
+
+	for (i = 0; i < IN_LOCAL_HASHSIZE; i++) {
+		prev = &in_local_hash[i];
+		while ((il = *prev) != NULL) {
+			if (il->il_type == IN_ADDR_LOCAL &&
+			    il->il_gen != in_local_gen) {
+				*prev = il->il_next;
+				epoch_call(&il->il_epoch, in_local_free);
+			} else
+				prev = &il->il_next;
+		}
+	}
+}
+
+int
+in_addrtype(struct in_addr addr)
+{
+	const struct in_local *il;
+
+	for (il = *in_local_bucket(addr); il != NULL; il = il->il_next)
+		if (il->il_addr.s_addr == addr.s_addr)
+			return (il->il_type);
+	return (IN_ADDR_NONE);
+}
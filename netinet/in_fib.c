@@ -0,0 +1,759 @@
+/*
+ * IPv4 forwarding table, see in_fib.h.
+ *
+ * A tbl24 entry, indexed by the first 24 bits of an address, holds a next
+ * hop index and the length of the prefix that set it, or points to a
+ * group of 256 tbl8 entries, indexed by the last 8 bits, for a /24 that
+ * longer prefixes cut up.  The entries of a group that no prefix longer
+ * than /24 set hold what the tbl24 entry would.
+ *
+ * rte_lpm has the same layout, but its rules sit in an array per prefix
+ * length that every update searches linearly, which a full BGP table
+ * makes far too slow.  Here the rules are in a hash only the control
+ * lcore uses, and the prefix an entry falls back to when its own goes is
+ * found with one probe per shorter prefix length in use.  The default
+ * route is kept aside, as what a lookup finds when nothing else matches.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
+
+#include "net/epoch.h"
+#include "in_fib.h"
+
+#define RTE_LOGTYPE_FIB RTE_LOGTYPE_USER1
+
+#define	FIB4_VALID		0x80000000
+#define	FIB4_EXT		0x40000000	/* tbl24: to a tbl8 group */
+#define	FIB4_PLEN_SHIFT		24
+#define	FIB4_PLEN_MASK		0x3f000000
+#define	FIB4_NH_MASK		0x00ffffff
+
+#define	FIB4_ENTRY(plen, nh)	(FIB4_VALID | (plen) << FIB4_PLEN_SHIFT | (nh))
+#define	FIB4_PLEN(e)		(((e) & FIB4_PLEN_MASK) >> FIB4_PLEN_SHIFT)
+
+#define	FIB4_TBL24_SIZE		(1 << 24)
+#define	FIB4_TBL8_SIZE		256
+#define	FIB4_BULK		32
+
+struct fib4_table {
+	uint32_t	*ft_tbl24;
+	uint32_t	*ft_tbl8;
+};
+
+struct fib4_key {
+	uint32_t	fk_addr;	/* masked, host order */
+	uint32_t	fk_plen;
+};
+
+/*
+ * The kernel may have several routes to a prefix, told apart by their
+ * metric or, with the same metric, their next hop.  Those of a prefix are
+ * listed in fib4_routes[] by metric, those with the same in the order they
+ * came, and the first is the one in use, as in the kernel; fib4_rules
+ * maps a prefix to the first.
+ */
+struct fib4_route {
+	uint32_t	fr_nh;
+	uint32_t	fr_metric;
+	uint32_t	fr_gen;		/* that last added it, see fib4_mark() */
+	uint32_t	fr_next;	/* FIB4_NONE at the end */
+};
+
+struct fib4_tbl8g {
+	struct epoch_context tg_epoch;
+};
+
+/* Next hops are found by what they are in fib4_nhopidx. */
+struct nhop4_key {
+	struct ifnet	*nk_ifp;
+	struct in_addr	nk_gw;
+	uint32_t	nk_pad;
+};
+
+struct nhop4	fib4_nhops[FIB4_MAX_NHOPS];
+static volatile uint32_t	fib4_default = FIB4_NONE;
+
+static struct fib4_table	fib4_tables[RTE_MAX_NUMA_NODES];
+
+/*
+ * Control lcore only.
+ */
+static struct rte_hash	*fib4_rules;
+static struct rte_hash	*fib4_nhopidx;
+static uint32_t	fib4_nhop_free[FIB4_MAX_NHOPS];
+static uint32_t	fib4_nnhop_free;
+static uint32_t	fib4_nrules[33];	/* per prefix length */
+static uint32_t	fib4_gen;		/* see fib4_mark() */
+static struct fib4_route	*fib4_routes;
+static uint32_t	fib4_route_free;	/* chained through fr_next */
+static uint32_t	fib4_default_head = FIB4_NONE;
+static uint32_t	fib4_tbl8_free[FIB4_TBL8_GROUPS];
+static uint32_t	fib4_ntbl8_free;
+static struct fib4_tbl8g	fib4_tbl8g[FIB4_TBL8_GROUPS];
+
+static inline const struct fib4_table *
+fib4_local(void)
+{
+	unsigned socket;
+
+	socket = rte_socket_id();
+	if (unlikely(socket >= RTE_MAX_NUMA_NODES))
+		socket = 0;
+	return (&fib4_tables[socket]);
+}
+
+static inline uint32_t
+fib4_mask(uint32_t plen)
+{
+
+	return (plen == 0 ? 0 : ~0U << (32 - plen));
+}
+
+int
+fib4_init(void)
+{
+	struct rte_hash_parameters params;
+	struct fib4_table *t;
+	unsigned lcore, socket;
+	uint32_t i;
+
+	RTE_BUILD_BUG_ON(sizeof(uintptr_t) < sizeof(uint64_t));
+
+	memset(&params, 0, sizeof(params));
+	params.name = "fib4_rules";
+	params.entries = FIB4_MAX_RULES;
+	params.key_len = sizeof(struct fib4_key);
+	params.hash_func = rte_hash_crc;
+	params.socket_id = rte_socket_id();
+	fib4_rules = rte_hash_create(&params);
+	if (fib4_rules == NULL)
+		return (ENOMEM);
+	params.name = "fib4_nhops";
+	params.entries = FIB4_MAX_NHOPS;
+	params.key_len = sizeof(struct nhop4_key);
+	fib4_nhopidx = rte_hash_create(&params);
+	if (fib4_nhopidx == NULL)
+		return (ENOMEM);
+	fib4_routes = rte_malloc("fib4_routes",
+	    FIB4_MAX_RULES * sizeof(*fib4_routes), 0);
+	if (fib4_routes == NULL)
+		return (ENOMEM);
+
+	RTE_LCORE_FOREACH(lcore) {
+		socket = rte_lcore_to_socket_id(lcore);
+		t = &fib4_tables[socket];
+		if (t->ft_tbl24 != NULL)
+			continue;
+		t->ft_tbl24 = rte_zmalloc_socket("fib4_tbl24",
+		    FIB4_TBL24_SIZE * sizeof(uint32_t), RTE_CACHE_LINE_SIZE,
+		    socket);
+		t->ft_tbl8 = rte_zmalloc_socket("fib4_tbl8",
+		    FIB4_TBL8_GROUPS * FIB4_TBL8_SIZE * sizeof(uint32_t),
+		    RTE_CACHE_LINE_SIZE, socket);
+		if (t->ft_tbl24 == NULL || t->ft_tbl8 == NULL) {
+			RTE_LOG(ERR, FIB, "%s: cannot allocate table on "
+			    "socket %u\n", __func__, socket);
+			return (ENOMEM);
+		}
+	}
+
+	for (i = 0; i < FIB4_TBL8_GROUPS; i++)
+		fib4_tbl8_free[i] = FIB4_TBL8_GROUPS - 1 - i;
+	fib4_ntbl8_free = FIB4_TBL8_GROUPS;
+	for (i = 0; i < FIB4_MAX_NHOPS; i++)
+		fib4_nhop_free[i] = FIB4_MAX_NHOPS - 1 - i;
+	fib4_nnhop_free = FIB4_MAX_NHOPS;
+	for (i = 0; i < FIB4_MAX_RULES - 1; i++)
+		fib4_routes[i].fr_next = i + 1;
+	fib4_routes[i].fr_next = FIB4_NONE;
+	fib4_route_free = 0;
+	return (0);
+}
+
+uint32_t
+fib4_lookup(struct in_addr dst)
+{
+	const struct fib4_table *t;
+	uint32_t ip, e;
+
+	t = fib4_local();
+	if (unlikely(t->ft_tbl24 == NULL))
+		return (FIB4_NONE);
+	ip = rte_be_to_cpu_32(dst.s_addr);
+	e = t->ft_tbl24[ip >> 8];
+	if (unlikely(e & FIB4_EXT))
+		e = t->ft_tbl8[(e & FIB4_NH_MASK) * FIB4_TBL8_SIZE +
+		    (ip & 0xff)];
+	return (e & FIB4_VALID ? e & FIB4_NH_MASK : fib4_default);
+}
+
+/*
+ * The tbl24 entries of a burst are prefetched all at once, then looked
+ * at, so that their cache misses overlap.
+ */
+void
+fib4_lookup_bulk(const struct in_addr *dst, u_int n, uint32_t *nh)
+{
+	const struct fib4_table *t;
+	uint32_t ip[FIB4_BULK];
+	uint32_t e, def;
+	u_int i, j, k;
+
+	t = fib4_local();
+	def = fib4_default;
+	if (unlikely(t->ft_tbl24 == NULL)) {
+		for (i = 0; i < n; i++)
+			nh[i] = FIB4_NONE;
+		return;
+	}
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, FIB4_BULK);
+		for (j = 0; j < k; j++) {
+			ip[j] = rte_be_to_cpu_32(dst[i + j].s_addr);
+			rte_prefetch0(&t->ft_tbl24[ip[j] >> 8]);
+		}
+		for (j = 0; j < k; j++) {
+			e = t->ft_tbl24[ip[j] >> 8];
+			if (unlikely(e & FIB4_EXT))
+				e = t->ft_tbl8[(e & FIB4_NH_MASK) *
+				    FIB4_TBL8_SIZE + (ip[j] & 0xff)];
+			nh[i + j] = e & FIB4_VALID ? e & FIB4_NH_MASK : def;
+		}
+	}
+}
+
+static inline void
+nhop4_key(struct nhop4_key *key, struct in_addr gw, struct ifnet *ifp)
+{
+
+	memset(key, 0, sizeof(*key));
+	key->nk_ifp = ifp;
+	key->nk_gw = gw;
+}
+
+/*
+ * Take a reference on the next hop through gw on ifp, allocating it if
+ * need be; FIB4_NONE if the next hop table is full.
+ */
+static uint32_t
+nhop4_get(struct in_addr gw, struct ifnet *ifp)
+{
+	struct nhop4_key key;
+	struct nhop4 *nh;
+	uint32_t slot;
+	void *data;
+
+	nhop4_key(&key, gw, ifp);
+	if (rte_hash_lookup_data(fib4_nhopidx, &key, &data) >= 0) {
+		slot = (uint32_t)(uintptr_t)data;
+		fib4_nhops[slot].nh_refs++;
+		return (slot);
+	}
+	if (fib4_nnhop_free == 0)
+		return (FIB4_NONE);
+	slot = fib4_nhop_free[fib4_nnhop_free - 1];
+	if (rte_hash_add_key_data(fib4_nhopidx, &key,
+	    (void *)(uintptr_t)slot) < 0)
+		return (FIB4_NONE);
+	fib4_nnhop_free--;
+	nh = &fib4_nhops[slot];
+	nh->nh_gw = gw;
+	nh->nh_ifp = ifp;
+	nh->nh_refs = 1;
+	return (slot);
+}
+
+static void nhop4_free(struct epoch_context *ctx);
+
+/*
+ * Start a grace period for a next hop no route uses any more.
+ */
+static void
+nhop4_wait(struct nhop4 *nh)
+{
+
+	nh->nh_pending = 1;
+	nh->nh_waited = nh->nh_drops;
+	epoch_call(&nh->nh_epoch, nhop4_free);
+}
+
+static void
+nhop4_free(struct epoch_context *ctx)
+{
+	struct nhop4_key key;
+	struct nhop4 *nh;
+
+	nh = epoch_containerof(ctx, struct nhop4, nh_epoch);
+	nh->nh_pending = 0;
+	/* Unless a route took it again meanwhile. */
+	if (nh->nh_refs != 0)
+		return;
+	/*
+	 * It was taken and let go again while we waited: readers may have
+	 * found it through the routes of the second round, wait for them.
+	 */
+	if (nh->nh_waited != nh->nh_drops) {
+		nhop4_wait(nh);
+		return;
+	}
+	nhop4_key(&key, nh->nh_gw, nh->nh_ifp);
+	rte_hash_del_key(fib4_nhopidx, &key);
+	nh->nh_ifp = NULL;
+	fib4_nhop_free[fib4_nnhop_free++] = nh - fib4_nhops;
+}
+
+static void
+nhop4_put(uint32_t i)
+{
+	struct nhop4 *nh;
+
+	nh = &fib4_nhops[i];
+	if (--nh->nh_refs != 0)
+		return;
+	nh->nh_drops++;
+	if (!nh->nh_pending)
+		nhop4_wait(nh);
+}
+
+static void
+fib4_tbl8_reclaim(struct epoch_context *ctx)
+{
+	struct fib4_tbl8g *tg;
+
+	tg = epoch_containerof(ctx, struct fib4_tbl8g, tg_epoch);
+	fib4_tbl8_free[fib4_ntbl8_free++] = tg - fib4_tbl8g;
+}
+
+/*
+ * Whether entry x gives way to a prefix of length plen being added, or
+ * was set by one being deleted.
+ */
+static inline int
+fib4_takes(uint32_t x, uint32_t plen, int add)
+{
+
+	if (add)
+		return (!(x & FIB4_VALID) || FIB4_PLEN(x) <= plen);
+	return ((x & FIB4_VALID) && FIB4_PLEN(x) == plen);
+}
+
+static void
+fib4_update8(uint32_t *g, uint32_t lo, uint32_t hi, uint32_t plen,
+    uint32_t e, int add)
+{
+	uint32_t i;
+
+	for (i = lo; i < hi; i++)
+		if (fib4_takes(g[i], plen, add))
+			g[i] = e;
+}
+
+static void
+fib4_update24(struct fib4_table *t, uint32_t lo, uint32_t hi, uint32_t plen,
+    uint32_t e, int add)
+{
+	uint32_t i, x;
+
+	for (i = lo; i < hi; i++) {
+		x = t->ft_tbl24[i];
+		if (x & FIB4_EXT)
+			fib4_update8(&t->ft_tbl8[(x & FIB4_NH_MASK) *
+			    FIB4_TBL8_SIZE], 0, FIB4_TBL8_SIZE, plen, e, add);
+		else if (fib4_takes(x, plen, add))
+			t->ft_tbl24[i] = e;
+	}
+}
+
+/*
+ * Set the entries of ip/plen to e in every table, where e takes over
+ * (add) or where ip/plen had set them (delete).  A /24 needing a tbl8
+ * group gets one, a /24 no longer needing one returns it.
+ */
+static void
+fib4_update(uint32_t ip, uint32_t plen, uint32_t e, int add)
+{
+	struct fib4_table *t;
+	uint32_t i, j, x, g, lo, hi, *tbl8;
+	unsigned socket;
+	int collapsed;
+
+	if (plen <= 24) {
+		lo = ip >> 8;
+		hi = lo + (1 << (24 - plen));
+		for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+			t = &fib4_tables[socket];
+			if (t->ft_tbl24 != NULL)
+				fib4_update24(t, lo, hi, plen, e, add);
+		}
+		return;
+	}
+
+	i = ip >> 8;
+	lo = ip & 0xff;
+	hi = lo + (1 << (32 - plen));
+	g = FIB4_NONE;
+	collapsed = 0;
+	for (socket = 0; socket < RTE_MAX_NUMA_NODES; socket++) {
+		t = &fib4_tables[socket];
+		if (t->ft_tbl24 == NULL)
+			continue;
+		x = t->ft_tbl24[i];
+		if (!(x & FIB4_EXT)) {
+			/* Adding only, the caller made sure of a group. */
+			if (g == FIB4_NONE)
+				g = fib4_tbl8_free[--fib4_ntbl8_free];
+			tbl8 = &t->ft_tbl8[g * FIB4_TBL8_SIZE];
+			for (j = 0; j < FIB4_TBL8_SIZE; j++)
+				tbl8[j] = x;
+			fib4_update8(tbl8, lo, hi, plen, e, add);
+			rte_smp_wmb();
+			t->ft_tbl24[i] = FIB4_VALID | FIB4_EXT | g;
+			continue;
+		}
+		g = x & FIB4_NH_MASK;
+		tbl8 = &t->ft_tbl8[g * FIB4_TBL8_SIZE];
+		fib4_update8(tbl8, lo, hi, plen, e, add);
+		if (add)
+			continue;
+		for (j = 0; j < FIB4_TBL8_SIZE; j++)
+			if ((tbl8[j] & FIB4_VALID) && FIB4_PLEN(tbl8[j]) > 24)
+				break;
+		if (j == FIB4_TBL8_SIZE) {
+			t->ft_tbl24[i] = tbl8[0];
+			collapsed = 1;
+		}
+	}
+	/* All tables are alike: a group one let go, all did. */
+	if (collapsed)
+		epoch_call(&fib4_tbl8g[g].tg_epoch, fib4_tbl8_reclaim);
+}
+
+/*
+ * The entry ip/plen falls back to: that of the longest shorter prefix
+ * covering it, invalid if none.
+ */
+static uint32_t
+fib4_cover(uint32_t ip, uint32_t plen)
+{
+	struct fib4_key key;
+	void *data;
+	uint32_t p;
+
+	memset(&key, 0, sizeof(key));
+	for (p = plen - 1; p > 0; p--) {
+		if (fib4_nrules[p] == 0)
+			continue;
+		key.fk_addr = ip & fib4_mask(p);
+		key.fk_plen = p;
+		if (rte_hash_lookup_data(fib4_rules, &key, &data) >= 0)
+			return (FIB4_ENTRY(p,
+			    fib4_routes[(uintptr_t)data].fr_nh));
+	}
+	return (0);
+}
+
+static inline void
+fib4_key(struct fib4_key *key, struct in_addr dst, uint32_t plen)
+{
+
+	memset(key, 0, sizeof(*key));
+	key->fk_addr = rte_be_to_cpu_32(dst.s_addr) & fib4_mask(plen);
+	key->fk_plen = plen;
+}
+
+/*
+ * The first of the routes to key, FIB4_NONE if none.
+ */
+static uint32_t
+fib4_head(const struct fib4_key *key)
+{
+	void *data;
+
+	if (key->fk_plen == 0)
+		return (fib4_default_head);
+	if (rte_hash_lookup_data(fib4_rules, key, &data) < 0)
+		return (FIB4_NONE);
+	return ((uint32_t)(uintptr_t)data);
+}
+
+/*
+ * Make the routes to key start at head, FIB4_NONE if there are none left,
+ * and point the entries of key to the next hop of the first, where oldnh,
+ * that of the former first, or FIB4_NONE, was.  Only adding a prefix can
+ * fail.
+ */
+static int
+fib4_set(const struct fib4_key *key, uint32_t oldnh, uint32_t head)
+{
+	uint32_t nh, plen;
+	int error;
+
+	plen = key->fk_plen;
+	nh = head != FIB4_NONE ? fib4_routes[head].fr_nh : FIB4_NONE;
+	if (plen == 0) {
+		fib4_default_head = head;
+		rte_smp_wmb();
+		fib4_default = nh;
+		return (0);
+	}
+	if (head == FIB4_NONE) {
+		rte_hash_del_key(fib4_rules, key);
+		fib4_nrules[plen]--;
+		fib4_update(key->fk_addr, plen,
+		    fib4_cover(key->fk_addr, plen), 0);
+		return (0);
+	}
+	error = rte_hash_add_key_data(fib4_rules, key,
+	    (void *)(uintptr_t)head);
+	if (error < 0)
+		return (-error);
+	if (oldnh == FIB4_NONE)
+		fib4_nrules[plen]++;
+	if (nh != oldnh) {
+		/* The next hop before the entries pointing to it. */
+		rte_smp_wmb();
+		fib4_update(key->fk_addr, plen, FIB4_ENTRY(plen, nh), 1);
+	}
+	return (0);
+}
+
+/*
+ * Take route i, after prev or first, off the routes to key.
+ */
+static void
+fib4_unlink(const struct fib4_key *key, uint32_t prev, uint32_t i)
+{
+	struct fib4_route *rt;
+
+	rt = &fib4_routes[i];
+	if (prev != FIB4_NONE)
+		fib4_routes[prev].fr_next = rt->fr_next;
+	else
+		fib4_set(key, rt->fr_nh, rt->fr_next);
+	nhop4_put(rt->fr_nh);
+	rt->fr_next = fib4_route_free;
+	fib4_route_free = i;
+}
+
+int
+fib4_add(struct in_addr dst, int plen, struct in_addr gw, struct ifnet *ifp,
+    uint32_t metric, int replace)
+{
+	const struct fib4_table *t;
+	struct fib4_route *rt;
+	struct fib4_key key;
+	uint32_t nh, old, head, prev, i;
+	int error;
+
+	if (plen < 0 || plen > 32)
+		return (EINVAL);
+	fib4_key(&key, dst, plen);
+	head = fib4_head(&key);
+	nh = nhop4_get(gw, ifp);
+	if (nh == FIB4_NONE)
+		return (ENOSPC);
+
+	/* A route we have, or the one it replaces. */
+	for (i = head; i != FIB4_NONE; i = rt->fr_next) {
+		rt = &fib4_routes[i];
+		if (rt->fr_metric == metric && (rt->fr_nh == nh || replace))
+			break;
+	}
+	if (i != FIB4_NONE) {
+		rt->fr_gen = fib4_gen;
+		old = rt->fr_nh;
+		if (old == nh) {
+			nhop4_put(nh);
+			return (0);
+		}
+		rt->fr_nh = nh;
+		if (i == head)
+			fib4_set(&key, old, head);
+		nhop4_put(old);
+		return (0);
+	}
+
+	if (head == FIB4_NONE && plen > 24 && fib4_ntbl8_free == 0) {
+		/* Unless the /24 has a group already. */
+		for (t = fib4_tables; t->ft_tbl24 == NULL; t++)
+			;
+		if (!(t->ft_tbl24[key.fk_addr >> 8] & FIB4_EXT)) {
+			nhop4_put(nh);
+			return (ENOSPC);
+		}
+	}
+	if (fib4_route_free == FIB4_NONE) {
+		nhop4_put(nh);
+		return (ENOSPC);
+	}
+	i = fib4_route_free;
+	rt = &fib4_routes[i];
+	fib4_route_free = rt->fr_next;
+	rt->fr_nh = nh;
+	rt->fr_metric = metric;
+	rt->fr_gen = fib4_gen;
+
+	/* After those with the same metric or a lower one. */
+	prev = FIB4_NONE;
+	for (old = head; old != FIB4_NONE &&
+	    fib4_routes[old].fr_metric <= metric;
+	    old = fib4_routes[old].fr_next)
+		prev = old;
+	rt->fr_next = old;
+	if (prev != FIB4_NONE) {
+		fib4_routes[prev].fr_next = i;
+		return (0);
+	}
+	error = fib4_set(&key,
+	    head != FIB4_NONE ? fib4_routes[head].fr_nh : FIB4_NONE, i);
+	if (error != 0) {
+		rt->fr_next = fib4_route_free;
+		fib4_route_free = i;
+		nhop4_put(nh);
+	}
+	return (error);
+}
+
+int
+fib4_delete(struct in_addr dst, int plen, struct in_addr gw,
+    struct ifnet *ifp, uint32_t metric)
+{
+	const struct nhop4 *nhop;
+	struct fib4_key key;
+	uint32_t prev, i;
+
+	if (plen < 0 || plen > 32)
+		return (EINVAL);
+	fib4_key(&key, dst, plen);
+	i = fib4_head(&key);
+	if (i == FIB4_NONE)
+		return (ENOENT);
+	for (prev = FIB4_NONE; i != FIB4_NONE; i = fib4_routes[i].fr_next) {
+		nhop = fib4_nhop(fib4_routes[i].fr_nh);
+		if (fib4_routes[i].fr_metric == metric &&
+		    nhop->nh_ifp == ifp && nhop->nh_gw.s_addr == gw.s_addr)
+			break;
+		prev = i;
+	}
+	if (i == FIB4_NONE)
+		return (ESRCH);
+	fib4_unlink(&key, prev, i);
+	return (0);
+}
+
+/*
+ * Remove the routes to key that doomed() picks.
+ */
+static void
+fib4_prune(const struct fib4_key *key,
+    int (*doomed)(const struct fib4_route *, const void *), const void *arg)
+{
+	uint32_t prev, i, next;
+
+	prev = FIB4_NONE;
+	for (i = fib4_head(key); i != FIB4_NONE; i = next) {
+		next = fib4_routes[i].fr_next;
+		if (doomed(&fib4_routes[i], arg))
+			fib4_unlink(key, prev, i);
+		else
+			prev = i;
+	}
+}
+
+/*
+ * Remove the routes that doomed() picks.  rte_hash must not lose keys
+ * while it is iterated over, so the prefixes with such routes are
+ * collected first and pruned after, all in one go unless there is no
+ * memory for the lot.
+ */
+static void
+fib4_remove_if(int (*doomed)(const struct fib4_route *, const void *),
+    const void *arg)
+{
+	struct fib4_key chunk[FIB4_BULK], *d, def;
+	const void *k;
+	void *data;
+	uint32_t next, i, n, max;
+
+	memset(&def, 0, sizeof(def));
+	fib4_prune(&def, doomed, arg);
+	for (i = max = 0; i <= 32; i++)
+		max += fib4_nrules[i];
+	if (max == 0)
+		return;
+	d = rte_malloc("fib4_doomed", max * sizeof(*d), 0);
+	if (d == NULL) {
+		d = chunk;
+		max = RTE_DIM(chunk);
+	}
+	do {
+		next = n = 0;
+		while (n < max &&
+		    rte_hash_iterate(fib4_rules, &k, &data, &next) >= 0) {
+			for (i = (uintptr_t)data; i != FIB4_NONE;
+			    i = fib4_routes[i].fr_next)
+				if (doomed(&fib4_routes[i], arg))
+					break;
+			if (i != FIB4_NONE)
+				memcpy(&d[n++], k, sizeof(d[0]));
+		}
+		for (i = 0; i < n; i++)
+			fib4_prune(&d[i], doomed, arg);
+	} while (n == max);
+	if (d != chunk)
+		rte_free(d);
+}
+
+static int
+fib4_doomed_ifp(const struct fib4_route *rt, const void *ifp)
+{
+
+	return (fib4_nhops[rt->fr_nh].nh_ifp == ifp);
+}
+
+/*
+ * The kernel drops the IPv4 routes through a link that goes away without
+ * a word, so they go here.
+ */
+void
+fib4_flush(struct ifnet *ifp)
+{
+
+	fib4_remove_if(fib4_doomed_ifp, ifp);
+}
+
+/*
+ * Resynchronization with the kernel: the routes not added again between
+ * fib4_mark() and fib4_sweep() go.
+ */
+void
+fib4_mark(void)
+{
+
+	fib4_gen++;
+}
+
+static int
+fib4_doomed_stale(const struct fib4_route *rt, const void *arg __rte_unused)
+{
+
+	return (rt->fr_gen != fib4_gen);
+}
+
+void
+fib4_sweep(void)
+{
+
+	fib4_remove_if(fib4_doomed_stale, NULL);
+}
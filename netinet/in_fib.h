@@ -0,0 +1,74 @@
+#ifndef _NETINET_IN_FIB_H_
+#define	_NETINET_IN_FIB_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include "net/epoch.h"
+
+struct ifnet;
+
+/*
+ * IPv4 forwarding table, mirrored from the kernel's main routing table by
+ * core/kip_monitor.c: a DIR-24-8 table (Gupta, Lin and McKeown), as in
+ * rte_lpm, per NUMA socket, mapping prefixes to next hop indices into
+ * fib4_nhops[].  A next hop is an interface and a gateway, or no gateway
+ * for on-link destinations, for the neighbour tables to resolve.
+ *
+ * Lookups are lock-free; the control lcore is the only writer.  Every
+ * entry changes in one 32-bit store, and neither a next hop nor a tbl8
+ * group is reused before the dataplane has gone through an epoch since
+ * it was let go of.
+ */
+#define	FIB4_MAX_RULES		(1 << 20)	/* a full BGP table, with room */
+#define	FIB4_TBL8_GROUPS	(1 << 16)	/* /24s with longer prefixes */
+#define	FIB4_MAX_NHOPS		4096
+#define	FIB4_NONE		UINT32_MAX	/* no route */
+
+struct nhop4 {
+	struct in_addr	nh_gw;		/* INADDR_ANY when on-link */
+	struct ifnet	*nh_ifp;	/* NULL when free */
+	uint32_t	nh_refs;	/* routes through it */
+	int		nh_pending;	/* in epoch_call() */
+	uint32_t	nh_drops;	/* times nh_refs fell to 0 */
+	uint32_t	nh_waited;	/* nh_drops the grace period covers */
+	struct epoch_context nh_epoch;
+};
+
+extern struct nhop4	fib4_nhops[FIB4_MAX_NHOPS];
+
+static inline const struct nhop4 *
+fib4_nhop(uint32_t nh)
+{
+
+	return (&fib4_nhops[nh]);
+}
+
+int	fib4_init(void);
+
+/*
+ * Dataplane: next hop index for dst, or FIB4_NONE.
+ */
+uint32_t	fib4_lookup(struct in_addr dst);
+void	fib4_lookup_bulk(const struct in_addr *dst, u_int n, uint32_t *nh);
+
+/*
+ * Control lcore only.  A route is a prefix, a metric and a next hop; of
+ * the routes to a prefix, the one with the lowest metric, the first added
+ * among equals, is used, as in the kernel.  Adding a route with the metric
+ * of another to the same prefix but another next hop adds a second one,
+ * unless replace is set, as for a kernel route with NLM_F_REPLACE.
+ * fib4_flush() removes the routes through ifp.  Routes not added again
+ * between fib4_mark() and fib4_sweep() are removed by the latter, for
+ * resynchronizing with the kernel.
+ */
+int	fib4_add(struct in_addr dst, int plen, struct in_addr gw,
+	    struct ifnet *ifp, uint32_t metric, int replace);
+int	fib4_delete(struct in_addr dst, int plen, struct in_addr gw,
+	    struct ifnet *ifp, uint32_t metric);
+void	fib4_flush(struct ifnet *ifp);
+void	fib4_mark(void);
+void	fib4_sweep(void);
+
+#endif /* !_NETINET_IN_FIB_H_ */
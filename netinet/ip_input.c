@@ -0,0 +1,463 @@
+/*-
+ * Copyright (c) 1982, 1986, 1989, 1993
+ *	The Regents of the University of California.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	@(#)ip_input.c	8.2 (Berkeley) 1/4/94
+ * $FreeBSD$
+ */
+
+/*
+ * IPv4 input.  ip_input_burst() validates the headers of a burst, four at
+ * a time with SSE2 on x86: a header without options whose total length
+ * matches the packet and whose checksum the NIC verified passes the vector
+ * check, anything else goes through ip_check().  Valid packets are then
+ * sorted by fate, delivered locally, handed to the virtual services, or
+ * forwarded along the routes of netinet/in_fib.c, and each fate is handled
+ * as a sub-burst.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_ip.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+#ifdef RTE_ARCH_X86
+#include <emmintrin.h>
+#endif
+
+#include "net/ethernet.h"
+#include "net/if_arp.h"
+#include "net/if_llatbl.h"
+#include "net/if_var.h"
+#include "net/netisr.h"
+#include "in_fib.h"
+#include "ip_var.h"
+
+#define	IP_BURST		32
+#define	IP_PREFETCH_OFFSET	3
+
+/*
+ * Fates of a valid packet.
+ */
+#define	IP_FATE_LOCAL		0
+#define	IP_FATE_VIP		1
+#define	IP_FATE_FORWARD		2
+#define	IP_NFATES		3
+
+PCPUSTAT_DEFINE(struct ipstat, ipstat);
+
+static ip_input_t	*ip_protox[IPPROTO_MAX];
+static ip_vip_input_t	*ip_vip_input;
+
+int
+ipproto_register(uint8_t proto, ip_input_t *input)
+{
+
+	if (ip_protox[proto] != NULL)
+		return (EEXIST);
+	ip_protox[proto] = input;
+	return (0);
+}
+
+int
+ipproto_unregister(uint8_t proto)
+{
+
+	if (ip_protox[proto] == NULL)
+		return (ENOENT);
+	ip_protox[proto] = NULL;
+	return (0);
+}
+
+void
+ip_vip_register(ip_vip_input_t *input)
+{
+
+	ip_vip_input = input;
+}
+
+/*
+ * Validate the header of a packet, counting the reason it is bad if it
+ * is.  Trims link layer padding past the IP datagram.
+ */
+static int
+ip_check(struct rte_mbuf *m)
+{
+	uint32_t hbuf[15];	/* maximum header length */
+	const struct ip *ip;
+	u_int hlen, len;
+
+	/* The header may span segments: copy it out if it does. */
+	ip = rte_pktmbuf_read(m, 0, sizeof(struct ip), hbuf);
+	if (unlikely(ip == NULL)) {
+		IPSTAT_INC(ips_toosmall);
+		return (-1);
+	}
+	if (unlikely(ip->ip_v != IPVERSION)) {
+		IPSTAT_INC(ips_badvers);
+		return (-1);
+	}
+	hlen = ip->ip_hl << 2;
+	if (unlikely(hlen < sizeof(struct ip))) {	/* minimum header length */
+		IPSTAT_INC(ips_badhlen);
+		return (-1);
+	}
+	if (hlen > sizeof(struct ip)) {
+		ip = rte_pktmbuf_read(m, 0, hlen, hbuf);
+		if (unlikely(ip == NULL)) {
+			IPSTAT_INC(ips_badhlen);
+			return (-1);
+		}
+	}
+
+	switch (m->ol_flags & (PKT_RX_IP_CKSUM_GOOD | PKT_RX_IP_CKSUM_BAD)) {
+	case PKT_RX_IP_CKSUM_GOOD:
+		break;
+	case PKT_RX_IP_CKSUM_BAD:
+		IPSTAT_INC(ips_badsum);
+		return (-1);
+	default:
+		/* Not verified by the NIC. */
+		if (unlikely(rte_raw_cksum(ip, hlen) != 0xffff)) {
+			IPSTAT_INC(ips_badsum);
+			return (-1);
+		}
+		break;
+	}
+
+	len = rte_be_to_cpu_16(ip->ip_len);
+	if (unlikely(len < hlen)) {
+		IPSTAT_INC(ips_badlen);
+		return (-1);
+	}
+	/*
+	 * Check that the amount of data in the buffers is at least as much
+	 * as the IP header would have us expect.  Trim the rest.
+	 */
+	if (unlikely(m->pkt_len < len)) {
+		IPSTAT_INC(ips_tooshort);
+		return (-1);
+	}
+	if (m->pkt_len > len && rte_pktmbuf_trim(m, m->pkt_len - len) != 0) {
+		IPSTAT_INC(ips_tooshort);
+		return (-1);
+	}
+	return (0);
+}
+
+#ifdef RTE_ARCH_X86
+/*
+ * Vector check of four headers.  Returns the mask of those that are
+ * version 4 without options, in the first segment, with a total length
+ * equal to the packet length and a checksum verified good by the NIC:
+ * these are valid as they are.  The 16-byte loads stay within the mbuf
+ * data room whatever the packet length.
+ */
+static inline u_int
+ip_check_x4(struct rte_mbuf **m)
+{
+	__m128i h0, h1, h2, h3, d0, len, ok;
+	u_int good, i;
+
+	h0 = _mm_loadu_si128(rte_pktmbuf_mtod(m[0], const __m128i *));
+	h1 = _mm_loadu_si128(rte_pktmbuf_mtod(m[1], const __m128i *));
+	h2 = _mm_loadu_si128(rte_pktmbuf_mtod(m[2], const __m128i *));
+	h3 = _mm_loadu_si128(rte_pktmbuf_mtod(m[3], const __m128i *));
+
+	/* First word of each header: version/IHL, TOS and total length. */
+	d0 = _mm_unpacklo_epi64(_mm_unpacklo_epi32(h0, h1),
+	    _mm_unpacklo_epi32(h2, h3));
+
+	ok = _mm_cmpeq_epi32(_mm_and_si128(d0, _mm_set1_epi32(0xff)),
+	    _mm_set1_epi32(0x45));
+	len = _mm_or_si128(
+	    _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(d0, 16),
+	    _mm_set1_epi32(0xff)), 8),
+	    _mm_srli_epi32(d0, 24));
+	ok = _mm_and_si128(ok, _mm_cmpeq_epi32(len,
+	    _mm_set_epi32(m[3]->pkt_len, m[2]->pkt_len, m[1]->pkt_len,
+	    m[0]->pkt_len)));
+	ok = _mm_and_si128(ok, _mm_cmpgt_epi32(
+	    _mm_set_epi32(m[3]->data_len, m[2]->data_len, m[1]->data_len,
+	    m[0]->data_len), _mm_set1_epi32(sizeof(struct ip) - 1)));
+
+	good = 0;
+	for (i = 0; i < 4; i++)
+		if ((m[i]->ol_flags & (PKT_RX_IP_CKSUM_GOOD |
+		    PKT_RX_IP_CKSUM_BAD)) == PKT_RX_IP_CKSUM_GOOD)
+			good |= 1 << i;
+
+	return (_mm_movemask_ps(_mm_castsi128_ps(ok)) & good);
+}
+#endif
+
+/*
+ * Whether dst is the broadcast address of a subnet of ifp, the one the
+ * packet came in on, as in FreeBSD.  Subnets longer than /30 have none.
+ */
+static inline int
+ip_subnet_bcast(const struct ifnet *ifp, struct in_addr dst)
+{
+	uint32_t mask;
+	u_int i, plen;
+
+	/* The two lowest bits are host bits in every subnet that has one. */
+	if (ifp == NULL ||
+	    (dst.s_addr & rte_cpu_to_be_32(3)) != rte_cpu_to_be_32(3))
+		return (0);
+	for (i = 0; i < ifp->if_naddrs; i++) {
+		plen = ifp->if_inaddrs[i].ia_plen;
+		if (plen == 0 || plen > 30)
+			continue;
+		mask = rte_cpu_to_be_32(~0U << (32 - plen));
+		if ((ifp->if_inaddrs[i].ia_addr.s_addr | ~mask) == dst.s_addr)
+			return (1);
+	}
+	return (0);
+}
+
+static inline int
+ip_fate(const struct rte_mbuf *m)
+{
+	const struct ip *ip;
+	struct ip iph;
+
+	ip = rte_pktmbuf_read(m, 0, sizeof(iph), &iph);
+	switch (in_addrtype(ip->ip_dst)) {
+	case IN_ADDR_LOCAL:
+		return (IP_FATE_LOCAL);
+	case IN_ADDR_VIP:
+		return (IP_FATE_VIP);
+	}
+	if (IN_MULTICAST(rte_be_to_cpu_32(ip->ip_dst.s_addr)) ||
+	    ip->ip_dst.s_addr == INADDR_BROADCAST ||
+	    ip_subnet_bcast(m_rcvif(m), ip->ip_dst))
+		return (IP_FATE_LOCAL);
+	return (IP_FATE_FORWARD);
+}
+
+/*
+ * Pass a local packet to its upper layer protocol.  Fragments are not
+ * reassembled here: they go to the host, which reassembles them, as do
+ * packets of protocols no one registered.
+ */
+static void
+ip_deliver(struct rte_mbuf *m)
+{
+	const struct ip *ip;
+	struct ip iph;
+	int off, proto;
+
+	ip = rte_pktmbuf_read(m, 0, sizeof(iph), &iph);
+	if (unlikely(ip->ip_off & rte_cpu_to_be_16(IP_MF | IP_OFFMASK))) {
+		IPSTAT_INC(ips_fragments);
+		ether_host_input(m);
+		return;
+	}
+	if (ip_protox[ip->ip_p] == NULL) {
+		IPSTAT_INC(ips_noproto);
+		ether_host_input(m);
+		return;
+	}
+	IPSTAT_INC(ips_delivered);
+	off = ip->ip_hl << 2;
+	proto = ip->ip_p;
+	m->l3_len = off;
+	(void)ip_protox[proto](&m, &off, proto);
+}
+
+static void
+ip_vip_deliver(struct rte_mbuf **m, u_int n)
+{
+	u_int i;
+
+	if (n == 0)
+		return;
+	if (unlikely(ip_vip_input == NULL)) {
+		IPSTAT_ADD(ips_noproto, n);
+		for (i = 0; i < n; i++)
+			rte_pktmbuf_free(m[i]);
+		return;
+	}
+	IPSTAT_ADD(ips_vip, n);
+	ip_vip_input(m, n);
+}
+
+/*
+ * Forward a sub-burst of at most IP_BURST packets: their routes are
+ * looked up together, then their next hops.  There is no fragmentation
+ * and no ICMP error here: packets whose TTL runs out, and those too big
+ * for the next hop, go to the host, whose forwarding path fragments them
+ * or sends the ICMP error; what has no route is dropped and counted.
+ */
+static void
+ip_forward(struct rte_mbuf **m, u_int n)
+{
+	struct in_addr dst[IP_BURST], gw[IP_BURST];
+	struct ifnet *ifp[IP_BURST];
+	struct llentry *lle[IP_BURST];
+	uint32_t nh[IP_BURST];
+	const struct nhop4 *nhop;
+	struct ip *ip;
+	u_int i, k;
+
+	for (i = k = 0; i < n; i++) {
+		ip = rte_pktmbuf_mtod(m[i], struct ip *);
+		if (unlikely(m[i]->data_len < sizeof(struct ip))) {
+			IPSTAT_INC(ips_cantforward);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (unlikely(ip->ip_ttl <= IPTTLDEC)) {
+			IPSTAT_INC(ips_cantforward);
+			ether_host_input(m[i]);
+			continue;
+		}
+		dst[k] = ip->ip_dst;
+		m[k++] = m[i];
+	}
+	fib4_lookup_bulk(dst, k, nh);
+
+	for (i = 0, n = k, k = 0; i < n; i++) {
+		nhop = nh[i] == FIB4_NONE ? NULL : fib4_nhop(nh[i]);
+		if (unlikely(nhop == NULL || nhop->nh_ifp == NULL)) {
+			IPSTAT_INC(ips_noroute);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (unlikely(rte_pktmbuf_pkt_len(m[i]) > nhop->nh_ifp->if_mtu)) {
+			IPSTAT_INC(ips_cantfrag);
+			ether_host_input(m[i]);
+			continue;
+		}
+
+		/* Decrement the TTL, and update the checksum (RFC 1141). */
+		ip = rte_pktmbuf_mtod(m[i], struct ip *);
+		ip->ip_ttl -= IPTTLDEC;
+		if (ip->ip_sum >= (uint16_t)~htons(IPTTLDEC << 8))
+			ip->ip_sum -= ~htons(IPTTLDEC << 8);
+		else
+			ip->ip_sum += htons(IPTTLDEC << 8);
+		m[i]->ol_flags = 0;
+
+		ifp[k] = nhop->nh_ifp;
+		gw[k] = nhop->nh_gw.s_addr != INADDR_ANY ? nhop->nh_gw : dst[i];
+		m[k++] = m[i];
+	}
+	lla_lookup_bulk(AF_INET, gw, k, lle);
+
+	IPSTAT_ADD(ips_forward, k);
+	for (i = 0; i < k; i++) {
+		if (likely(lle[i] != NULL && (lle[i]->la_flags & LLE_VALID)))
+			(void)ether_output(lle[i]->lle_ifp, m[i],
+			    &lle[i]->lle_l2tmpl);
+		else
+			(void)arpresolve(ifp[i], m[i], gw[i]);
+	}
+}
+
+void
+ip_input(struct rte_mbuf *m)
+{
+
+	IPSTAT_INC(ips_total);
+	if (ip_check(m) != 0) {
+		rte_pktmbuf_free(m);
+		return;
+	}
+	switch (ip_fate(m)) {
+	case IP_FATE_LOCAL:
+		ip_deliver(m);
+		break;
+	case IP_FATE_VIP:
+		ip_vip_deliver(&m, 1);
+		break;
+	default:
+		ip_forward(&m, 1);
+		break;
+	}
+}
+
+void
+ip_input_burst(struct rte_mbuf **m, u_int n)
+{
+	struct rte_mbuf *sub[IP_NFATES][IP_BURST];
+	u_int cnt[IP_NFATES];
+	u_int f, fast, i, j, k;
+
+	IPSTAT_ADD(ips_total, n);
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, IP_BURST);
+
+		for (j = 0; j < k && j < IP_PREFETCH_OFFSET; j++)
+			rte_prefetch0(rte_pktmbuf_mtod(m[i + j], void *));
+		memset(cnt, 0, sizeof(cnt));
+		fast = 0;
+		for (j = 0; j < k; j++) {
+			if (j + IP_PREFETCH_OFFSET < k)
+				rte_prefetch0(rte_pktmbuf_mtod(
+				    m[i + j + IP_PREFETCH_OFFSET], void *));
+#ifdef RTE_ARCH_X86
+			if ((j & 3) == 0 && j + 4 <= k)
+				fast = ip_check_x4(&m[i + j]) << j;
+#endif
+			if (!(fast & (1 << j)) && ip_check(m[i + j]) != 0) {
+				rte_pktmbuf_free(m[i + j]);
+				continue;
+			}
+			f = ip_fate(m[i + j]);
+			sub[f][cnt[f]++] = m[i + j];
+		}
+
+		for (j = 0; j < cnt[IP_FATE_LOCAL]; j++)
+			ip_deliver(sub[IP_FATE_LOCAL][j]);
+		ip_vip_deliver(sub[IP_FATE_VIP], cnt[IP_FATE_VIP]);
+		ip_forward(sub[IP_FATE_FORWARD], cnt[IP_FATE_FORWARD]);
+	}
+}
+
+static const struct netisr_handler ip_nh = {
+	.nh_name = "ip",
+	.nh_handler = ip_input,
+	.nh_bhandler = ip_input_burst,
+	.nh_proto = NETISR_IP,
+	.nh_policy = NETISR_POLICY_SOURCE,
+	.nh_dispatch = NETISR_DISPATCH_DIRECT,
+};
+
+void
+ip_init(void)
+{
+
+	netisr_register(&ip_nh);
+}
@@ -0,0 +1,109 @@
+/*-
+ * Copyright (c) 1982, 1986, 1989, 1993
+ *	The Regents of the University of California.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	@(#)ip_var.h	8.2 (Berkeley) 1/9/95
+ * $FreeBSD$
+ */
+
+#ifndef _NETINET_IP_VAR_H_
+#define	_NETINET_IP_VAR_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "net/pcpustat.h"
+
+struct rte_mbuf;
+
+struct	ipstat {
+	uint64_t ips_total;		/* total packets received */
+	uint64_t ips_badsum;		/* checksum bad */
+	uint64_t ips_tooshort;		/* packet too short */
+	uint64_t ips_toosmall;		/* not enough data */
+	uint64_t ips_badhlen;		/* ip header length < data size */
+	uint64_t ips_badlen;		/* ip length < ip header length */
+	uint64_t ips_fragments;		/* fragments received */
+	uint64_t ips_cantforward;	/* packets rcvd for unreachable dest */
+	uint64_t ips_delivered;		/* datagrams delivered to upper level*/
+	uint64_t ips_noproto;		/* unknown or unsupported protocol */
+	uint64_t ips_badvers;		/* ip version != 4 */
+	uint64_t ips_vip;		/* packets for virtual services */
+	uint64_t ips_forward;		/* packets forwarded */
+	uint64_t ips_noroute;		/* packets discarded due to no route */
+	uint64_t ips_cantfrag;		/* datagrams too big to forward */
+};
+
+/*
+ * Statistics are per-lcore, see net/pcpustat.h.
+ */
+PCPUSTAT_DECLARE(struct ipstat, ipstat);
+
+#define	IPSTAT_ADD(name, val)	PCPUSTAT_ADD(ipstat, name, (val))
+#define	IPSTAT_SUB(name, val)	IPSTAT_ADD(name, -(val))
+#define	IPSTAT_INC(name)	IPSTAT_ADD(name, 1)
+#define	IPSTAT_DEC(name)	IPSTAT_SUB(name, 1)
+#define	IPSTAT_FETCH(dst)	PCPUSTAT_FETCH(struct ipstat, ipstat, (dst))
+
+#define	IPPROTO_DONE	257		/* all job for this packet are done */
+
+/*
+ * Upper layer input: called with the IP header at the front of *mp and
+ * *offp the offset of the protocol's header; returns IPPROTO_DONE once
+ * the packet is consumed.
+ */
+typedef int	ip_input_t(struct rte_mbuf **mp, int *offp, int proto);
+
+/*
+ * Input of packets for virtual services, a burst at a time, IP header at
+ * the front.
+ */
+typedef void	ip_vip_input_t(struct rte_mbuf **m, u_int n);
+
+int	ipproto_register(uint8_t proto, ip_input_t *input);
+int	ipproto_unregister(uint8_t proto);
+void	ip_vip_register(ip_vip_input_t *input);
+
+void	ip_init(void);
+void	ip_input(struct rte_mbuf *m);
+void	ip_input_burst(struct rte_mbuf **m, u_int n);
+
+/*
+ * Local addresses and virtual service addresses, see in.c.  Updates are
+ * for the control lcore only.
+ */
+#define	IN_ADDR_NONE	0
+#define	IN_ADDR_LOCAL	1		/* address of this host */
+#define	IN_ADDR_VIP	2		/* virtual service address */
+
+int	in_addlocal(struct in_addr addr, int type);
+int	in_dellocal(struct in_addr addr, int type);
+int	in_addrtype(struct in_addr addr);
+void	in_local_mark(void);
+void	in_local_sweep(void);
+
+#endif /* !_NETINET_IP_VAR_H_ */
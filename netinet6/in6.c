@@ -0,0 +1,161 @@
+/*-
+ * Copyright (C) 1995, 1996, 1997, and 1998 WIDE Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	$KAME: in6.c,v 1.259 2002/01/21 11:37:50 keiichi Exp $
+ * $FreeBSD$
+ */
+
+/*
+ * Local IPv6 addresses: the addresses ip6_input() delivers to the upper
+ * layers rather than forwards, mirrored from the kernel by
+ * core/kip_monitor.c.  As in netinet/in.c, they are in a hash the
+ * dataplane looks up without locking; the control lcore is the only
+ * writer, and removed entries go through epoch_call().
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_atomic.h>
+#include <rte_hash_crc.h>
+#include <rte_malloc.h>
+
+#include "net/epoch.h"
+#include "ip6_var.h"
+
+#define	IN6_LOCAL_HASHSIZE	256	/* a power of 2 */
+
+struct in6_local {
+	struct in6_local *il_next;
+	struct in6_addr	il_addr;
+	uint32_t	il_gen;		/* see in6_local_mark() */
+	struct epoch_context il_epoch;
+};
+
+static struct in6_local	*in6_local_hash[IN6_LOCAL_HASHSIZE];
+static uint32_t	in6_local_gen;
+
+static inline struct in6_local **
+in6_local_bucket(const struct in6_addr *addr)
+{
+
+	return (&in6_local_hash[rte_hash_crc(addr, sizeof(*addr), 0) &
+	    (IN6_LOCAL_HASHSIZE - 1)]);
+}
+
+static struct in6_local **
+in6_findlocal(const struct in6_addr *addr)
+{
+	struct in6_local **prev;
+
+	for (prev = in6_local_bucket(addr); *prev != NULL;
+	    prev = &(*prev)->il_next)
+		if (IN6_ARE_ADDR_EQUAL(&(*prev)->il_addr, addr))
+			break;
+	return (prev);
+}
+
+int
+in6_addlocal(const struct in6_addr *addr)
+{
+	struct in6_local **prev, *il;
+
+	prev = in6_findlocal(addr);
+	if (*prev != NULL) {
+		(*prev)->il_gen = in6_local_gen;
+		return (EEXIST);
+	}
+	il = rte_zmalloc("in6_local", sizeof(*il), 0);
+	if (il == NULL)
+		return (ENOMEM);
+	il->il_addr = *addr;
+	il->il_gen = in6_local_gen;
+	rte_smp_wmb();
+	*prev = il;
+	return (0);
+}
+
+static void
+in6_local_free(struct epoch_context *ctx)
+{
+
+	rte_free(epoch_containerof(ctx, struct in6_local, il_epoch));
+}
+
+int
+in6_dellocal(const struct in6_addr *addr)
+{
+	struct in6_local **prev, *il;
+
+	prev = in6_findlocal(addr);
+	il = *prev;
+	if (il == NULL)
+		return (ENOENT);
+	*prev = il->il_next;
+	epoch_call(&il->il_epoch, in6_local_free);
+	return (0);
+}
+
+/*
+ * As in_local_mark() and in_local_sweep().
+ */
+void
+in6_local_mark(void)
+{
+
+	in6_local_gen++;
+}
+
+void
+in6_local_sweep(void)
+{
+	struct in6_local **prev, *il;
+	u_int i;
+
+	for (i = 0; i < IN6_LOCAL_HASHSIZE; i++) {
+		prev = &in6_local_hash[i];
+		while ((il = *prev) != NULL) {
+			if (il->il_gen != in6_local_gen) {
+				*prev = il->il_next;
+				epoch_call(&il->il_epoch, in6_local_free);
+			} else
+				prev = &il->il_next;
+		}
+	}
+}
+
+int
+in6_localip(const struct in6_addr *addr)
+{
+	const struct in6_local *il;
+
+	for (il = *in6_local_bucket(addr); il != NULL; il = il->il_next)
+		if (IN6_ARE_ADDR_EQUAL(&il->il_addr, addr))
+			return (1);
+	return (0);
+}
@@ -0,0 +1,784 @@
+/*
+ * IPv6 forwarding table, see in6_fib.h.
+ *
+ * The layout is that of netinet/in_fib.c, with more levels: an entry of
+ * tbl24 or of a tbl8 group holds a next hop index and the length of the
+ * prefix that set it, or points to a group of the next level, for the
+ * addresses longer prefixes cut up.  The entries of a group that no
+ * prefix longer than its parent entry's set hold what that entry would.
+ * Each socket allocates groups for its own table, from its own stack.
+ *
+ * rte_lpm6 in the DPDK we use has 8-bit next hops and finds rules by a
+ * linear search on every update; rules are in a hash here too.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_common.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_lcore.h>
+#include <rte_log.h>
+#include <rte_malloc.h>
+#include <rte_prefetch.h>
+
+#include "net/epoch.h"
+#include "in6_fib.h"
+
+#define RTE_LOGTYPE_FIB RTE_LOGTYPE_USER1
+
+#define	FIB6_VALID		0x80000000
+#define	FIB6_EXT		0x40000000	/* to a tbl8 group */
+#define	FIB6_PLEN_SHIFT		22
+#define	FIB6_PLEN_MASK		0x3fc00000
+#define	FIB6_NH_MASK		0x003fffff
+
+#define	FIB6_ENTRY(plen, nh)	(FIB6_VALID | (plen) << FIB6_PLEN_SHIFT | (nh))
+#define	FIB6_PLEN(e)		(((e) & FIB6_PLEN_MASK) >> FIB6_PLEN_SHIFT)
+
+#define	FIB6_TBL24_SIZE		(1 << 24)
+#define	FIB6_TBL8_SIZE		256
+#define	FIB6_BULK		32
+
+struct fib6_tbl8g;
+
+struct fib6_table {
+	uint32_t	*ft_tbl24;
+	uint32_t	*ft_tbl8;
+
+	/* Control lcore only. */
+	uint32_t	*ft_free;		/* free groups, a stack */
+	uint32_t	ft_nfree;
+	struct fib6_tbl8g *ft_groups;
+};
+
+struct fib6_tbl8g {
+	struct epoch_context tg_epoch;
+	struct fib6_table *tg_table;
+};
+
+struct fib6_key {
+	struct in6_addr	fk_addr;	/* masked */
+	uint32_t	fk_plen;
+};
+
+/* Next hops are found by what they are in fib6_nhopidx. */
+struct nhop6_key {
+	struct in6_addr	nk_gw;
+	struct ifnet	*nk_ifp;
+};
+
+/*
+ * The routes to a prefix, several when routers advertise the same one,
+ * say, are listed as in_fib.c does.
+ */
+struct fib6_route {
+	uint32_t	fr_nh;
+	uint32_t	fr_metric;
+	uint32_t	fr_gen;		/* that last added it, see fib6_mark() */
+	uint32_t	fr_next;	/* FIB6_NONE at the end */
+};
+
+struct nhop6	fib6_nhops[FIB6_MAX_NHOPS];
+static volatile uint32_t	fib6_default = FIB6_NONE;
+
+static struct fib6_table	fib6_tables[RTE_MAX_NUMA_NODES];
+
+/*
+ * Control lcore only.
+ */
+static struct rte_hash	*fib6_rules;
+static struct rte_hash	*fib6_nhopidx;
+static uint32_t	fib6_nhop_free[FIB6_MAX_NHOPS];
+static uint32_t	fib6_nnhop_free;
+static uint32_t	fib6_nrules[129];	/* per prefix length */
+static uint32_t	fib6_gen;		/* see fib6_mark() */
+static struct fib6_route	*fib6_routes;
+static uint32_t	fib6_route_free;	/* chained through fr_next */
+static uint32_t	fib6_default_head = FIB6_NONE;
+
+static inline const struct fib6_table *
+fib6_local(void)
+{
+	unsigned socket;
+
+	socket = rte_socket_id();
+	if (unlikely(socket >= RTE_MAX_NUMA_NODES))
+		socket = 0;
+	return (&fib6_tables[socket]);
+}
+
+static inline uint32_t *
+fib6_group(const struct fib6_table *t, uint32_t e)
+{
+
+	return (&t->ft_tbl8[(e & FIB6_NH_MASK) * FIB6_TBL8_SIZE]);
+}
+
+static inline uint32_t
+fib6_tbl24_index(const uint8_t *a)
+{
+
+	return (a[0] << 16 | a[1] << 8 | a[2]);
+}
+
+static void
+fib6_masklen(struct in6_addr *a, uint32_t plen)
+{
+	uint32_t i;
+
+	for (i = 0; i < 16; i++, plen = plen > 8 ? plen - 8 : 0)
+		if (plen < 8)
+			a->s6_addr[i] &= (uint8_t)(0xff00 >> plen);
+}
+
+int
+fib6_init(void)
+{
+	struct rte_hash_parameters params;
+	struct fib6_table *t;
+	unsigned lcore, socket;
+	uint32_t i;
+
+	RTE_BUILD_BUG_ON(sizeof(uintptr_t) < sizeof(uint64_t));
+
+	memset(&params, 0, sizeof(params));
+	params.name = "fib6_rules";
+	params.entries = FIB6_MAX_RULES;
+	params.key_len = sizeof(struct fib6_key);
+	params.hash_func = rte_hash_crc;
+	params.socket_id = rte_socket_id();
+	fib6_rules = rte_hash_create(&params);
+	if (fib6_rules == NULL)
+		return (ENOMEM);
+	params.name = "fib6_nhops";
+	params.entries = FIB6_MAX_NHOPS;
+	params.key_len = sizeof(struct nhop6_key);
+	fib6_nhopidx = rte_hash_create(&params);
+	if (fib6_nhopidx == NULL)
+		return (ENOMEM);
+	fib6_routes = rte_malloc("fib6_routes",
+	    FIB6_MAX_RULES * sizeof(*fib6_routes), 0);
+	if (fib6_routes == NULL)
+		return (ENOMEM);
+	for (i = 0; i < FIB6_MAX_NHOPS; i++)
+		fib6_nhop_free[i] = FIB6_MAX_NHOPS - 1 - i;
+	fib6_nnhop_free = FIB6_MAX_NHOPS;
+	for (i = 0; i < FIB6_MAX_RULES - 1; i++)
+		fib6_routes[i].fr_next = i + 1;
+	fib6_routes[i].fr_next = FIB6_NONE;
+	fib6_route_free = 0;
+
+	RTE_LCORE_FOREACH(lcore) {
+		socket = rte_lcore_to_socket_id(lcore);
+		t = &fib6_tables[socket];
+		if (t->ft_tbl24 != NULL)
+			continue;
+		t->ft_tbl24 = rte_zmalloc_socket("fib6_tbl24",
+		    FIB6_TBL24_SIZE * sizeof(uint32_t), RTE_CACHE_LINE_SIZE,
+		    socket);
+		t->ft_tbl8 = rte_zmalloc_socket("fib6_tbl8",
+		    FIB6_TBL8_GROUPS * FIB6_TBL8_SIZE * sizeof(uint32_t),
+		    RTE_CACHE_LINE_SIZE, socket);
+		t->ft_free = rte_malloc_socket("fib6_free",
+		    FIB6_TBL8_GROUPS * sizeof(uint32_t), 0, socket);
+		t->ft_groups = rte_zmalloc_socket("fib6_groups",
+		    FIB6_TBL8_GROUPS * sizeof(struct fib6_tbl8g), 0, socket);
+		if (t->ft_tbl24 == NULL || t->ft_tbl8 == NULL ||
+		    t->ft_free == NULL || t->ft_groups == NULL) {
+			RTE_LOG(ERR, FIB, "%s: cannot allocate table on "
+			    "socket %u\n", __func__, socket);
+			return (ENOMEM);
+		}
+		for (i = 0; i < FIB6_TBL8_GROUPS; i++) {
+			t->ft_free[i] = FIB6_TBL8_GROUPS - 1 - i;
+			t->ft_groups[i].tg_table = t;
+		}
+		t->ft_nfree = FIB6_TBL8_GROUPS;
+	}
+	return (0);
+}
+
+void
+fib6_usage(struct fib6_usage *fu)
+{
+	const struct fib6_table *t;
+	uint32_t p;
+
+	memset(fu, 0, sizeof(*fu));
+	for (p = 1; p <= 128; p++)
+		fu->fu_rules += fib6_nrules[p];
+	for (t = fib6_tables; t < &fib6_tables[RTE_MAX_NUMA_NODES]; t++)
+		if (t->ft_tbl24 != NULL) {
+			fu->fu_tbl8 = FIB6_TBL8_GROUPS - t->ft_nfree;
+			break;
+		}
+	fu->fu_fixed = FIB6_TBL24_SIZE * sizeof(uint32_t);
+	if (fu->fu_rules != 0)
+		fu->fu_per_rule = (size_t)fu->fu_tbl8 * FIB6_TBL8_SIZE *
+		    sizeof(uint32_t) / fu->fu_rules;
+}
+
+static inline uint32_t
+fib6_entry(const struct fib6_table *t, const uint8_t *a)
+{
+	uint32_t e;
+	u_int i;
+
+	e = t->ft_tbl24[fib6_tbl24_index(a)];
+	for (i = 3; unlikely(e & FIB6_EXT); i++)
+		e = fib6_group(t, e)[a[i]];
+	return (e);
+}
+
+uint32_t
+fib6_lookup(const struct in6_addr *dst)
+{
+	const struct fib6_table *t;
+	uint32_t e;
+
+	t = fib6_local();
+	if (unlikely(t->ft_tbl24 == NULL))
+		return (FIB6_NONE);
+	e = fib6_entry(t, dst->s6_addr);
+	return (e & FIB6_VALID ? e & FIB6_NH_MASK : fib6_default);
+}
+
+/*
+ * As fib4_lookup_bulk(): the tbl24 entries of a burst are prefetched
+ * all at once before the walks start.
+ */
+void
+fib6_lookup_bulk(const struct in6_addr *dst, u_int n, uint32_t *nh)
+{
+	const struct fib6_table *t;
+	uint32_t e, def;
+	u_int i, j, k;
+
+	t = fib6_local();
+	def = fib6_default;
+	if (unlikely(t->ft_tbl24 == NULL)) {
+		for (i = 0; i < n; i++)
+			nh[i] = FIB6_NONE;
+		return;
+	}
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, FIB6_BULK);
+		for (j = 0; j < k; j++)
+			rte_prefetch0(&t->ft_tbl24[fib6_tbl24_index(
+			    dst[i + j].s6_addr)]);
+		for (j = 0; j < k; j++) {
+			e = fib6_entry(t, dst[i + j].s6_addr);
+			nh[i + j] = e & FIB6_VALID ? e & FIB6_NH_MASK : def;
+		}
+	}
+}
+
+static inline void
+nhop6_key(struct nhop6_key *key, const struct in6_addr *gw,
+    struct ifnet *ifp)
+{
+
+	memset(key, 0, sizeof(*key));
+	key->nk_gw = *gw;
+	key->nk_ifp = ifp;
+}
+
+static uint32_t
+nhop6_get(const struct in6_addr *gw, struct ifnet *ifp)
+{
+	struct nhop6_key key;
+	struct nhop6 *nh;
+	uint32_t slot;
+	void *data;
+
+	nhop6_key(&key, gw, ifp);
+	if (rte_hash_lookup_data(fib6_nhopidx, &key, &data) >= 0) {
+		slot = (uint32_t)(uintptr_t)data;
+		fib6_nhops[slot].nh_refs++;
+		return (slot);
+	}
+	if (fib6_nnhop_free == 0)
+		return (FIB6_NONE);
+	slot = fib6_nhop_free[fib6_nnhop_free - 1];
+	if (rte_hash_add_key_data(fib6_nhopidx, &key,
+	    (void *)(uintptr_t)slot) < 0)
+		return (FIB6_NONE);
+	fib6_nnhop_free--;
+	nh = &fib6_nhops[slot];
+	nh->nh_gw = *gw;
+	nh->nh_ifp = ifp;
+	nh->nh_refs = 1;
+	return (slot);
+}
+
+static void nhop6_free(struct epoch_context *ctx);
+
+/*
+ * Start a grace period for a next hop no route uses any more.
+ */
+static void
+nhop6_wait(struct nhop6 *nh)
+{
+
+	nh->nh_pending = 1;
+	nh->nh_waited = nh->nh_drops;
+	epoch_call(&nh->nh_epoch, nhop6_free);
+}
+
+static void
+nhop6_free(struct epoch_context *ctx)
+{
+	struct nhop6_key key;
+	struct nhop6 *nh;
+
+	nh = epoch_containerof(ctx, struct nhop6, nh_epoch);
+	nh->nh_pending = 0;
+	/* Unless a route took it again meanwhile. */
+	if (nh->nh_refs != 0)
+		return;
+	/*
+	 * It was taken and let go again while we waited: readers may have
+	 * found it through the routes of the second round, wait for them.
+	 */
+	if (nh->nh_waited != nh->nh_drops) {
+		nhop6_wait(nh);
+		return;
+	}
+	nhop6_key(&key, &nh->nh_gw, nh->nh_ifp);
+	rte_hash_del_key(fib6_nhopidx, &key);
+	nh->nh_ifp = NULL;
+	fib6_nhop_free[fib6_nnhop_free++] = nh - fib6_nhops;
+}
+
+static void
+nhop6_put(uint32_t i)
+{
+	struct nhop6 *nh;
+
+	nh = &fib6_nhops[i];
+	if (--nh->nh_refs != 0)
+		return;
+	nh->nh_drops++;
+	if (!nh->nh_pending)
+		nhop6_wait(nh);
+}
+
+static void
+fib6_tbl8_reclaim(struct epoch_context *ctx)
+{
+	struct fib6_tbl8g *tg;
+	struct fib6_table *t;
+
+	tg = epoch_containerof(ctx, struct fib6_tbl8g, tg_epoch);
+	t = tg->tg_table;
+	t->ft_free[t->ft_nfree++] = tg - t->ft_groups;
+}
+
+static inline int
+fib6_takes(uint32_t x, uint32_t plen, int add)
+{
+
+	if (add)
+		return (!(x & FIB6_VALID) || FIB6_PLEN(x) <= plen);
+	return ((x & FIB6_VALID) && FIB6_PLEN(x) == plen);
+}
+
+/*
+ * Set entries [lo, hi) of tbl, and all those of the groups below them,
+ * to e where it takes over (add) or where a prefix of length plen had set
+ * them (delete).
+ */
+static void
+fib6_update_range(struct fib6_table *t, uint32_t *tbl, uint32_t lo,
+    uint32_t hi, uint32_t plen, uint32_t e, int add)
+{
+	uint32_t i;
+
+	for (i = lo; i < hi; i++) {
+		if (tbl[i] & FIB6_EXT)
+			fib6_update_range(t, fib6_group(t, tbl[i]), 0,
+			    FIB6_TBL8_SIZE, plen, e, add);
+		else if (fib6_takes(tbl[i], plen, add))
+			tbl[i] = e;
+	}
+}
+
+/*
+ * Apply a/plen to tbl, tbl24 at level 0, a group at the levels below,
+ * descending to the level its last bits fall in.  A group is created on
+ * the way down if missing, and let go of on the way back up once no
+ * prefix needs it any more.
+ */
+static void
+fib6_update_level(struct fib6_table *t, uint32_t *tbl, u_int level,
+    const uint8_t *a, uint32_t plen, uint32_t e, int add)
+{
+	uint32_t end, i, j, g, x, *tbl8;
+
+	if (level == 0) {
+		end = 24;
+		i = fib6_tbl24_index(a);
+	} else {
+		end = 24 + 8 * level;
+		i = a[2 + level];
+	}
+	if (plen <= end) {
+		fib6_update_range(t, tbl, i, i + (1 << (end - plen)), plen,
+		    e, add);
+		return;
+	}
+
+	x = tbl[i];
+	if (!(x & FIB6_EXT)) {
+		if (!add)
+			return;
+		/* The caller made sure of enough groups. */
+		g = t->ft_free[--t->ft_nfree];
+		tbl8 = &t->ft_tbl8[g * FIB6_TBL8_SIZE];
+		for (j = 0; j < FIB6_TBL8_SIZE; j++)
+			tbl8[j] = x;
+		fib6_update_level(t, tbl8, level + 1, a, plen, e, add);
+		rte_smp_wmb();
+		tbl[i] = FIB6_VALID | FIB6_EXT | g;
+		return;
+	}
+	g = x & FIB6_NH_MASK;
+	tbl8 = fib6_group(t, x);
+	fib6_update_level(t, tbl8, level + 1, a, plen, e, add);
+	if (add)
+		return;
+	for (j = 0; j < FIB6_TBL8_SIZE; j++)
+		if ((tbl8[j] & FIB6_EXT) ||
+		    ((tbl8[j] & FIB6_VALID) && FIB6_PLEN(tbl8[j]) > end))
+			break;
+	if (j == FIB6_TBL8_SIZE) {
+		tbl[i] = tbl8[0];
+		epoch_call(&t->ft_groups[g].tg_epoch, fib6_tbl8_reclaim);
+	}
+}
+
+static void
+fib6_update(const struct in6_addr *a, uint32_t plen, uint32_t e, int add)
+{
+	struct fib6_table *t;
+
+	for (t = fib6_tables; t < &fib6_tables[RTE_MAX_NUMA_NODES]; t++)
+		if (t->ft_tbl24 != NULL)
+			fib6_update_level(t, t->ft_tbl24, 0, a->s6_addr, plen,
+			    e, add);
+}
+
+static uint32_t
+fib6_cover(const struct in6_addr *a, uint32_t plen)
+{
+	struct fib6_key key;
+	void *data;
+	uint32_t p;
+
+	memset(&key, 0, sizeof(key));
+	for (p = plen - 1; p > 0; p--) {
+		if (fib6_nrules[p] == 0)
+			continue;
+		key.fk_addr = *a;
+		fib6_masklen(&key.fk_addr, p);
+		key.fk_plen = p;
+		if (rte_hash_lookup_data(fib6_rules, &key, &data) >= 0)
+			return (FIB6_ENTRY(p,
+			    fib6_routes[(uintptr_t)data].fr_nh));
+	}
+	return (0);
+}
+
+static inline void
+fib6_key(struct fib6_key *key, const struct in6_addr *dst, uint32_t plen)
+{
+
+	memset(key, 0, sizeof(*key));
+	key->fk_addr = *dst;
+	fib6_masklen(&key->fk_addr, plen);
+	key->fk_plen = plen;
+}
+
+/*
+ * The first of the routes to key, FIB6_NONE if none.
+ */
+static uint32_t
+fib6_head(const struct fib6_key *key)
+{
+	void *data;
+
+	if (key->fk_plen == 0)
+		return (fib6_default_head);
+	if (rte_hash_lookup_data(fib6_rules, key, &data) < 0)
+		return (FIB6_NONE);
+	return ((uint32_t)(uintptr_t)data);
+}
+
+/*
+ * Make the routes to key start at head, FIB6_NONE if there are none left,
+ * and point the entries of key to the next hop of the first, where oldnh,
+ * that of the former first, or FIB6_NONE, was.  Only adding a prefix can
+ * fail.
+ */
+static int
+fib6_set(const struct fib6_key *key, uint32_t oldnh, uint32_t head)
+{
+	uint32_t nh, plen;
+	int error;
+
+	plen = key->fk_plen;
+	nh = head != FIB6_NONE ? fib6_routes[head].fr_nh : FIB6_NONE;
+	if (plen == 0) {
+		fib6_default_head = head;
+		rte_smp_wmb();
+		fib6_default = nh;
+		return (0);
+	}
+	if (head == FIB6_NONE) {
+		rte_hash_del_key(fib6_rules, key);
+		fib6_nrules[plen]--;
+		fib6_update(&key->fk_addr, plen,
+		    fib6_cover(&key->fk_addr, plen), 0);
+		return (0);
+	}
+	error = rte_hash_add_key_data(fib6_rules, key,
+	    (void *)(uintptr_t)head);
+	if (error < 0)
+		return (-error);
+	if (oldnh == FIB6_NONE)
+		fib6_nrules[plen]++;
+	if (nh != oldnh) {
+		/* The next hop before the entries pointing to it. */
+		rte_smp_wmb();
+		fib6_update(&key->fk_addr, plen, FIB6_ENTRY(plen, nh), 1);
+	}
+	return (0);
+}
+
+/*
+ * Take route i, after prev or first, off the routes to key.
+ */
+static void
+fib6_unlink(const struct fib6_key *key, uint32_t prev, uint32_t i)
+{
+	struct fib6_route *rt;
+
+	rt = &fib6_routes[i];
+	if (prev != FIB6_NONE)
+		fib6_routes[prev].fr_next = rt->fr_next;
+	else
+		fib6_set(key, rt->fr_nh, rt->fr_next);
+	nhop6_put(rt->fr_nh);
+	rt->fr_next = fib6_route_free;
+	fib6_route_free = i;
+}
+
+int
+fib6_add(const struct in6_addr *dst, int plen, const struct in6_addr *gw,
+    struct ifnet *ifp, uint32_t metric, int replace)
+{
+	const struct fib6_table *t;
+	struct fib6_route *rt;
+	struct fib6_key key;
+	uint32_t nh, old, head, prev, i;
+	int error;
+
+	if (plen < 0 || plen > 128)
+		return (EINVAL);
+	fib6_key(&key, dst, plen);
+	head = fib6_head(&key);
+	nh = nhop6_get(gw, ifp);
+	if (nh == FIB6_NONE)
+		return (ENOSPC);
+
+	/* A route we have, or the one it replaces. */
+	for (i = head; i != FIB6_NONE; i = rt->fr_next) {
+		rt = &fib6_routes[i];
+		if (rt->fr_metric == metric && (rt->fr_nh == nh || replace))
+			break;
+	}
+	if (i != FIB6_NONE) {
+		rt->fr_gen = fib6_gen;
+		old = rt->fr_nh;
+		if (old == nh) {
+			nhop6_put(nh);
+			return (0);
+		}
+		rt->fr_nh = nh;
+		if (i == head)
+			fib6_set(&key, old, head);
+		nhop6_put(old);
+		return (0);
+	}
+
+	/* Enough groups for a whole new path down, on every socket. */
+	if (head == FIB6_NONE && plen > 24)
+		for (t = fib6_tables; t < &fib6_tables[RTE_MAX_NUMA_NODES];
+		    t++)
+			if (t->ft_tbl24 != NULL && t->ft_nfree < FIB6_LEVELS) {
+				nhop6_put(nh);
+				return (ENOSPC);
+			}
+	if (fib6_route_free == FIB6_NONE) {
+		nhop6_put(nh);
+		return (ENOSPC);
+	}
+	i = fib6_route_free;
+	rt = &fib6_routes[i];
+	fib6_route_free = rt->fr_next;
+	rt->fr_nh = nh;
+	rt->fr_metric = metric;
+	rt->fr_gen = fib6_gen;
+
+	/* After those with the same metric or a lower one. */
+	prev = FIB6_NONE;
+	for (old = head; old != FIB6_NONE &&
+	    fib6_routes[old].fr_metric <= metric;
+	    old = fib6_routes[old].fr_next)
+		prev = old;
+	rt->fr_next = old;
+	if (prev != FIB6_NONE) {
+		fib6_routes[prev].fr_next = i;
+		return (0);
+	}
+	error = fib6_set(&key,
+	    head != FIB6_NONE ? fib6_routes[head].fr_nh : FIB6_NONE, i);
+	if (error != 0) {
+		rt->fr_next = fib6_route_free;
+		fib6_route_free = i;
+		nhop6_put(nh);
+	}
+	return (error);
+}
+
+int
+fib6_delete(const struct in6_addr *dst, int plen, const struct in6_addr *gw,
+    struct ifnet *ifp, uint32_t metric)
+{
+	const struct nhop6 *nhop;
+	struct fib6_key key;
+	uint32_t prev, i;
+
+	if (plen < 0 || plen > 128)
+		return (EINVAL);
+	fib6_key(&key, dst, plen);
+	i = fib6_head(&key);
+	if (i == FIB6_NONE)
+		return (ENOENT);
+	for (prev = FIB6_NONE; i != FIB6_NONE; i = fib6_routes[i].fr_next) {
+		nhop = fib6_nhop(fib6_routes[i].fr_nh);
+		if (fib6_routes[i].fr_metric == metric &&
+		    nhop->nh_ifp == ifp && IN6_ARE_ADDR_EQUAL(&nhop->nh_gw, gw))
+			break;
+		prev = i;
+	}
+	if (i == FIB6_NONE)
+		return (ESRCH);
+	fib6_unlink(&key, prev, i);
+	return (0);
+}
+
+/*
+ * Remove the routes to key that doomed() picks.
+ */
+static void
+fib6_prune(const struct fib6_key *key,
+    int (*doomed)(const struct fib6_route *, const void *), const void *arg)
+{
+	uint32_t prev, i, next;
+
+	prev = FIB6_NONE;
+	for (i = fib6_head(key); i != FIB6_NONE; i = next) {
+		next = fib6_routes[i].fr_next;
+		if (doomed(&fib6_routes[i], arg))
+			fib6_unlink(key, prev, i);
+		else
+			prev = i;
+	}
+}
+
+/*
+ * Remove the routes that doomed() picks.  rte_hash must not lose keys
+ * while it is iterated over, so the prefixes with such routes are
+ * collected first and pruned after, all in one go unless there is no
+ * memory for the lot.
+ */
+static void
+fib6_remove_if(int (*doomed)(const struct fib6_route *, const void *),
+    const void *arg)
+{
+	struct fib6_key chunk[FIB6_BULK], *d, def;
+	const void *k;
+	void *data;
+	uint32_t next, i, n, max;
+
+	memset(&def, 0, sizeof(def));
+	fib6_prune(&def, doomed, arg);
+	for (i = max = 0; i <= 128; i++)
+		max += fib6_nrules[i];
+	if (max == 0)
+		return;
+	d = rte_malloc("fib6_doomed", max * sizeof(*d), 0);
+	if (d == NULL) {
+		d = chunk;
+		max = RTE_DIM(chunk);
+	}
+	do {
+		next = n = 0;
+		while (n < max &&
+		    rte_hash_iterate(fib6_rules, &k, &data, &next) >= 0) {
+			for (i = (uintptr_t)data; i != FIB6_NONE;
+			    i = fib6_routes[i].fr_next)
+				if (doomed(&fib6_routes[i], arg))
+					break;
+			if (i != FIB6_NONE)
+				memcpy(&d[n++], k, sizeof(d[0]));
+		}
+		for (i = 0; i < n; i++)
+			fib6_prune(&d[i], doomed, arg);
+	} while (n == max);
+	if (d != chunk)
+		rte_free(d);
+}
+
+static int
+fib6_doomed_ifp(const struct fib6_route *rt, const void *ifp)
+{
+
+	return (fib6_nhops[rt->fr_nh].nh_ifp == ifp);
+}
+
+void
+fib6_flush(struct ifnet *ifp)
+{
+
+	fib6_remove_if(fib6_doomed_ifp, ifp);
+}
+
+/*
+ * Resynchronization with the kernel: the routes not added again between
+ * fib6_mark() and fib6_sweep() go.
+ */
+void
+fib6_mark(void)
+{
+
+	fib6_gen++;
+}
+
+static int
+fib6_doomed_stale(const struct fib6_route *rt, const void *arg __rte_unused)
+{
+
+	return (rt->fr_gen != fib6_gen);
+}
+
+void
+fib6_sweep(void)
+{
+
+	fib6_remove_if(fib6_doomed_stale, NULL);
+}
@@ -0,0 +1,81 @@
+#ifndef _NETINET6_IN6_FIB_H_
+#define	_NETINET6_IN6_FIB_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "net/epoch.h"
+
+struct ifnet;
+
+/*
+ * IPv6 forwarding table, mirrored from the kernel's main routing table by
+ * core/kip_monitor.c, along the lines of netinet/in_fib.h: per NUMA
+ * socket, a tbl24 indexed by the first 24 bits of an address, then up to
+ * FIB6_LEVELS levels of 256-entry tbl8 groups, one per further byte, as
+ * in rte_lpm6, mapping prefixes to next hop indices into fib6_nhops[].
+ *
+ * Lookups are lock-free; the control lcore is the only writer, and neither
+ * a next hop nor a tbl8 group is reused before the dataplane has gone
+ * through an epoch since it was let go of.
+ */
+#define	FIB6_MAX_RULES		(1 << 20)
+#define	FIB6_TBL8_GROUPS	(1 << 16)	/* per socket */
+#define	FIB6_LEVELS		13		/* of tbl8 groups, /32 to /128 */
+#define	FIB6_MAX_NHOPS		4096
+#define	FIB6_NONE		UINT32_MAX	/* no route */
+
+struct nhop6 {
+	struct in6_addr	nh_gw;		/* unspecified when on-link */
+	struct ifnet	*nh_ifp;	/* NULL when free */
+	uint32_t	nh_refs;	/* routes through it */
+	int		nh_pending;	/* in epoch_call() */
+	uint32_t	nh_drops;	/* times nh_refs fell to 0 */
+	uint32_t	nh_waited;	/* nh_drops the grace period covers */
+	struct epoch_context nh_epoch;
+};
+
+extern struct nhop6	fib6_nhops[FIB6_MAX_NHOPS];
+
+static inline const struct nhop6 *
+fib6_nhop(uint32_t nh)
+{
+
+	return (&fib6_nhops[nh]);
+}
+
+/*
+ * Memory taken by the routes, besides the tbl24 of each socket: tbl8
+ * groups grow with the number of prefixes and how they spread.
+ */
+struct fib6_usage {
+	uint32_t	fu_rules;	/* prefixes, the default route aside */
+	uint32_t	fu_tbl8;	/* tbl8 groups in use, per socket */
+	size_t		fu_fixed;	/* bytes per socket, whatever the routes */
+	size_t		fu_per_rule;	/* tbl8 bytes per prefix, per socket */
+};
+
+int	fib6_init(void);
+void	fib6_usage(struct fib6_usage *fu);
+
+/*
+ * Dataplane: next hop index for dst, or FIB6_NONE.
+ */
+uint32_t	fib6_lookup(const struct in6_addr *dst);
+void	fib6_lookup_bulk(const struct in6_addr *dst, u_int n, uint32_t *nh);
+
+/*
+ * Control lcore only, as fib4_add() and the rest.
+ */
+int	fib6_add(const struct in6_addr *dst, int plen,
+	    const struct in6_addr *gw, struct ifnet *ifp, uint32_t metric,
+	    int replace);
+int	fib6_delete(const struct in6_addr *dst, int plen,
+	    const struct in6_addr *gw, struct ifnet *ifp, uint32_t metric);
+void	fib6_flush(struct ifnet *ifp);
+void	fib6_mark(void);
+void	fib6_sweep(void);
+
+#endif /* !_NETINET6_IN6_FIB_H_ */
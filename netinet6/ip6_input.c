@@ -0,0 +1,429 @@
+/*-
+ * Copyright (C) 1995, 1996, 1997, and 1998 WIDE Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	$KAME: ip6_input.c,v 1.259 2002/01/21 04:58:09 jinmei Exp $
+ */
+
+/*-
+ * Copyright (c) 1982, 1986, 1988, 1993
+ *	The Regents of the University of California.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 4. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	@(#)ip_input.c	8.2 (Berkeley) 1/4/94
+ * $FreeBSD$
+ */
+
+/*
+ * IPv6 input.  ip6_input_burst() works in two passes over a burst: the
+ * first validates the fixed header of every packet and sorts out those
+ * addressed to us, the second walks their extension headers and hands
+ * them to the upper layer protocol registered in ip6_protox[].  Packets
+ * for other destinations are forwarded along the routes of
+ * netinet6/in6_fib.c.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <netinet/ip6.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_mbuf.h>
+#include <rte_prefetch.h>
+
+#include "net/ethernet.h"
+#include "net/if_llatbl.h"
+#include "net/if_var.h"
+#include "net/netisr.h"
+#include "in6_fib.h"
+#include "ip6_var.h"
+#include "nd6.h"
+
+#define	IPV6_VERSION		0x60
+#define	IPV6_VERSION_MASK	0xf0
+#define	IPV6_HLIMDEC		1	/* subtracted when forwarding */
+
+#define	IP6_BURST		32
+#define	IP6_PREFETCH_OFFSET	3
+
+PCPUSTAT_DEFINE(struct ip6stat, ip6stat);
+
+volatile int	ip6_forwarding = 1;
+
+static ip6_input_t	*ip6_protox[IPPROTO_MAX];
+
+int
+ip6proto_register(uint8_t proto, ip6_input_t *input)
+{
+
+	switch (proto) {
+	case IPPROTO_HOPOPTS:
+	case IPPROTO_ROUTING:
+	case IPPROTO_DSTOPTS:
+	case IPPROTO_NONE:
+		/* Walked by ip6_input() itself. */
+		return (EPROTONOSUPPORT);
+	}
+	if (ip6_protox[proto] != NULL)
+		return (EEXIST);
+	ip6_protox[proto] = input;
+	return (0);
+}
+
+int
+ip6proto_unregister(uint8_t proto)
+{
+
+	if (ip6_protox[proto] == NULL)
+		return (ENOENT);
+	ip6_protox[proto] = NULL;
+	return (0);
+}
+
+/*
+ * Validate the fixed header of a packet, counting the reason it is bad if
+ * it is.  Trims link layer padding past the IPv6 payload.
+ */
+static inline int
+ip6_check(struct rte_mbuf *m)
+{
+	const struct ip6_hdr *ip6;
+	struct ip6_hdr ip6h;
+	uint32_t plen;
+
+	IP6STAT_INC(ip6s_total);
+
+	/* The header may span segments: copy it out if it does. */
+	ip6 = rte_pktmbuf_read(m, 0, sizeof(ip6h), &ip6h);
+	if (unlikely(ip6 == NULL)) {
+		IP6STAT_INC(ip6s_toosmall);
+		return (-1);
+	}
+	if (unlikely((ip6->ip6_vfc & IPV6_VERSION_MASK) != IPV6_VERSION)) {
+		IP6STAT_INC(ip6s_badvers);
+		return (-1);
+	}
+
+	/*
+	 * Check against address spoofing/corruption: multicast sources,
+	 * unspecified destinations, loopback and IPv4-mapped addresses do
+	 * not belong on the wire (RFC 4291, RFC 4038), nor do
+	 * interface-local multicast destinations.
+	 */
+	if (unlikely(IN6_IS_ADDR_MULTICAST(&ip6->ip6_src) ||
+	    IN6_IS_ADDR_UNSPECIFIED(&ip6->ip6_dst) ||
+	    IN6_IS_ADDR_LOOPBACK(&ip6->ip6_src) ||
+	    IN6_IS_ADDR_LOOPBACK(&ip6->ip6_dst) ||
+	    IN6_IS_ADDR_V4MAPPED(&ip6->ip6_src) ||
+	    IN6_IS_ADDR_V4MAPPED(&ip6->ip6_dst) ||
+	    IN6_IS_ADDR_MC_NODELOCAL(&ip6->ip6_dst))) {
+		IP6STAT_INC(ip6s_badscope);
+		return (-1);
+	}
+
+	plen = rte_be_to_cpu_16(ip6->ip6_plen);
+	if (unlikely(plen == 0)) {
+		/* Jumbo payload option; no jumbograms on Ethernet. */
+		IP6STAT_INC(ip6s_badoptions);
+		return (-1);
+	}
+	if (unlikely(m->pkt_len < sizeof(struct ip6_hdr) + plen)) {
+		IP6STAT_INC(ip6s_tooshort);
+		return (-1);
+	}
+	if (unlikely(m->pkt_len > sizeof(struct ip6_hdr) + plen) &&
+	    rte_pktmbuf_trim(m, m->pkt_len - sizeof(struct ip6_hdr) -
+	    plen) != 0) {
+		IP6STAT_INC(ip6s_tooshort);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * Whether a packet is for us.  Multicast is not filtered by group
+ * membership: the upper layers see all of it.
+ */
+static inline int
+ip6_islocal(const struct rte_mbuf *m)
+{
+	const struct ip6_hdr *ip6;
+	struct ip6_hdr ip6h;
+
+	ip6 = rte_pktmbuf_read(m, 0, sizeof(ip6h), &ip6h);
+	if (IN6_IS_ADDR_MULTICAST(&ip6->ip6_dst))
+		return (1);
+	return (in6_localip(&ip6->ip6_dst));
+}
+
+/*
+ * Walk the extension headers of a local packet and pass it up.  At most
+ * IP6_MAXEXTHDR of them are walked; they may span segments.  Hop-by-hop
+ * and destination options are skipped, not processed; routing headers are
+ * only accepted once exhausted, as we are not an intermediate hop of source
+ * routes.
+ */
+static void
+ip6_deliver(struct rte_mbuf *m)
+{
+	const struct ip6_ext *ip6e;
+	struct ip6_rthdr ip6eh;
+	const struct ip6_hdr *ip6;
+	struct ip6_hdr ip6h;
+	int nxt, off, nexthdrs;
+
+	ip6 = rte_pktmbuf_read(m, 0, sizeof(ip6h), &ip6h);
+	off = sizeof(struct ip6_hdr);
+	nxt = ip6->ip6_nxt;
+	for (nexthdrs = 0; nxt != IPPROTO_DONE; nexthdrs++) {
+		switch (nxt) {
+		case IPPROTO_HOPOPTS:
+			/* Only allowed right after the IPv6 header. */
+			if (nexthdrs != 0) {
+				IP6STAT_INC(ip6s_badoptions);
+				goto bad;
+			}
+			/* FALLTHROUGH */
+		case IPPROTO_DSTOPTS:
+		case IPPROTO_ROUTING:
+			if (nexthdrs == IP6_MAXEXTHDR) {
+				IP6STAT_INC(ip6s_toomanyhdr);
+				goto bad;
+			}
+			/* Extension headers are at least 8 bytes long. */
+			if (off + 8 > m->pkt_len) {
+				IP6STAT_INC(ip6s_tooshort);
+				goto bad;
+			}
+			ip6e = rte_pktmbuf_read(m, off, sizeof(ip6eh), &ip6eh);
+			if (nxt == IPPROTO_ROUTING &&
+			    ((const struct ip6_rthdr *)ip6e)->ip6r_segleft != 0) {
+				IP6STAT_INC(ip6s_badoptions);
+				goto bad;
+			}
+			off += (ip6e->ip6e_len + 1) << 3;
+			if (off > m->pkt_len) {
+				IP6STAT_INC(ip6s_tooshort);
+				goto bad;
+			}
+			nxt = ip6e->ip6e_nxt;
+			break;
+
+		case IPPROTO_NONE:
+			rte_pktmbuf_free(m);
+			return;
+
+		case IPPROTO_FRAGMENT:
+			/* No reassembly unless a protocol handles fragments. */
+			IP6STAT_INC(ip6s_fragments);
+			/* FALLTHROUGH */
+		default:
+			/* The host gets what no protocol here takes. */
+			if (ip6_protox[nxt] == NULL) {
+				IP6STAT_INC(ip6s_noproto);
+				ether_host_input(m);
+				return;
+			}
+			IP6STAT_INC(ip6s_delivered);
+			m->l3_len = off;
+			nxt = ip6_protox[nxt](&m, &off, nxt);
+			break;
+		}
+	}
+	return;
+
+bad:
+	rte_pktmbuf_free(m);
+}
+
+/*
+ * Forward a sub-burst of at most IP6_BURST packets, as ip_forward() does.
+ * Packets from or to link-local addresses do not leave their link.  Those
+ * whose hop limit runs out, and those too big for the next hop, go to the
+ * host, whose forwarding path sends the Time Exceeded or Packet Too Big.
+ */
+static void
+ip6_forward(struct rte_mbuf **m, u_int n)
+{
+	struct in6_addr dst[IP6_BURST], gw[IP6_BURST];
+	struct ifnet *ifp[IP6_BURST];
+	struct llentry *lle[IP6_BURST];
+	uint32_t nh[IP6_BURST];
+	const struct nhop6 *nhop;
+	struct ip6_hdr *ip6;
+	u_int i, k;
+
+	if (unlikely(!ip6_forwarding)) {
+		for (i = 0; i < n; i++)
+			ether_host_input(m[i]);
+		return;
+	}
+	for (i = k = 0; i < n; i++) {
+		ip6 = rte_pktmbuf_mtod(m[i], struct ip6_hdr *);
+		if (unlikely(m[i]->data_len < sizeof(struct ip6_hdr))) {
+			IP6STAT_INC(ip6s_cantforward);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (unlikely(IN6_IS_ADDR_LINKLOCAL(&ip6->ip6_src) ||
+		    IN6_IS_ADDR_LINKLOCAL(&ip6->ip6_dst))) {
+			IP6STAT_INC(ip6s_badscope);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (unlikely(ip6->ip6_hlim <= IPV6_HLIMDEC)) {
+			IP6STAT_INC(ip6s_cantforward);
+			ether_host_input(m[i]);
+			continue;
+		}
+		dst[k] = ip6->ip6_dst;
+		m[k++] = m[i];
+	}
+	fib6_lookup_bulk(dst, k, nh);
+
+	for (i = 0, n = k, k = 0; i < n; i++) {
+		nhop = nh[i] == FIB6_NONE ? NULL : fib6_nhop(nh[i]);
+		if (unlikely(nhop == NULL || nhop->nh_ifp == NULL)) {
+			IP6STAT_INC(ip6s_noroute);
+			rte_pktmbuf_free(m[i]);
+			continue;
+		}
+		if (unlikely(rte_pktmbuf_pkt_len(m[i]) > nhop->nh_ifp->if_mtu)) {
+			IP6STAT_INC(ip6s_cantfrag);
+			ether_host_input(m[i]);
+			continue;
+		}
+		ip6 = rte_pktmbuf_mtod(m[i], struct ip6_hdr *);
+		ip6->ip6_hlim -= IPV6_HLIMDEC;
+		m[i]->ol_flags = 0;
+
+		ifp[k] = nhop->nh_ifp;
+		gw[k] = IN6_IS_ADDR_UNSPECIFIED(&nhop->nh_gw) ? dst[i] :
+		    nhop->nh_gw;
+		m[k++] = m[i];
+	}
+	lla_lookup_bulk(AF_INET6, gw, k, lle);
+
+	IP6STAT_ADD(ip6s_forward, k);
+	for (i = 0; i < k; i++) {
+		if (likely(lle[i] != NULL && (lle[i]->la_flags & LLE_VALID)))
+			(void)ether_output(lle[i]->lle_ifp, m[i],
+			    &lle[i]->lle_l2tmpl);
+		else
+			(void)nd6_resolve(ifp[i], m[i], &gw[i]);
+	}
+}
+
+void
+ip6_input(struct rte_mbuf *m)
+{
+
+	if (ip6_check(m) != 0) {
+		rte_pktmbuf_free(m);
+		return;
+	}
+	if (!ip6_islocal(m)) {
+		ip6_forward(&m, 1);
+		return;
+	}
+	ip6_deliver(m);
+}
+
+void
+ip6_input_burst(struct rte_mbuf **m, u_int n)
+{
+	struct rte_mbuf *local[IP6_BURST], *fwd[IP6_BURST];
+	u_int i, j, k, nl, nf;
+
+	for (i = 0; i < n; i += k) {
+		k = RTE_MIN(n - i, IP6_BURST);
+
+		for (j = 0; j < k && j < IP6_PREFETCH_OFFSET; j++)
+			rte_prefetch0(rte_pktmbuf_mtod(m[i + j], void *));
+		for (j = nl = nf = 0; j < k; j++) {
+			if (j + IP6_PREFETCH_OFFSET < k)
+				rte_prefetch0(rte_pktmbuf_mtod(
+				    m[i + j + IP6_PREFETCH_OFFSET], void *));
+			if (ip6_check(m[i + j]) != 0) {
+				rte_pktmbuf_free(m[i + j]);
+				continue;
+			}
+			if (!ip6_islocal(m[i + j])) {
+				fwd[nf++] = m[i + j];
+				continue;
+			}
+			local[nl++] = m[i + j];
+		}
+
+		for (j = 0; j < nl; j++)
+			ip6_deliver(local[j]);
+		if (nf != 0)
+			ip6_forward(fwd, nf);
+	}
+}
+
+static const struct netisr_handler ip6_nh = {
+	.nh_name = "ip6",
+	.nh_handler = ip6_input,
+	.nh_bhandler = ip6_input_burst,
+	.nh_proto = NETISR_IPV6,
+	.nh_policy = NETISR_POLICY_SOURCE,
+	.nh_dispatch = NETISR_DISPATCH_DIRECT,
+};
+
+void
+ip6_init(void)
+{
+
+	netisr_register(&ip6_nh);
+}
@@ -0,0 +1,110 @@
+/*-
+ * Copyright (C) 1995, 1996, 1997, and 1998 WIDE Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	$KAME: ip6_var.h,v 1.62 2001/05/03 14:51:48 itojun Exp $
+ * $FreeBSD$
+ */
+
+#ifndef _NETINET6_IP6_VAR_H_
+#define	_NETINET6_IP6_VAR_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "net/pcpustat.h"
+
+struct rte_mbuf;
+
+struct	ip6stat {
+	uint64_t ip6s_total;		/* total packets received */
+	uint64_t ip6s_tooshort;		/* packet too short */
+	uint64_t ip6s_toosmall;		/* not enough data */
+	uint64_t ip6s_fragments;	/* fragments received */
+	uint64_t ip6s_cantforward;	/* packets rcvd for unreachable dest */
+	uint64_t ip6s_badoptions;	/* error in option processing */
+	uint64_t ip6s_badvers;		/* ip6 version != 6 */
+	uint64_t ip6s_delivered;	/* datagrams delivered to upper level*/
+	uint64_t ip6s_toomanyhdr;	/* discarded due to too many headers */
+	uint64_t ip6s_badscope;		/* scope error */
+	uint64_t ip6s_noproto;		/* unknown or unsupported protocol */
+	uint64_t ip6s_forward;		/* packets forwarded */
+	uint64_t ip6s_noroute;		/* packets discarded due to no route */
+	uint64_t ip6s_cantfrag;		/* packets too big to forward */
+};
+
+/*
+ * Statistics are per-lcore, see net/pcpustat.h.
+ */
+PCPUSTAT_DECLARE(struct ip6stat, ip6stat);
+
+#define	IP6STAT_ADD(name, val)	PCPUSTAT_ADD(ip6stat, name, (val))
+#define	IP6STAT_SUB(name, val)	IP6STAT_ADD(name, -(val))
+#define	IP6STAT_INC(name)	IP6STAT_ADD(name, 1)
+#define	IP6STAT_DEC(name)	IP6STAT_SUB(name, 1)
+#define	IP6STAT_FETCH(dst)	PCPUSTAT_FETCH(struct ip6stat, ip6stat, (dst))
+
+/*
+ * Maximum number of extension headers walked before the upper layer
+ * protocol, bounding the per-packet cost of ip6_input().
+ */
+#define	IP6_MAXEXTHDR	8
+
+#define	IPPROTO_DONE	257		/* all job for this packet are done */
+
+/*
+ * Upper layer input: called with the IPv6 header at the front of *mp and
+ * *offp the offset of the protocol's header; returns the next header to
+ * process, or IPPROTO_DONE once the packet is consumed.
+ */
+typedef int	ip6_input_t(struct rte_mbuf **mp, int *offp, int proto);
+
+int	ip6proto_register(uint8_t proto, ip6_input_t *input);
+int	ip6proto_unregister(uint8_t proto);
+
+/*
+ * IPv6 forwarding, on unless the kernel's net.ipv6.conf.all.forwarding
+ * says otherwise, see core/kip_monitor.c.  While it is off, packets not
+ * for us go to the host, and our neighbour advertisements do not claim
+ * to be a router's.
+ */
+extern volatile int	ip6_forwarding;
+
+void	ip6_init(void);
+void	ip6_input(struct rte_mbuf *m);
+void	ip6_input_burst(struct rte_mbuf **m, u_int n);
+
+/*
+ * Local addresses, see in6.c.  Updates are for the control lcore only.
+ */
+int	in6_addlocal(const struct in6_addr *addr);
+int	in6_dellocal(const struct in6_addr *addr);
+int	in6_localip(const struct in6_addr *addr);
+void	in6_local_mark(void);
+void	in6_local_sweep(void);
+
+#endif /* !_NETINET6_IP6_VAR_H_ */
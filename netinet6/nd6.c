@@ -0,0 +1,768 @@
+/*-
+ * Copyright (C) 1995, 1996, 1997, and 1998 WIDE Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	$KAME: nd6_nbr.c,v 1.86 2002/01/21 02:33:04 jinmei Exp $
+ * $FreeBSD$
+ */
+
+
+/*
+ * IPv6 neighbour discovery (RFC 4861) on Ethernet, the counterpart of ARP
+ * in net/if_ether.c.  Runs on the receiving lcore: a solicitation for an
+ * address we own is answered right there, the advertisement being built
+ * in place in the solicitation's mbuf, its checksum updated from the
+ * fields that change (RFC 1624) rather than summed over again.  What
+ * solicitations and advertisements tell about neighbours goes to the
+ * control lcore, the neighbour tables' only writer, which applies it
+ * from nd6_poll(), as it resolves the next hops nd6_resolve() does not
+ * know.  All other ICMPv6, and the solicitations and advertisements not
+ * answered here, go on to the host, which does router discovery and
+ * resolves the neighbours it talks to itself.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <sys/queue.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip6.h>
+#include <netinet/icmp6.h>
+
+#include <rte_branch_prediction.h>
+#include <rte_byteorder.h>
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_lcore.h>
+#include <rte_malloc.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+
+#include "net/ethernet.h"
+#include "net/if_var.h"
+#include "net/if_llatbl.h"
+#include "ip6_var.h"
+#include "nd6.h"
+
+#define	ND6_LEARNQ_LEN	1024	/* neighbours awaiting the control lcore */
+#define	ND6_MISSQ_LEN	1024	/* packets to unknown next hops, likewise */
+#define	ND6_POLL_BURST	32
+#define	ND6_NB_MBUF	2047	/* for the above and the NS we originate */
+#define	ND6_MAXQUERIES	1024	/* next hops being resolved at once */
+
+PCPUSTAT_DEFINE(struct nd6stat, nd6stat);
+
+/*
+ * What the dataplane passes to the control lcore, in the data of an
+ * nd6_pool mbuf: the link-layer address of a neighbour, along with the
+ * receiving port and tags as if_rcvif() goes by, or a packet to a next
+ * hop nd6_resolve() found no entry for.
+ */
+struct nd6_learn {
+	struct in6_addr		nl_addr;
+	struct ether_addr	nl_lladdr;
+	uint8_t			nl_create;	/* else only update an entry */
+};
+
+struct nd6_miss {
+	struct in6_addr		nm_addr;
+	struct ifnet		*nm_ifp;
+	struct rte_mbuf		*nm_m;
+};
+
+static struct rte_ring	*nd6_learnq;
+static struct rte_ring	*nd6_missq;
+static struct rte_mempool	*nd6_pool;
+
+/*
+ * Next hops being resolved, control lcore only, as for ARP: solicitations
+ * go out every ND6_RETRANS_TIMER ms until the entry resolves or
+ * ND6_MAX_MULTICAST_SOLICIT of them went unanswered.
+ */
+struct nd6_query {
+	TAILQ_ENTRY(nd6_query) nq_link;
+	struct in6_addr	nq_addr;
+	struct ifnet	*nq_ifp;
+	u_int		nq_asked;	/* solicitations sent */
+	uint64_t	nq_next;	/* TSC of the next one */
+};
+
+static TAILQ_HEAD(, nd6_query)	nd6_queries =
+    TAILQ_HEAD_INITIALIZER(nd6_queries);
+static u_int	nd6_nqueries;
+
+static const struct in6_addr	nd6_allnodes = {{{
+	0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01
+}}};
+
+static const struct ether_addr	nd6_allnodes_ll = {
+	.addr_bytes = { 0x33, 0x33, 0x00, 0x00, 0x00, 0x01 }
+};
+
+/* The first 13 bytes of solicited-node multicast addresses. */
+static const uint8_t	nd6_solnode_prefix[13] = {
+	0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xff
+};
+
+static inline uint16_t
+nd6_cksum_fold(uint32_t sum)
+{
+
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+	return ((uint16_t)sum);
+}
+
+/*
+ * One's complement sum of the pseudo-header and of ICMPv6 message icmp6,
+ * len bytes long, checksum field included: 0xffff when it is right.
+ */
+static uint16_t
+nd6_cksum(const struct ip6_hdr *ip6, const void *icmp6, uint16_t len)
+{
+	uint32_t sum;
+
+	sum = rte_raw_cksum(&ip6->ip6_src, 2 * sizeof(struct in6_addr));
+	sum += rte_cpu_to_be_16(len) + rte_cpu_to_be_16(IPPROTO_ICMPV6);
+	sum += rte_raw_cksum(icmp6, len);
+	return (nd6_cksum_fold(sum));
+}
+
+/*
+ * Find the link-layer address option of type type among the len bytes of
+ * options at opt; *lladdr is NULL if there is none.  Fails on malformed
+ * options.
+ */
+static int
+nd6_options(const uint8_t *opt, u_int len, uint8_t type,
+    const struct ether_addr **lladdr)
+{
+	const struct nd_opt_hdr *oh;
+	u_int olen;
+
+	*lladdr = NULL;
+	while (len > 0) {
+		if (len < sizeof(*oh))
+			return (-1);
+		oh = (const struct nd_opt_hdr *)opt;
+		olen = oh->nd_opt_len << 3;
+		if (olen == 0 || olen > len)
+			return (-1);
+		if (oh->nd_opt_type == type) {
+			if (olen < sizeof(*oh) + ETHER_ADDR_LEN)
+				return (-1);
+			*lladdr = (const struct ether_addr *)(oh + 1);
+		}
+		opt += olen;
+		len -= olen;
+	}
+	return (0);
+}
+
+/*
+ * Whether we answer for addr on ifp: it is one of ifp's addresses, or a
+ * local address of the box.
+ */
+static int
+nd6_owned(const struct ifnet *ifp, const struct in6_addr *addr)
+{
+	u_int i;
+
+	for (i = 0; i < ifp->if_naddrs6; i++)
+		if (IN6_ARE_ADDR_EQUAL(&ifp->if_in6addrs[i].ia6_addr, addr))
+			return (1);
+	return (in6_localip(addr));
+}
+
+/*
+ * Pass what m told about neighbour addr to the control lcore.  With
+ * create unset, only an entry the table already has is updated.
+ */
+static void
+nd6_learn(const struct rte_mbuf *m, const struct in6_addr *addr,
+    const struct ether_addr *lladdr, int create)
+{
+	struct nd6_learn *nl;
+	struct rte_mbuf *n;
+
+	n = rte_pktmbuf_alloc(nd6_pool);
+	if (n == NULL)
+		return;
+	nl = (struct nd6_learn *)rte_pktmbuf_append(n, sizeof(*nl));
+	nl->nl_addr = *addr;
+	ether_addr_copy(lladdr, &nl->nl_lladdr);
+	nl->nl_create = create;
+	n->port = m->port;
+	n->ol_flags = m->ol_flags & (PKT_RX_VLAN_PKT | PKT_RX_QINQ_PKT);
+	n->vlan_tci = m->vlan_tci;
+	n->vlan_tci_outer = m->vlan_tci_outer;
+	if (rte_ring_mp_enqueue(nd6_learnq, n) != 0)
+		rte_pktmbuf_free(n);
+}
+
+/*
+ * Turn the solicitation in m, len bytes of ICMPv6, into the advertisement
+ * answering it, in place, and send that to lladdr through this lcore's TX
+ * queue.  Only the fields that change go into the checksum: addresses,
+ * length, type, flags and options.
+ */
+static void
+nd6_na_reply(struct ifnet *ifp, struct rte_mbuf *m, u_int len,
+    const struct ether_addr *lladdr)
+{
+	struct nd_neighbor_solicit *ns;
+	struct nd_neighbor_advert *na;
+	struct nd_opt_hdr *opt;
+	struct ether_l2tmpl t;
+	struct ether_addr dst;
+	struct ip6_hdr *ip6;
+	uint32_t sum;
+	uint16_t plen;
+	int dad;
+
+	ip6 = rte_pktmbuf_mtod(m, struct ip6_hdr *);
+	ns = (struct nd_neighbor_solicit *)(ip6 + 1);
+	dad = IN6_IS_ADDR_UNSPECIFIED(&ip6->ip6_src);
+	/* lladdr may point into the options about to be overwritten. */
+	ether_addr_copy(lladdr, &dst);
+
+	sum = (uint16_t)~ns->nd_ns_cksum;
+	sum += (uint16_t)~rte_raw_cksum(&ip6->ip6_src,
+	    2 * sizeof(struct in6_addr));
+	sum += (uint16_t)~rte_cpu_to_be_16(len);
+	sum += (uint16_t)~rte_raw_cksum(ns, 2);
+	sum += (uint16_t)~rte_raw_cksum(&ns->nd_ns_reserved, 4);
+	sum += (uint16_t)~rte_raw_cksum(ns + 1, len - sizeof(*ns));
+
+	plen = sizeof(*na) + sizeof(*opt) + ETHER_ADDR_LEN;
+	if (len < plen) {
+		if (rte_pktmbuf_append(m, plen - len) == NULL) {
+			rte_pktmbuf_free(m);
+			return;
+		}
+	} else if (len > plen)
+		rte_pktmbuf_trim(m, len - plen);
+
+	/* A duplicate address detection probe is answered to all nodes. */
+	ip6->ip6_dst = dad ? nd6_allnodes : ip6->ip6_src;
+	ip6->ip6_src = ns->nd_ns_target;
+	ip6->ip6_plen = rte_cpu_to_be_16(plen);
+	na = (struct nd_neighbor_advert *)ns;
+	na->nd_na_type = ND_NEIGHBOR_ADVERT;
+	na->nd_na_flags_reserved = dad ? ND_NA_FLAG_OVERRIDE :
+	    ND_NA_FLAG_SOLICITED | ND_NA_FLAG_OVERRIDE;
+	/* Hosts routing through us drop us as a router if R goes missing. */
+	if (ip6_forwarding)
+		na->nd_na_flags_reserved |= ND_NA_FLAG_ROUTER;
+	opt = (struct nd_opt_hdr *)(na + 1);
+	opt->nd_opt_type = ND_OPT_TARGET_LINKADDR;
+	opt->nd_opt_len = 1;
+	memcpy(opt + 1, &ifp->if_addr, ETHER_ADDR_LEN);
+
+	sum += rte_raw_cksum(&ip6->ip6_src, 2 * sizeof(struct in6_addr));
+	sum += rte_cpu_to_be_16(plen);
+	sum += rte_raw_cksum(na, 2);
+	sum += rte_raw_cksum(&na->nd_na_flags_reserved, 4);
+	sum += rte_raw_cksum(opt, plen - sizeof(*na));
+	na->nd_na_cksum = (uint16_t)~nd6_cksum_fold(sum);
+
+	/* The solicitation's stripped tags and RX flags do not apply. */
+	m->ol_flags = 0;
+	ether_l2tmpl_set(&t, ifp, &dst, ETHER_TYPE_IPv6);
+	if (ether_output(ifp, m, &t) == 0)
+		ND6STAT_INC(nd6s_txna);
+}
+
+/*
+ * A solicitation for an address we own is answered; one with the
+ * sender's link-layer address also tells us where the sender is, which
+ * the table learns unless it already knows.  A unicast solicitation
+ * without it is answered where the table says the sender is, if it says;
+ * otherwise, and for targets we do not own, the host answers.
+ */
+static void
+nd6_ns_input(struct ifnet *ifp, struct rte_mbuf *m, u_int len)
+{
+	const struct nd_neighbor_solicit *ns;
+	const struct ether_addr *lladdr;
+	const struct ip6_hdr *ip6;
+	struct llentry *lle;
+	int dad;
+
+	ND6STAT_INC(nd6s_rxns);
+	ip6 = rte_pktmbuf_mtod(m, const struct ip6_hdr *);
+	ns = (const struct nd_neighbor_solicit *)(ip6 + 1);
+	if (len < sizeof(*ns) || IN6_IS_ADDR_MULTICAST(&ns->nd_ns_target) ||
+	    nd6_options((const uint8_t *)(ns + 1), len - sizeof(*ns),
+	    ND_OPT_SOURCE_LINKADDR, &lladdr) != 0)
+		goto bad;
+	dad = IN6_IS_ADDR_UNSPECIFIED(&ip6->ip6_src);
+	if (dad && (lladdr != NULL || memcmp(&ip6->ip6_dst,
+	    nd6_solnode_prefix, sizeof(nd6_solnode_prefix)) != 0))
+		goto bad;
+	if (!nd6_owned(ifp, &ns->nd_ns_target))
+		goto host;
+
+	if (dad)
+		lladdr = &nd6_allnodes_ll;
+	else {
+		lle = lla_lookup(AF_INET6, &ip6->ip6_src);
+		if (lladdr != NULL) {
+			if (lle == NULL || ((lle->la_flags & LLE_STATIC) == 0 &&
+			    (lle->lle_ifp != ifp ||
+			    !is_same_ether_addr(&lle->ll_addr, lladdr) ||
+			    lla_expired(lle))))
+				nd6_learn(m, &ip6->ip6_src, lladdr, 1);
+		} else if (lle != NULL && (lle->la_flags & LLE_VALID))
+			lladdr = &lle->ll_addr;
+		else
+			goto host;
+	}
+	nd6_na_reply(ifp, m, len, lladdr);
+	return;
+
+host:
+	ether_host_input(m);
+	return;
+
+bad:
+	ND6STAT_INC(nd6s_badmsg);
+	rte_pktmbuf_free(m);
+}
+
+/*
+ * An advertisement updates the entry of its target, if the table has
+ * one: an incomplete entry resolves, a complete one changes only if the
+ * advertisement overrides it, and is confirmed by a solicited one, which
+ * need not repeat the link-layer address.  The host gets it either way,
+ * as it may be resolving the target too.
+ */
+static void
+nd6_na_input(struct ifnet *ifp, struct rte_mbuf *m, u_int len)
+{
+	const struct nd_neighbor_advert *na;
+	const struct ether_addr *lladdr;
+	const struct ip6_hdr *ip6;
+	struct llentry *lle;
+	int same;
+
+	ND6STAT_INC(nd6s_rxna);
+	ip6 = rte_pktmbuf_mtod(m, const struct ip6_hdr *);
+	na = (const struct nd_neighbor_advert *)(ip6 + 1);
+	if (len < sizeof(*na) || IN6_IS_ADDR_MULTICAST(&na->nd_na_target) ||
+	    (IN6_IS_ADDR_MULTICAST(&ip6->ip6_dst) &&
+	    (na->nd_na_flags_reserved & ND_NA_FLAG_SOLICITED)) ||
+	    nd6_options((const uint8_t *)(na + 1), len - sizeof(*na),
+	    ND_OPT_TARGET_LINKADDR, &lladdr) != 0) {
+		ND6STAT_INC(nd6s_badmsg);
+		rte_pktmbuf_free(m);
+		return;
+	}
+	lle = lla_lookup(AF_INET6, &na->nd_na_target);
+	if (lle != NULL && lladdr == NULL && (lle->la_flags & LLE_VALID))
+		lladdr = &lle->ll_addr;
+	if (lle != NULL && lladdr != NULL &&
+	    (lle->la_flags & LLE_STATIC) == 0) {
+		same = lle->lle_ifp == ifp &&
+		    is_same_ether_addr(&lle->ll_addr, lladdr);
+		if (!(lle->la_flags & LLE_VALID) ||
+		    ((na->nd_na_flags_reserved & ND_NA_FLAG_OVERRIDE) &&
+		    !same) ||
+		    ((na->nd_na_flags_reserved & ND_NA_FLAG_SOLICITED) &&
+		    same && lla_expired(lle)))
+			nd6_learn(m, &na->nd_na_target, lladdr, 0);
+	}
+	ether_host_input(m);
+}
+
+/*
+ * ICMPv6 input.  Neighbour solicitations and advertisements are looked at
+ * here, provided they are contiguous and come with no extension headers,
+ * which neighbour discovery has no use for; the rest of ICMPv6 goes to the
+ * host.
+ */
+static int
+nd6_input(struct rte_mbuf **mp, int *offp, int proto)
+{
+	const struct icmp6_hdr *icmp6;
+	const struct ip6_hdr *ip6;
+	struct rte_mbuf *m;
+	struct ifnet *ifp;
+	u_int len;
+
+	m = *mp;
+	*mp = NULL;
+	ifp = m_rcvif(m);
+	if (ifp == NULL)
+		goto drop;
+	ip6 = rte_pktmbuf_mtod(m, const struct ip6_hdr *);
+	icmp6 = (const struct icmp6_hdr *)(ip6 + 1);
+	len = m->pkt_len - sizeof(*ip6);
+	if (*offp != sizeof(*ip6) || m->data_len != m->pkt_len ||
+	    len < sizeof(*icmp6) ||
+	    (icmp6->icmp6_type != ND_NEIGHBOR_SOLICIT &&
+	    icmp6->icmp6_type != ND_NEIGHBOR_ADVERT)) {
+		ND6STAT_INC(nd6s_noproto);
+		ether_host_input(m);
+		return (IPPROTO_DONE);
+	}
+	/* Off-link senders cannot get here with a hop limit of 255. */
+	if (ip6->ip6_hlim != 255 || icmp6->icmp6_code != 0) {
+		ND6STAT_INC(nd6s_badmsg);
+		goto drop;
+	}
+	if (nd6_cksum(ip6, icmp6, len) != 0xffff) {
+		ND6STAT_INC(nd6s_checksum);
+		goto drop;
+	}
+
+	if (icmp6->icmp6_type == ND_NEIGHBOR_SOLICIT)
+		nd6_ns_input(ifp, m, len);
+	else
+		nd6_na_input(ifp, m, len);
+	return (IPPROTO_DONE);
+
+drop:
+	rte_pktmbuf_free(m);
+	return (IPPROTO_DONE);
+}
+
+/*
+ * Send m to next hop dst on ifp, resolving dst first if need be, as
+ * arpresolve() does.  Consumes m.
+ */
+int
+nd6_resolve(struct ifnet *ifp, struct rte_mbuf *m, const struct in6_addr *dst)
+{
+	struct llentry *lle;
+	struct nd6_miss *nm;
+	struct rte_mbuf *n;
+
+	lle = lla_lookup(AF_INET6, dst);
+	if (likely(lle != NULL && (lle->la_flags & LLE_VALID)))
+		return (ether_output(lle->lle_ifp, m, &lle->lle_l2tmpl));
+	if (lle != NULL) {
+		if (lla_hold(lle, m) != 0) {
+			ND6STAT_INC(nd6s_dropped);
+			return (ENOBUFS);
+		}
+		return (0);
+	}
+
+	/* The next hop does not fit in the packet's mbuf; wrap it. */
+	n = rte_pktmbuf_alloc(nd6_pool);
+	if (n == NULL)
+		goto drop;
+	nm = (struct nd6_miss *)rte_pktmbuf_append(n, sizeof(*nm));
+	nm->nm_addr = *dst;
+	nm->nm_ifp = ifp;
+	nm->nm_m = m;
+	if (rte_ring_mp_enqueue(nd6_missq, n) != 0) {
+		rte_pktmbuf_free(n);
+		goto drop;
+	}
+	return (0);
+
+drop:
+	ND6STAT_INC(nd6s_dropped);
+	rte_pktmbuf_free(m);
+	return (ENOBUFS);
+}
+
+static int
+nd6_prefix_match(const struct in6_addr *a, const struct in6_addr *b,
+    u_int plen)
+{
+	u_int bytes, bits;
+
+	bytes = plen / 8;
+	bits = plen % 8;
+	if (memcmp(a, b, bytes) != 0)
+		return (0);
+	return (bits == 0 || ((a->s6_addr[bytes] ^ b->s6_addr[bytes]) &
+	    (0xff << (8 - bits))) == 0);
+}
+
+/*
+ * Our address on ifp to solicit dst from: one on dst's prefix if there
+ * is one, the first otherwise.
+ */
+static int
+nd6_srcaddr(const struct ifnet *ifp, const struct in6_addr *dst,
+    struct in6_addr *src)
+{
+	u_int i;
+
+	if (ifp->if_naddrs6 == 0)
+		return (EADDRNOTAVAIL);
+	*src = ifp->if_in6addrs[0].ia6_addr;
+	for (i = 0; i < ifp->if_naddrs6; i++) {
+		if (nd6_prefix_match(&ifp->if_in6addrs[i].ia6_addr, dst,
+		    ifp->if_in6addrs[i].ia6_plen)) {
+			*src = ifp->if_in6addrs[i].ia6_addr;
+			break;
+		}
+	}
+	return (0);
+}
+
+/*
+ * Multicast a solicitation for tgt on ifp, to its solicited-node group.
+ */
+static void
+nd6_ns_output(struct ifnet *ifp, const struct in6_addr *tgt)
+{
+	struct nd_neighbor_solicit *ns;
+	struct nd_opt_hdr *opt;
+	struct ether_l2tmpl t;
+	struct ether_addr dst;
+	struct ip6_hdr *ip6;
+	struct rte_mbuf *m;
+	uint16_t plen;
+
+	m = rte_pktmbuf_alloc(nd6_pool);
+	if (m == NULL)
+		return;
+	plen = sizeof(*ns) + sizeof(*opt) + ETHER_ADDR_LEN;
+	ip6 = (struct ip6_hdr *)rte_pktmbuf_append(m, sizeof(*ip6) + plen);
+	if (nd6_srcaddr(ifp, tgt, &ip6->ip6_src) != 0) {
+		rte_pktmbuf_free(m);
+		return;
+	}
+	ip6->ip6_flow = htonl(6 << 28);
+	ip6->ip6_plen = htons(plen);
+	ip6->ip6_nxt = IPPROTO_ICMPV6;
+	ip6->ip6_hlim = 255;
+	memcpy(&ip6->ip6_dst, nd6_solnode_prefix, sizeof(nd6_solnode_prefix));
+	memcpy(&ip6->ip6_dst.s6_addr[13], &tgt->s6_addr[13], 3);
+
+	ns = (struct nd_neighbor_solicit *)(ip6 + 1);
+	memset(ns, 0, sizeof(*ns));
+	ns->nd_ns_type = ND_NEIGHBOR_SOLICIT;
+	ns->nd_ns_target = *tgt;
+	opt = (struct nd_opt_hdr *)(ns + 1);
+	opt->nd_opt_type = ND_OPT_SOURCE_LINKADDR;
+	opt->nd_opt_len = 1;
+	memcpy(opt + 1, &ifp->if_addr, ETHER_ADDR_LEN);
+	ns->nd_ns_cksum = (uint16_t)~nd6_cksum(ip6, ns, plen);
+
+	dst.addr_bytes[0] = 0x33;
+	dst.addr_bytes[1] = 0x33;
+	memcpy(&dst.addr_bytes[2], &ip6->ip6_dst.s6_addr[12], 4);
+	ether_l2tmpl_set(&t, ifp, &dst, ETHER_TYPE_IPv6);
+	if (ether_output(ifp, m, &t) == 0)
+		ND6STAT_INC(nd6s_txns);
+}
+
+/*
+ * Start resolving dst on ifp.
+ */
+static int
+nd6_query(struct ifnet *ifp, const struct in6_addr *dst)
+{
+	struct nd6_query *nq;
+	int error;
+
+	if (nd6_nqueries == ND6_MAXQUERIES)
+		return (ENOBUFS);
+	nq = rte_zmalloc("nd6_query", sizeof(*nq), 0);
+	if (nq == NULL)
+		return (ENOMEM);
+	error = lla_create(AF_INET6, ifp, dst);
+	if (error != 0) {
+		rte_free(nq);
+		return (error);
+	}
+	nq->nq_addr = *dst;
+	nq->nq_ifp = ifp;
+	nq->nq_asked = 1;
+	nq->nq_next = rte_get_timer_cycles() +
+	    rte_get_timer_hz() * ND6_RETRANS_TIMER / 1000;
+	TAILQ_INSERT_TAIL(&nd6_queries, nq, nq_link);
+	nd6_nqueries++;
+	nd6_ns_output(ifp, dst);
+	return (0);
+}
+
+/*
+ * Retransmit solicitations that are due, and retire queries that
+ * resolved or timed out.
+ */
+static void
+nd6_timer(void)
+{
+	struct nd6_query *nq, *next;
+	struct llentry *lle;
+	uint64_t now;
+
+	now = rte_get_timer_cycles();
+	for (nq = TAILQ_FIRST(&nd6_queries); nq != NULL; nq = next) {
+		next = TAILQ_NEXT(nq, nq_link);
+		lle = lla_lookup(AF_INET6, &nq->nq_addr);
+		if (lle == NULL || (lle->la_flags & LLE_VALID))
+			goto done;
+		if (now < nq->nq_next)
+			continue;
+		if (nq->nq_asked == ND6_MAX_MULTICAST_SOLICIT) {
+			ND6STAT_INC(nd6s_timeouts);
+			lla_delete(AF_INET6, &nq->nq_addr);
+			goto done;
+		}
+		nd6_ns_output(nq->nq_ifp, &nq->nq_addr);
+		nq->nq_asked++;
+		nq->nq_next = now + rte_get_timer_hz() * ND6_RETRANS_TIMER /
+		    1000;
+		continue;
+done:
+		TAILQ_REMOVE(&nd6_queries, nq, nq_link);
+		nd6_nqueries--;
+		rte_free(nq);
+	}
+}
+
+/*
+ * Solicit again an entry nothing confirmed for ND6_MAXAGE, see
+ * lla_timer().
+ */
+static void
+nd6_probe(const struct llentry *lle)
+{
+
+	nd6_ns_output(lle->lle_ifp, &lle->r_l3addr.addr6);
+}
+
+/*
+ * Packets held on an entry that was replaced or deleted: send them with
+ * the entry now in the table, if it resolved.
+ */
+static void
+nd6_held(const struct llentry *old, struct rte_mbuf **m, u_int n)
+{
+	struct llentry *lle;
+	u_int i;
+
+	lle = lla_lookup(AF_INET6, &old->r_l3addr.addr6);
+	if (lle == NULL || !(lle->la_flags & LLE_VALID)) {
+		ND6STAT_ADD(nd6s_dropped, n);
+		for (i = 0; i < n; i++)
+			rte_pktmbuf_free(m[i]);
+		return;
+	}
+	for (i = 0; i < n; i++)
+		ether_output(lle->lle_ifp, m[i], &lle->lle_l2tmpl);
+}
+
+/*
+ * A packet nd6_resolve() found no entry for, wrapped in n.
+ */
+static void
+nd6_miss(struct rte_mbuf *n)
+{
+	const struct nd6_miss *nm;
+	struct llentry *lle;
+	struct rte_mbuf *m;
+
+	nm = rte_pktmbuf_mtod(n, const struct nd6_miss *);
+	m = nm->nm_m;
+	lle = lla_lookup(AF_INET6, &nm->nm_addr);
+	if (lle == NULL && nd6_query(nm->nm_ifp, &nm->nm_addr) == 0)
+		lle = lla_lookup(AF_INET6, &nm->nm_addr);
+	rte_pktmbuf_free(n);
+	if (lle == NULL) {
+		ND6STAT_INC(nd6s_dropped);
+		rte_pktmbuf_free(m);
+	} else if (lle->la_flags & LLE_VALID)
+		ether_output(lle->lle_ifp, m, &lle->lle_l2tmpl);
+	else if (lla_hold(lle, m) != 0)
+		ND6STAT_INC(nd6s_dropped);
+}
+
+/*
+ * Apply what the dataplane learnt, start resolving what nd6_resolve()
+ * could not, at most budget of each, and run the solicitation timer;
+ * returns the number of messages processed.  Control lcore only.
+ */
+u_int
+nd6_poll(u_int budget)
+{
+	struct rte_mbuf *m[ND6_POLL_BURST];
+	const struct nd6_learn *nl;
+	struct ifnet *ifp;
+	u_int i, n, done, total;
+
+	for (done = 0; done < budget; done += n) {
+		n = rte_ring_sc_dequeue_burst(nd6_learnq, (void **)m,
+		    RTE_MIN(budget - done, ND6_POLL_BURST));
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++) {
+			nl = rte_pktmbuf_mtod(m[i], const struct nd6_learn *);
+			/* The interface may have gone meanwhile. */
+			ifp = if_rcvif(m[i]);
+			if (ifp != NULL && (nl->nl_create ||
+			    lla_lookup(AF_INET6, &nl->nl_addr) != NULL))
+				lla_update(AF_INET6, ifp, &nl->nl_addr,
+				    &nl->nl_lladdr, 0);
+			rte_pktmbuf_free(m[i]);
+		}
+	}
+	total = done;
+
+	for (done = 0; done < budget; done += n) {
+		n = rte_ring_sc_dequeue_burst(nd6_missq, (void **)m,
+		    RTE_MIN(budget - done, ND6_POLL_BURST));
+		if (n == 0)
+			break;
+		for (i = 0; i < n; i++)
+			nd6_miss(m[i]);
+	}
+	total += done;
+
+	nd6_timer();
+	lla_timer(AF_INET6);
+	return (total);
+}
+
+int
+nd6_init(void)
+{
+
+	nd6_learnq = rte_ring_create("nd6_learnq", ND6_LEARNQ_LEN,
+	    rte_socket_id(), RING_F_SC_DEQ);
+	nd6_missq = rte_ring_create("nd6_missq", ND6_MISSQ_LEN,
+	    rte_socket_id(), RING_F_SC_DEQ);
+	nd6_pool = rte_pktmbuf_pool_create("nd6_pool", ND6_NB_MBUF,
+	    ND6_POLL_BURST, 0, RTE_MBUF_DEFAULT_BUF_SIZE, rte_socket_id());
+	if (nd6_learnq == NULL || nd6_missq == NULL || nd6_pool == NULL)
+		return (ENOMEM);
+	lltable_register_held(AF_INET6, nd6_held);
+	lltable_register_probe(AF_INET6, ND6_MAXAGE, ND6_MAX_MULTICAST_SOLICIT,
+	    nd6_probe);
+	return (ip6proto_register(IPPROTO_ICMPV6, nd6_input));
+}
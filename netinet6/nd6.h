@@ -0,0 +1,85 @@
+/*-
+ * Copyright (C) 1995, 1996, 1997, and 1998 WIDE Project.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the project nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE PROJECT AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE PROJECT OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ *	$KAME: nd6.h,v 1.76 2001/12/18 02:10:31 itojun Exp $
+ * $FreeBSD$
+ */
+
+
+#ifndef _NETINET6_ND6_H_
+#define	_NETINET6_ND6_H_
+
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "net/pcpustat.h"
+
+struct ifnet;
+struct rte_mbuf;
+
+/*
+ * Neighbour discovery statistics.
+ */
+struct	nd6stat {
+	uint64_t nd6s_rxns;		/* neighbour solicitations received */
+	uint64_t nd6s_rxna;		/* neighbour advertisements received */
+	uint64_t nd6s_txns;		/* neighbour solicitations sent */
+	uint64_t nd6s_txna;		/* neighbour advertisements sent */
+	uint64_t nd6s_checksum;		/* bad checksum */
+	uint64_t nd6s_badmsg;		/* failed RFC 4861 validation */
+	uint64_t nd6s_noproto;		/* ICMPv6 passed on to the host */
+	uint64_t nd6s_dropped;		/* dropped waiting for resolution */
+	uint64_t nd6s_timeouts;		/* resolutions given up */
+};
+
+/*
+ * Statistics are per-lcore, see net/pcpustat.h.
+ */
+PCPUSTAT_DECLARE(struct nd6stat, nd6stat);
+
+#define	ND6STAT_ADD(name, val)	PCPUSTAT_ADD(nd6stat, name, (val))
+#define	ND6STAT_SUB(name, val)	ND6STAT_ADD(name, -(val))
+#define	ND6STAT_INC(name)	ND6STAT_ADD(name, 1)
+#define	ND6STAT_DEC(name)	ND6STAT_SUB(name, 1)
+#define	ND6STAT_FETCH(dst)	PCPUSTAT_FETCH(struct nd6stat, nd6stat, (dst))
+
+#define	ND6_MAX_MULTICAST_SOLICIT	3	/* RFC 4861 protocol constants */
+#define	ND6_RETRANS_TIMER		1000	/* ms */
+#define	ND6_MAXAGE			1200	/* s an entry goes unconfirmed */
+
+/*
+ * Neighbour discovery on the dataplane, the IPv6 counterpart of ARP in
+ * net/if_ether.c.  Next hops live in the AF_INET6 neighbour tables, see
+ * net/if_llatbl.h.
+ */
+int	nd6_init(void);
+u_int	nd6_poll(u_int budget);
+int	nd6_resolve(struct ifnet *ifp, struct rte_mbuf *m,
+	    const struct in6_addr *dst);
+
+#endif /* !_NETINET6_ND6_H_ */
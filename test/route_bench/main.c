@@ -0,0 +1,279 @@
+/*
+ * Cost of applying kernel route updates.  RTM_NEWROUTE and RTM_DELROUTE
+ * messages for a full BGP table are replayed through a NETLINK_USERSOCK
+ * socket into rtnl_listen_budget(), whose handler applies them with
+ * fib4_add() and fib4_delete(), as kip_route() does.  Three passes: the
+ * table comes in, every route is replaced by one through another gateway,
+ * and the table goes.  Each reports the cost per update, netlink receive
+ * and epoch reclamation included; queueing the messages is not counted.
+ * The kernel sends one route notification per datagram, and so does the
+ * bench.
+ *
+ *   route_bench -l 1 -n 1 [-- routes]
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <netinet/in.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_debug.h>
+#include <rte_eal.h>
+
+#include "libnetlink.h"
+#include "net/epoch.h"
+#include "netinet/in_fib.h"
+
+#define	BENCH_ROUTES	800000		/* a full table, and then some */
+#define	BENCH_IFS	4		/* interfaces the routes go through */
+#define	BENCH_GWS	16		/* gateways on each */
+#define	BENCH_MSGLEN	128		/* room for one route message */
+#define	BENCH_RCVBUF	(8 << 20)	/* as the monitor's KIP_RCVBUF */
+
+struct bench_route {
+	struct in_addr	br_dst;
+	uint8_t		br_plen;
+	uint8_t		br_oif;
+	uint8_t		br_gw;
+};
+
+static struct bench_route	*bench_routes;
+static uint64_t	bench_errors;
+
+/*
+ * in_fib.c only compares interfaces, so these stand in for them.
+ */
+static uint64_t	bench_ifs[BENCH_IFS];
+
+static uint64_t
+bench_rand(uint64_t *x)
+{
+
+	*x ^= *x << 13;
+	*x ^= *x >> 7;
+	*x ^= *x << 17;
+	return (*x);
+}
+
+/*
+ * A table shaped like the Internet's: mostly /24s, then /22 and /23, a
+ * fifth between /16 and /21, a few shorter and a few longer than /24.
+ * The /24 of route i is a permutation of i, below 1 << 24, which keeps
+ * /24s and longer prefixes distinct; a shorter one already taken becomes
+ * a /24 instead.
+ */
+static void
+bench_table(u_int n)
+{
+	static uint8_t taken[(1 << 24) / 8];
+	struct bench_route *br;
+	uint64_t x;
+	uint32_t p24, net, plen, r;
+	u_int i;
+
+	bench_routes = calloc(n, sizeof(*bench_routes));
+	if (bench_routes == NULL)
+		rte_exit(EXIT_FAILURE, "no memory for %u routes\n", n);
+	for (i = 0, x = 88172645463325252ull; i < n; i++) {
+		br = &bench_routes[i];
+		p24 = (i * 2654435761u) & 0xffffff;
+		r = bench_rand(&x) % 100;
+		if (r < 2)
+			plen = 8 + r % 8;
+		else if (r < 20)
+			plen = 16 + r % 6;
+		else if (r < 40)
+			plen = 22 + r % 2;
+		else if (r < 98)
+			plen = 24;
+		else
+			plen = 25 + r % 8;
+		if (plen < 24) {
+			/* Those of each length start at bit 1 << plen. */
+			net = (1u << plen) + (p24 >> (24 - plen));
+			if (taken[net / 8] & (1 << (net % 8)))
+				plen = 24;
+			else
+				taken[net / 8] |= 1 << (net % 8);
+		}
+		if (plen <= 24)
+			net = (p24 >> (24 - plen)) << (32 - plen);
+		else
+			net = p24 << 8 | ((uint32_t)bench_rand(&x) & 0xff &
+			    (0xff << (32 - plen)));
+		br->br_dst.s_addr = htonl(net);
+		br->br_plen = plen;
+		br->br_oif = bench_rand(&x) % BENCH_IFS;
+		br->br_gw = bench_rand(&x) % BENCH_GWS;
+	}
+}
+
+static struct in_addr
+bench_gw(u_int oif, u_int gw)
+{
+	struct in_addr in;
+
+	in.s_addr = htonl(0x0a000001 + (oif << 8) + gw);
+	return (in);
+}
+
+/*
+ * The message for route br, through gateway gw.
+ */
+static int
+bench_msg(struct nlmsghdr *n, int type, int flags,
+    const struct bench_route *br, u_int gw)
+{
+	struct rtmsg *r;
+	struct in_addr in;
+
+	memset(n, 0, BENCH_MSGLEN);
+	n->nlmsg_len = NLMSG_LENGTH(sizeof(*r));
+	n->nlmsg_type = type;
+	n->nlmsg_flags = flags;
+	r = NLMSG_DATA(n);
+	r->rtm_family = AF_INET;
+	r->rtm_dst_len = br->br_plen;
+	r->rtm_table = RT_TABLE_MAIN;
+	r->rtm_protocol = RTPROT_ZEBRA;
+	r->rtm_scope = RT_SCOPE_UNIVERSE;
+	r->rtm_type = RTN_UNICAST;
+	in = bench_gw(br->br_oif, gw);
+	addattr_l(n, BENCH_MSGLEN, RTA_DST, &br->br_dst, sizeof(br->br_dst));
+	addattr_l(n, BENCH_MSGLEN, RTA_GATEWAY, &in, sizeof(in));
+	addattr32(n, BENCH_MSGLEN, RTA_OIF, br->br_oif + 1);
+	addattr32(n, BENCH_MSGLEN, RTA_PRIORITY, 20);
+	return (n->nlmsg_len);
+}
+
+/*
+ * What kip_route() does with such a message, minus what it leaves out.
+ */
+static int
+bench_route(const struct sockaddr_nl *who __rte_unused,
+    struct rtnl_ctrl_data *ctrl __rte_unused, struct nlmsghdr *n,
+    void *arg __rte_unused)
+{
+	struct rtmsg *r = NLMSG_DATA(n);
+	struct rtattr *tb[RTA_MAX + 1];
+	struct in_addr dst, gw;
+	struct ifnet *ifp;
+	uint32_t metric, oif;
+	int error;
+
+	parse_rtattr(tb, RTA_MAX, RTM_RTA(r),
+	    n->nlmsg_len - NLMSG_LENGTH(sizeof(*r)));
+	if (tb[RTA_DST] == NULL || tb[RTA_GATEWAY] == NULL ||
+	    tb[RTA_OIF] == NULL)
+		return (-1);
+	memcpy(&dst, RTA_DATA(tb[RTA_DST]), sizeof(dst));
+	memcpy(&gw, RTA_DATA(tb[RTA_GATEWAY]), sizeof(gw));
+	oif = rta_getattr_u32(tb[RTA_OIF]);
+	if (oif == 0 || oif > BENCH_IFS)
+		return (-1);
+	ifp = (struct ifnet *)&bench_ifs[oif - 1];
+	metric = tb[RTA_PRIORITY] != NULL ?
+	    rta_getattr_u32(tb[RTA_PRIORITY]) : 0;
+
+	if (n->nlmsg_type == RTM_DELROUTE)
+		error = fib4_delete(dst, r->rtm_dst_len, gw, ifp, metric);
+	else
+		error = fib4_add(dst, r->rtm_dst_len, gw, ifp, metric,
+		    (n->nlmsg_flags & NLM_F_REPLACE) != 0);
+	if (error != 0)
+		bench_errors++;
+	return (0);
+}
+
+/*
+ * Send the messages of one pass from tx to rth as fast as it takes them,
+ * and time draining it.
+ */
+static void
+bench_pass(const char *name, struct rtnl_handle *rth, int tx, u_int n,
+    int type, int flags, u_int gwshift)
+{
+	struct sockaddr_nl peer;
+	uint64_t start, cycles;
+	char buf[BENCH_MSGLEN];
+	struct nlmsghdr *h;
+	u_int sent, got;
+	int len, ret;
+
+	memset(&peer, 0, sizeof(peer));
+	peer.nl_family = AF_NETLINK;
+	peer.nl_pid = rth->local.nl_pid;
+	h = (struct nlmsghdr *)buf;
+	bench_errors = 0;
+	cycles = 0;
+	for (sent = got = 0; got < n; ) {
+		for (; sent < n; sent++) {
+			len = bench_msg(h, type, flags, &bench_routes[sent],
+			    (bench_routes[sent].br_gw + gwshift) % BENCH_GWS);
+			if (sendto(tx, buf, len, MSG_DONTWAIT,
+			    (struct sockaddr *)&peer, sizeof(peer)) < 0) {
+				if (errno == EAGAIN || errno == ENOBUFS)
+					break;
+				rte_exit(EXIT_FAILURE, "sendto: %s\n",
+				    strerror(errno));
+			}
+		}
+		start = rte_rdtsc_precise();
+		ret = rtnl_listen_budget(rth, bench_route, NULL, sent - got);
+		epoch_poll();
+		cycles += rte_rdtsc_precise() - start;
+		if (ret < 0)
+			rte_exit(EXIT_FAILURE, "%s: messages lost\n", name);
+		got += ret;
+	}
+	printf("%-8s %u updates, %.0f cycles/update, %.0f ns/update, "
+	    "%" PRIu64 " failed\n", name, n, (double)cycles / n,
+	    (double)cycles * 1e9 / rte_get_tsc_hz() / n, bench_errors);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct rtnl_handle rth = { .fd = -1 };
+	struct sockaddr_nl sa;
+	u_int n;
+	int ret, tx;
+
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0)
+		rte_exit(EXIT_FAILURE, "Could not initialise EAL (%d)\n", ret);
+	argc -= ret;
+	argv += ret;
+	n = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_ROUTES;
+	if (n == 0 || n > FIB4_MAX_RULES)
+		rte_exit(EXIT_FAILURE, "1 to %u routes\n", FIB4_MAX_RULES);
+
+	if (fib4_init() != 0)
+		rte_exit(EXIT_FAILURE, "Could not initialise the FIB\n");
+	if (rtnl_open_byproto(&rth, 0, NETLINK_USERSOCK) < 0)
+		rte_exit(EXIT_FAILURE, "Could not open the netlink socket\n");
+	ret = rtnl_rcvbuf(&rth, BENCH_RCVBUF);
+	tx = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_USERSOCK);
+	memset(&sa, 0, sizeof(sa));
+	sa.nl_family = AF_NETLINK;
+	if (tx < 0 || bind(tx, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+		rte_exit(EXIT_FAILURE, "Could not open the sending socket\n");
+	bench_table(n);
+	printf("%u routes, receive buffer %d\n", n, ret);
+
+	bench_pass("add", &rth, tx, n, RTM_NEWROUTE,
+	    NLM_F_CREATE | NLM_F_EXCL, 0);
+	bench_pass("replace", &rth, tx, n, RTM_NEWROUTE,
+	    NLM_F_CREATE | NLM_F_REPLACE, 1);
+	bench_pass("delete", &rth, tx, n, RTM_DELROUTE, 0, 1);
+	return 0;
+}